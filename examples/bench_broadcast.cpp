@@ -0,0 +1,193 @@
+#include "network/server.hpp"
+#include "network/frame.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Compara el broadcast serializado una vez (sendToAll) con un envio por
+// destinatario (un sendTo por cliente, que construye un frame cada vez).
+// bytes_copied sale de frameBytesCopied(): lo que se escribio al construir
+// frames en cada ronda. Los suscriptores son sockets sin handshake (formato
+// original) que un solo hilo vacia con epoll, para llegar a miles sin un
+// Client (y su hilo) por suscriptor.
+// Uso: bench_broadcast [maxSubscribers] [payloadBytes] [rounds] [puerto]
+// Sin puerto (o 0) se usa uno libre que elige el kernel.
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedUs(Clock::time_point since) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - since).count();
+}
+
+// Puerto libre para start(): bind al 0 y se suelta
+static size_t freePort() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::perror("freePort");
+        std::exit(1);
+    }
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Vacia todos los suscriptores y cuenta los bytes recibidos
+class Drain {
+public:
+    Drain() : epollFd(epoll_create1(0)), received(0), running(true), thread(&Drain::run, this) {}
+
+    ~Drain() {
+        running = false;
+        thread.join();
+        close(epollFd);
+    }
+
+    void add(int fd) {
+        epoll_event event = epoll_event();
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    uint64_t bytes() const {
+        return received.load();
+    }
+
+private:
+    int epollFd;
+    std::atomic<uint64_t> received;
+    std::atomic<bool> running;
+    std::thread thread;
+
+    void run() {
+        epoll_event events[256];
+        char buffer[65536];
+        while (running) {
+            int ready = epoll_wait(epollFd, events, 256, 10);
+            for (int i = 0; i < ready; ++i) {
+                ssize_t got;
+                while ((got = recv(events[i].data.fd, buffer, sizeof(buffer), 0)) > 0) {
+                    received += static_cast<uint64_t>(got);
+                }
+            }
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    size_t maxSubscribers = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 5000;
+    size_t payloadBytes = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 1024;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+    size_t port = argc > 4 ? std::strtoul(argv[4], NULL, 10) : 0;
+    if (port == 0) {
+        port = freePort();
+    }
+
+    Server server;
+    server.start(port);
+
+    Message message(2);
+    message << std::string(payloadBytes, 'x');
+    FrameWriter sizer;
+    sizer.push(message);
+    size_t frameBytes = sizer.pendingBytes();
+
+    Drain drain;
+    std::vector<int> sockets;
+
+    std::printf("subscribers,mode,payload_bytes,bytes_copied,enqueue_us,delivery_us\n");
+    size_t subscribers = 1;
+    while (true) {
+        while (sockets.size() < subscribers) {
+            sockets.push_back(connectRaw(port));
+            drain.add(sockets.back());
+        }
+        // La lista de conexiones de metrics() se publica un poco despues del accept
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(30);
+        std::vector<Server::ClientID> ids;
+        while (ids.size() < subscribers && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ids.clear();
+            for (const ConnectionMetrics& stats : server.metrics().connections) {
+                ids.push_back(stats.clientID);
+            }
+        }
+        if (ids.size() != subscribers) {
+            std::fprintf(stderr, "error: %zu of %zu subscribers connected\n", ids.size(), subscribers);
+            return 1;
+        }
+
+        for (int mode = 0; mode < 2; ++mode) {
+            double enqueueUs = 0;
+            double deliveryUs = 0;
+            uint64_t copied = 0;
+            for (int round = 0; round < rounds; ++round) {
+                uint64_t expected = drain.bytes() + frameBytes * subscribers;
+                uint64_t copiedBefore = frameBytesCopied();
+                Clock::time_point start = Clock::now();
+                if (mode == 0) {
+                    server.sendToAll(message);
+                } else {
+                    for (Server::ClientID clientID : ids) {
+                        server.sendTo(message, clientID);
+                    }
+                }
+                enqueueUs += elapsedUs(start);
+                copied += frameBytesCopied() - copiedBefore;
+
+                deadline = Clock::now() + std::chrono::seconds(30);
+                while (drain.bytes() < expected && Clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+                if (drain.bytes() < expected) {
+                    std::fprintf(stderr, "error: %zu subscribers, %s: delivery timed out\n",
+                                 subscribers, mode == 0 ? "sendToAll" : "sendTo_loop");
+                    return 1;
+                }
+                deliveryUs += elapsedUs(start);
+            }
+
+            std::printf("%zu,%s,%zu,%llu,%.1f,%.1f\n", subscribers, mode == 0 ? "sendToAll" : "sendTo_loop",
+                        payloadBytes, static_cast<unsigned long long>(copied / rounds),
+                        enqueueUs / rounds, deliveryUs / rounds);
+        }
+
+        if (subscribers >= maxSubscribers) {
+            break;
+        }
+        subscribers = subscribers * 10 < maxSubscribers ? subscribers * 10 : maxSubscribers;
+    }
+
+    for (int fd : sockets) {
+        close(fd);
+    }
+    return 0;
+}
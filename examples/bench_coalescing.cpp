@@ -0,0 +1,147 @@
+#include "network/server.hpp"
+#include "network/frame.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Rafagas de mensajes pequeños por tick (como la logica de un juego) a
+// varias conexiones, con y sin coalescencia de envios. Entre envio y envio
+// se simula trabajo de la logica (workNs). Las syscalls salen de
+// NetworkMetrics (ioSyscalls incluye los avisos al event loop; sendmsg es
+// sendCalls).
+// Uso: bench_coalescing [mensajesPorTick] [ticks] [workNs]
+
+typedef std::chrono::steady_clock Clock;
+
+enum Mode {
+    Immediate,
+    Batch,
+    Delay200us,
+    Delay1ms
+};
+
+static const char* modeName(Mode mode) {
+    switch (mode) {
+    case Immediate: return "immediate";
+    case Batch: return "send_batch";
+    case Delay200us: return "max_delay_200us";
+    default: return "max_delay_1ms";
+    }
+}
+
+// Espera activa: la logica del tick entre dos envios
+static void work(long nanoseconds) {
+    Clock::time_point until = Clock::now() + std::chrono::nanoseconds(nanoseconds);
+    while (Clock::now() < until) {}
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+// Lee exactamente size bytes (socket bloqueante)
+static void drain(int fd, size_t size) {
+    char buffer[16384];
+    while (size > 0) {
+        ssize_t got = recv(fd, buffer, size < sizeof(buffer) ? size : sizeof(buffer), 0);
+        if (got <= 0) {
+            std::fprintf(stderr, "error: connection closed\n");
+            std::exit(1);
+        }
+        size -= static_cast<size_t>(got);
+    }
+}
+
+int main(int argc, char** argv) {
+    int perTick = argc > 1 ? std::atoi(argv[1]) : 32;
+    int ticks = argc > 2 ? std::atoi(argv[2]) : 200;
+    long workNs = argc > 3 ? std::atol(argv[3]) : 2000;
+    const size_t connections = 16;
+    size_t port = 8096;
+
+    Message message(1);
+    message << 7 << 3.5f << std::string(12, 'x');
+    FrameWriter sizer;
+    sizer.push(message);
+    size_t frameBytes = sizer.pendingBytes();
+
+    std::printf("mode,msgs_per_tick,syscalls_per_msg,sendmsg_per_msg,msgs_per_s\n");
+    for (int m = Immediate; m <= Delay1ms; ++m) {
+        Mode mode = static_cast<Mode>(m);
+        Server server;
+        SendCoalescing coalescing;
+        if (mode == Delay200us) {
+            coalescing.maxDelay = std::chrono::microseconds(200);
+        } else if (mode == Delay1ms) {
+            coalescing.maxDelay = std::chrono::microseconds(1000);
+        }
+        server.setSendCoalescing(coalescing);
+        server.start(port++);
+
+        std::vector<int> sockets;
+        for (size_t i = 0; i < connections; ++i) {
+            sockets.push_back(connectRaw(port - 1));
+        }
+        while (server.metrics().accepted < connections) {
+            std::this_thread::yield();
+        }
+        std::vector<Server::ClientID> clients;
+        for (const ConnectionMetrics& stats : server.metrics().connections) {
+            clients.push_back(stats.clientID);
+        }
+
+        size_t total = static_cast<size_t>(perTick) * ticks;
+        std::vector<std::thread> readers;
+        for (int fd : sockets) {
+            readers.push_back(std::thread(drain, fd, frameBytes * total));
+        }
+
+        NetworkMetrics before = server.metrics();
+        Clock::time_point start = Clock::now();
+        for (int tick = 0; tick < ticks; ++tick) {
+            std::unique_ptr<Server::SendBatch> batch;
+            if (mode == Batch) {
+                batch.reset(new Server::SendBatch(server));
+            }
+            for (int i = 0; i < perTick; ++i) {
+                for (Server::ClientID clientID : clients) {
+                    server.sendTo(message, clientID);
+                    work(workNs);
+                }
+            }
+            batch.reset();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        NetworkMetrics after = server.metrics();
+
+        double messages = static_cast<double>(total * connections);
+        std::printf("%s,%d,%.3f,%.3f,%.0f\n", modeName(mode), perTick,
+                    (after.ioSyscalls - before.ioSyscalls) / messages,
+                    (after.sendCalls - before.sendCalls) / messages, messages / seconds);
+        for (int fd : sockets) {
+            close(fd);
+        }
+    }
+    return 0;
+}
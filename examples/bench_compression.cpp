@@ -0,0 +1,74 @@
+#include "network/compression.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Ancho de banda contra CPU de la compresion de bloques (FrameCompressed)
+// para distintos tamaños de payload:
+//  - state: volcado de estado en texto, como los que se envian por Message
+//  - random: bytes aleatorios, el peor caso (no se comprimen)
+// breakeven_link_mb_s es el ancho de banda por debajo del cual comprimir,
+// enviar menos bytes y descomprimir tarda menos que enviar sin comprimir.
+// Uso: bench_compression [totalMiB]
+
+typedef std::chrono::steady_clock Clock;
+
+static std::vector<char> makePayload(size_t size, bool random) {
+    std::vector<char> payload;
+    payload.reserve(size);
+    unsigned seed = 12345;
+    for (size_t i = 0; payload.size() < size; ++i) {
+        if (random) {
+            seed = seed * 1103515245u + 12345u;
+            payload.push_back(static_cast<char>(seed >> 16));
+            continue;
+        }
+        std::string entry = "entity:" + std::to_string(i % 512) + ",x=" + std::to_string((i * 37) % 1000)
+            + ",y=" + std::to_string((i * 91) % 1000) + ",hp=100;";
+        payload.insert(payload.end(), entry.begin(), entry.end());
+    }
+    payload.resize(size);
+    return payload;
+}
+
+int main(int argc, char** argv) {
+    size_t totalBytes = (argc > 1 ? std::strtoul(argv[1], NULL, 10) : 256) << 20;
+    const size_t sizes[] = {256, 1024, 4096, 16384, 65536, 262144, 1048576};
+    size_t checksum = 0;
+
+    std::printf("data,payload_bytes,ratio,compress_mb_s,decompress_mb_s,breakeven_link_mb_s\n");
+    for (int random = 0; random < 2; ++random) {
+        for (size_t size : sizes) {
+            std::vector<char> payload = makePayload(size, random != 0);
+            std::vector<char> compressed(compressBound(size));
+            std::vector<char> restored(size);
+            size_t rounds = totalBytes / size > 0 ? totalBytes / size : 1;
+
+            size_t compressedSize = 0;
+            Clock::time_point start = Clock::now();
+            for (size_t i = 0; i < rounds; ++i) {
+                compressedSize = compressBlock(payload.data(), size, compressed.data());
+            }
+            double compressSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            start = Clock::now();
+            for (size_t i = 0; i < rounds; ++i) {
+                decompressBlock(compressed.data(), compressedSize, restored.data(), size);
+                checksum += static_cast<unsigned char>(restored[i % size]);
+            }
+            double decompressSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            double megabytes = static_cast<double>(size) * rounds / (1 << 20);
+            double saved = (static_cast<double>(size) - compressedSize) * rounds / (1 << 20);
+            double breakeven = saved > 0 ? saved / (compressSeconds + decompressSeconds) : 0.0;
+            std::printf("%s,%zu,%.3f,%.0f,%.0f,%.0f\n", random ? "random" : "state", size,
+                        static_cast<double>(compressedSize) / size, megabytes / compressSeconds,
+                        megabytes / decompressSeconds, breakeven);
+        }
+    }
+
+    std::fprintf(stderr, "checksum %zu\n", checksum);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "data_structures/data_buffer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Serializa 1M campos pequeños (int, float, short, char) en un DataBuffer:
+// buffer nuevo en cada ronda, reutilizado con clear(), con reserve() previo,
+// y como referencia la estrategia anterior (vector::resize al tamaño justo en
+// cada escritura, que rellena con ceros).
+// Uso: bench_data_buffer [campos] [rondas]
+
+typedef std::chrono::steady_clock Clock;
+
+// Lo que hacia DataBuffer antes: resize(needed) en cada escritura
+class ResizeBuffer {
+public:
+    ResizeBuffer() : write_pos(0) {}
+
+    template<typename T>
+    ResizeBuffer& operator<<(const T& data) {
+        if (buffer.size() < write_pos + sizeof(T)) {
+            buffer.resize(write_pos + sizeof(T));
+        }
+        std::memcpy(buffer.data() + write_pos, &data, sizeof(T));
+        write_pos += sizeof(T);
+        return *this;
+    }
+
+    void clear() {
+        buffer.clear();
+        write_pos = 0;
+    }
+
+    size_t size() const {
+        return write_pos;
+    }
+
+private:
+    std::vector<char> buffer;
+    size_t write_pos;
+};
+
+template<typename Buffer>
+static void fill(Buffer& buffer, size_t fields) {
+    for (size_t i = 0; i < fields; i += 4) {
+        buffer << static_cast<int>(i) << static_cast<float>(i) * 0.5f
+               << static_cast<short>(i) << static_cast<char>(i);
+    }
+}
+
+// Bytes que ocupan fields campos, para reserve()
+static size_t fieldBytes(size_t fields) {
+    return fields / 4 * (sizeof(int) + sizeof(float) + sizeof(short) + sizeof(char));
+}
+
+static void report(const char* name, size_t fields, int rounds, double seconds, size_t bytes) {
+    double total = static_cast<double>(fields) * rounds;
+    std::printf("%s,%zu,%.2f,%.0f\n", name, fields, seconds * 1e9 / total,
+                static_cast<double>(bytes) * rounds / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+    size_t fields = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 1000000;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 20;
+    size_t checksum = 0;
+
+    std::printf("variant,fields,ns_per_field,MB_per_s\n");
+
+    Clock::time_point start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        ResizeBuffer buffer;
+        fill(buffer, fields);
+        checksum += buffer.size();
+    }
+    report("resize_reference_fresh", fields, rounds,
+           std::chrono::duration<double>(Clock::now() - start).count(), fieldBytes(fields));
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        DataBuffer buffer;
+        fill(buffer, fields);
+        checksum += buffer.size();
+    }
+    report("fresh", fields, rounds,
+           std::chrono::duration<double>(Clock::now() - start).count(), fieldBytes(fields));
+
+    {
+        ResizeBuffer buffer;
+        start = Clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            buffer.clear();
+            fill(buffer, fields);
+            checksum += buffer.size();
+        }
+        report("resize_reference_reused", fields, rounds,
+               std::chrono::duration<double>(Clock::now() - start).count(), fieldBytes(fields));
+    }
+
+    {
+        DataBuffer buffer;
+        start = Clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            buffer.clear();
+            fill(buffer, fields);
+            checksum += buffer.size();
+        }
+        report("reused_clear", fields, rounds,
+               std::chrono::duration<double>(Clock::now() - start).count(), fieldBytes(fields));
+    }
+
+    start = Clock::now();
+    for (int round = 0; round < rounds; ++round) {
+        DataBuffer buffer;
+        buffer.reserve(fieldBytes(fields));
+        fill(buffer, fields);
+        checksum += buffer.size();
+    }
+    report("reserved", fields, rounds,
+           std::chrono::duration<double>(Clock::now() - start).count(), fieldBytes(fields));
+
+    // Evita que el compilador descarte el trabajo
+    if (checksum == 0) {
+        std::printf("empty\n");
+    }
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "network/server.hpp"
+#include "network/frame.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Compara los backends de E/S del Server (epoll e io_uring) con muchas
+// conexiones: cada cliente envia mensajes y el servidor responde a cada uno
+// (eco). syscalls_per_1k_msgs sale de NetworkMetrics::ioSyscalls y cuenta los
+// mensajes en los dos sentidos.
+// Uso: bench_io_backend [mensajesPorConexion] [rondas]
+
+typedef std::chrono::steady_clock Clock;
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Lee exactamente size bytes (socket bloqueante)
+static bool drain(int fd, size_t size) {
+    char buffer[16384];
+    while (size > 0) {
+        ssize_t got = recv(fd, buffer, size < sizeof(buffer) ? size : sizeof(buffer), 0);
+        if (got <= 0) {
+            return false;
+        }
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int perConnection = argc > 1 ? std::atoi(argv[1]) : 32;
+    int rounds = argc > 2 ? std::atoi(argv[2]) : 10;
+    const size_t connectionCounts[] = {16, 256, 1024};
+    size_t port = 8092;
+
+    // Cliente y servidor en el mismo proceso: dos descriptores por conexion
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    Message request(1);
+    request << 42 << std::string(32, 'x');
+    FrameWriter sizer;
+    sizer.push(request);
+    size_t frameBytes = sizer.pendingBytes();
+
+    std::printf("backend,connections,msgs_per_s,syscalls_per_1k_msgs\n");
+    for (int backend = 0; backend < 2; ++backend) {
+        for (size_t connections : connectionCounts) {
+            Server server;
+            server.defineAction(1, [&server](Server::ClientID& clientID, const Message& message) {
+                server.sendTo(message, clientID);
+            });
+            server.setIoBackend(backend == 0 ? Server::IoBackend::Epoll : Server::IoBackend::IoUring);
+            server.start(port++);
+            if (backend == 1 && server.ioBackend() != Server::IoBackend::IoUring) {
+                std::fprintf(stderr, "io_uring not available, skipping\n");
+                break;
+            }
+
+            std::vector<int> sockets;
+            for (size_t i = 0; i < connections; ++i) {
+                sockets.push_back(connectRaw(port - 1));
+            }
+
+            // Frames de una ronda por conexion, preparados una vez
+            std::vector<FrameWriter> writers(connections);
+            uint64_t syscallsBefore = server.metrics().ioSyscalls;
+            std::atomic<bool> done(false);
+            bool ok = true;
+            Clock::time_point start = Clock::now();
+            std::thread clients([&]() {
+                for (int round = 0; round < rounds && ok; ++round) {
+                    for (size_t i = 0; i < connections; ++i) {
+                        for (int m = 0; m < perConnection; ++m) {
+                            writers[i].push(request);
+                        }
+                        writers[i].flush(sockets[i]);
+                    }
+                    for (size_t i = 0; i < connections && ok; ++i) {
+                        ok = drain(sockets[i], frameBytes * perConnection);
+                    }
+                }
+                done = true;
+            });
+            while (!done) {
+                server.update();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+            clients.join();
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            uint64_t syscalls = server.metrics().ioSyscalls - syscallsBefore;
+
+            double messages = 2.0 * static_cast<double>(connections) * perConnection * rounds;
+            if (!ok) {
+                std::printf("error: connection closed\n");
+                return 1;
+            }
+            std::printf("%s,%zu,%.0f,%.1f\n", backend == 0 ? "epoll" : "io_uring", connections,
+                        messages / seconds, syscalls * 1000.0 / messages);
+            for (int fd : sockets) {
+                close(fd);
+            }
+        }
+    }
+    return 0;
+}
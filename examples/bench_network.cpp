@@ -0,0 +1,167 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Benchmark de ida y vuelta en la misma maquina: un Server que hace eco y M
+// Clients que mantienen `depth` peticiones en vuelo cada uno.
+// Barre transporte (TCP en 127.0.0.1, socket unix, memoria compartida),
+// tamaño de mensaje, numero de conexiones y profundidad de pipeline,
+// y escribe una linea CSV por configuracion. Una configuracion que no
+// completa ninguna ida y vuelta sale con status no_messages (y sin medidas)
+// y el programa termina con error.
+// Uso: bench_network [durationMs] [port] [tcp|unix|shm]
+
+typedef std::chrono::steady_clock Clock;
+
+static long long nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static double percentile(const std::vector<long long>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index] / 1000.0;
+}
+
+struct Result {
+    size_t messages;
+    std::vector<long long> latencies;
+};
+
+static Result runConfig(const char* transport, const std::string& address, size_t port, size_t payloadBytes, size_t connections, size_t depth, long durationMs) {
+    std::vector<std::unique_ptr<Client>> clients;
+    Result result;
+    result.messages = 0;
+
+    // Payload = marca de tiempo + string de relleno (con su longitud)
+    size_t overhead = sizeof(long long) + sizeof(size_t);
+    std::string filler(payloadBytes > overhead ? payloadBytes - overhead : 0, 'x');
+    bool measuring = true;
+
+    for (size_t i = 0; i < connections; ++i) {
+        clients.push_back(std::unique_ptr<Client>(new Client()));
+        Client* client = clients.back().get();
+        client->defineAction(1, [&, client](const Message& msg) {
+            long long sentAt;
+            msg >> sentAt;
+            result.latencies.push_back(nowNs() - sentAt);
+            ++result.messages;
+            if (measuring) {
+                Message next(1);
+                next << nowNs() << filler;
+                client->send(next);
+            }
+        });
+        client->connect(address, port);
+    }
+
+    Clock::time_point start = Clock::now();
+    for (auto& client : clients) {
+        for (size_t d = 0; d < depth; ++d) {
+            Message msg(1);
+            msg << nowNs() << filler;
+            client->send(msg);
+        }
+    }
+
+    Clock::time_point deadline = start + std::chrono::milliseconds(durationMs);
+    while (Clock::now() < deadline) {
+        for (auto& client : clients) {
+            client->update();
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+    measuring = false;
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (auto& client : clients) {
+        client->disconnect();
+    }
+
+    if (result.messages == 0) {
+        std::printf("%s,%zu,%zu,%zu,0,,,,,,no_messages\n", transport, payloadBytes, connections, depth);
+        std::fprintf(stderr, "error: %s, %zu bytes, %zu connections, depth %zu: no messages delivered\n",
+                     transport, payloadBytes, connections, depth);
+        std::fflush(stdout);
+        return result;
+    }
+
+    std::sort(result.latencies.begin(), result.latencies.end());
+    double frameBytes = static_cast<double>(payloadBytes + OutboundFrame::legacyHeaderSize);
+    std::printf("%s,%zu,%zu,%zu,%zu,%.0f,%.2f,%.1f,%.1f,%.1f,ok\n",
+                transport, payloadBytes, connections, depth, result.messages,
+                result.messages / seconds,
+                result.messages * frameBytes * 2 / seconds / (1024.0 * 1024.0),
+                percentile(result.latencies, 0.50),
+                percentile(result.latencies, 0.99),
+                percentile(result.latencies, 0.999));
+    std::fflush(stdout);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    long durationMs = argc > 1 ? std::atol(argv[1]) : 1000;
+    size_t port = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 8093;
+    std::string only = argc > 3 ? argv[3] : "";
+
+    Server server;
+    server.defineAction(1, [&server](Server::ClientID& clientID, const Message& msg) {
+        try {
+            server.sendTo(msg, clientID);
+        } catch (const Server::UnknownClientException&) {
+            // El cliente ya se desconecto al final de la configuracion
+        }
+    });
+    server.addEndpoint("unix://@libftpp/bench_network");
+    server.addEndpoint("shm://bench_network");
+    server.start(port);
+
+    std::atomic<bool> running(true);
+    std::thread serverThread([&] {
+        while (running) {
+            server.update();
+            // Ceder la CPU a los event loops: en maquinas con pocos cores un
+            // bucle activo aqui dominaria la latencia medida
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    });
+
+    const size_t sizes[] = {16, 256, 4096};
+    const size_t connectionCounts[] = {1, 8, 64};
+    const size_t depths[] = {1, 16};
+    const char* transports[][2] = {
+        {"tcp", "127.0.0.1"},
+        {"unix", "unix://@libftpp/bench_network"},
+        {"shm", "shm://bench_network"},
+    };
+
+    // MB/s cuenta ambos sentidos (peticion + eco) con la cabecera Legacy
+    std::printf("transport,payload_bytes,connections,depth,messages,msgs_per_sec,mb_per_sec,p50_us,p99_us,p999_us,status\n");
+    bool allDelivered = true;
+    for (size_t size : sizes) {
+        for (size_t connections : connectionCounts) {
+            for (size_t depth : depths) {
+                for (const auto& transport : transports) {
+                    if (only.empty() || only == transport[0]) {
+                        Result result = runConfig(transport[0], transport[1], port, size, connections, depth, durationMs);
+                        allDelivered = allDelivered && result.messages > 0;
+                    }
+                }
+            }
+        }
+    }
+
+    running = false;
+    serverThread.join();
+    return allDelivered ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Latencia peticion/respuesta con distintas SocketOptions (las mismas en
+// Server y Client). Cada peticion recibe dos respuestas pequeñas enviadas por
+// separado, el caso en el que Nagle retiene la segunda hasta el ACK retrasado.
+// Uso: bench_socket_options [rondas]
+
+typedef std::chrono::steady_clock Clock;
+
+struct Config {
+    const char* name;
+    SocketOptions options;
+};
+
+static std::vector<Config> configs() {
+    std::vector<Config> result;
+    Config config;
+
+    config.name = "nagle";
+    config.options.noDelay = false;
+    result.push_back(config);
+
+    config = Config();
+    config.name = "nodelay";
+    result.push_back(config);
+
+    config = Config();
+    config.name = "nodelay+quickack";
+    config.options.quickAck = true;
+    result.push_back(config);
+
+    config = Config();
+    config.name = "nodelay+busy_poll_50us";
+    config.options.busyPollMicros = 50;
+    result.push_back(config);
+
+    config = Config();
+    config.name = "nodelay+buffers_256k";
+    config.options.sendBuffer = 256 * 1024;
+    config.options.receiveBuffer = 256 * 1024;
+    result.push_back(config);
+
+    config = Config();
+    config.name = "nodelay+keepalive";
+    config.options.keepAlive = true;
+    config.options.keepAliveIdle = 30;
+    result.push_back(config);
+    return result;
+}
+
+static double percentile(std::vector<double>& samples, double p) {
+    size_t index = static_cast<size_t>(p * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+int main(int argc, char** argv) {
+    int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+    size_t port = 8094;
+
+    std::printf("options,p50_us,p99_us,max_us\n");
+    for (const Config& config : configs()) {
+        Server server;
+        server.setSocketOptions(config.options);
+        server.defineAction(1, [&server](Server::ClientID& clientID, const Message& message) {
+            Message header(2);
+            header << 1;
+            server.sendTo(header, clientID);
+            // El segundo mensaje llega al socket despues de que salga el primero
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            server.sendTo(message, clientID);
+        });
+        try {
+            server.start(port++);
+        } catch (const Server::StartFailedException& e) {
+            std::fprintf(stderr, "%s: %s, skipping\n", config.name, e.what());
+            continue;
+        }
+
+        Client client;
+        client.setSocketOptions(config.options);
+        int received = 0;
+        client.defineAction(1, [&received](const Message&) { ++received; });
+        client.defineAction(2, [&received](const Message&) { ++received; });
+        client.connect("localhost", port - 1);
+
+        Message request(1);
+        request << 42;
+        std::vector<double> samples;
+        for (int round = 0; round < rounds; ++round) {
+            received = 0;
+            Clock::time_point start = Clock::now();
+            client.send(request);
+            while (received < 2) {
+                server.update();
+                client.update();
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        client.disconnect();
+
+        double worst = *std::max_element(samples.begin(), samples.end());
+        std::printf("%s,%.1f,%.1f,%.1f\n", config.name, percentile(samples, 0.5),
+                    percentile(samples, 0.99), worst);
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "network/frame.hpp"
+#include <sys/uio.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Compara el formato Legacy (cabecera fija + campos fijos) con el Compact
+// (cabecera varint + campos Message::Encoding::Varint) para un mensaje de
+// telemetria tipico: 8 enteros pequeños.
+// Uso: bench_wire_format [messages]
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point since) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - since).count();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 1000000;
+    long checksum = 0;
+
+    std::printf("format,messages,bytes_per_message,encode_ns_per_message,decode_ns_per_message\n");
+    for (int mode = 0; mode < 2; ++mode) {
+        WireFormat format = mode == 0 ? WireFormat::Legacy : WireFormat::Compact;
+        Message::Encoding encoding = mode == 0 ? Message::Encoding::Fixed : Message::Encoding::Varint;
+        std::vector<char> wire;
+        wire.reserve(count * 64);
+
+        // Encode: construir el mensaje, sus cabeceras y copiar los iovecs al "cable"
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            Message message(7, encoding);
+            int base = static_cast<int>(i % 1000);
+            message << base << base + 1 << -base << 42 << static_cast<long>(i % 100)
+                    << static_cast<short>(3) << 0u << base * 2;
+            OutboundFrame frame(message);
+
+            struct iovec iov[2];
+            size_t iovCount = frame.fillIovec(iov, 0, format);
+            for (size_t v = 0; v < iovCount; ++v) {
+                const char* bytes = static_cast<const char*>(iov[v].iov_base);
+                wire.insert(wire.end(), bytes, bytes + iov[v].iov_len);
+            }
+        }
+        double encodeNs = elapsedNs(start);
+
+        // Decode: parsear los frames y leer todos los campos
+        FrameReader reader;
+        reader.setFormat(format);
+        Message message;
+        uint8_t flags = 0;
+        const size_t chunk = 65536;
+        start = Clock::now();
+        for (size_t offset = 0; offset < wire.size(); offset += chunk) {
+            reader.feed(wire.data() + offset, std::min(chunk, wire.size() - offset));
+            while (reader.next(message, flags)) {
+                int a, b, c, d, h;
+                long e;
+                short f;
+                unsigned g;
+                message >> a >> b >> c >> d >> e >> f >> g >> h;
+                checksum += a + b + c + d + e + f + g + h;
+            }
+        }
+        double decodeNs = elapsedNs(start);
+
+        std::printf("%s,%zu,%.2f,%.1f,%.1f\n", mode == 0 ? "legacy" : "compact", count,
+                    static_cast<double>(wire.size()) / count, encodeNs / count, decodeNs / count);
+    }
+
+    std::fprintf(stderr, "checksum %ld\n", checksum);
+    return 0;
+}
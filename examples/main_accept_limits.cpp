@@ -0,0 +1,167 @@
+#include "network/server.hpp"
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Sin descriptores libres (RLIMIT_NOFILE): las conexiones que el servidor no
+// puede aceptar se cierran en vez de quedarse colgadas en la cola del
+// listener, el fallo se cuenta en NetworkMetrics::acceptFailures y, al
+// liberarse descriptores, las conexiones nuevas se aceptan otra vez. Con
+// epoll y con io_uring (si el kernel lo permite).
+// Uso: main_accept_limits [puerto]
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static int openDescriptors() {
+    int count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    while (dir != NULL && readdir(dir) != NULL) {
+        ++count;
+    }
+    if (dir != NULL) {
+        closedir(dir);
+    }
+    return count - 3; // ".", ".." y el propio DIR
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    timeval timeout = {0, 500 * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// true si el servidor cerro la conexion; false si sigue abierta (timeout)
+static bool closedByServer(int fd) {
+    char byte;
+    ssize_t got = recv(fd, &byte, sizeof(byte), 0);
+    return got == 0 || (got < 0 && errno == ECONNRESET);
+}
+
+// Servidor en un proceso hijo con room descriptores libres tras start();
+// escribe acceptFailures en report cuando el padre cierra command
+static pid_t spawnServer(size_t port, Server::IoBackend backend, int room, int& command, int& report) {
+    int down[2];
+    int up[2];
+    if (pipe(down) != 0 || pipe(up) != 0) {
+        std::perror("pipe");
+        std::exit(1);
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(down[1]);
+        close(up[0]);
+        {
+            // El limite se fija antes de start(): io_uring lo toma al preparar
+            // el accept multishot. Un primer start() mide cuantos usa el Server
+            int used = 0;
+            {
+                Server probe;
+                probe.setIoBackend(backend);
+                int before = openDescriptors();
+                probe.start(port);
+                used = openDescriptors() - before;
+            }
+            rlimit limit;
+            getrlimit(RLIMIT_NOFILE, &limit);
+            limit.rlim_cur = static_cast<rlim_t>(openDescriptors() + used + room);
+            setrlimit(RLIMIT_NOFILE, &limit);
+            Server server;
+            server.setIoBackend(backend);
+            server.start(port);
+            char ready = 1;
+            ssize_t ret = write(up[1], &ready, 1);
+            ret = read(down[0], &ready, 1); // Hasta que el padre cierre
+            uint64_t failed = server.metrics().acceptFailures;
+            ret = write(up[1], &failed, sizeof(failed));
+            (void)ret;
+        }
+        std::_Exit(0);
+    }
+    close(down[0]);
+    close(up[1]);
+    char ready;
+    if (read(up[0], &ready, 1) != 1) {
+        std::exit(1);
+    }
+    command = down[1];
+    report = up[0];
+    return child;
+}
+
+static void exhaust(size_t port, Server::IoBackend backend, const char* name) {
+    const int room = 4;
+    const int extra = 6;
+    int command = -1;
+    int report = -1;
+    pid_t child = spawnServer(port, backend, room, command, report);
+
+    std::vector<int> peers;
+    for (int i = 0; i < room + extra; ++i) {
+        peers.push_back(connectRaw(port));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    int open = 0;
+    int closed = 0;
+    for (int fd : peers) {
+        if (closedByServer(fd)) {
+            ++closed;
+        } else {
+            ++open;
+        }
+    }
+    std::printf("       %s: %d accepted, %d closed\n", name, open, closed);
+    check(open > 0 && open <= room && closed >= extra, "connections beyond the descriptor limit are closed, not left hanging");
+
+    // Liberar los descriptores del servidor: la siguiente conexion se acepta
+    for (int fd : peers) {
+        close(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    int late = connectRaw(port);
+    check(!closedByServer(late), "new connections are accepted once descriptors are free again");
+    close(late);
+
+    close(command);
+    uint64_t failed = 0;
+    ssize_t got = read(report, &failed, sizeof(failed));
+    close(report);
+    int status = 0;
+    waitpid(child, &status, 0);
+    check(got == static_cast<ssize_t>(sizeof(failed)) && failed > 0, "accept failures are counted in metrics()");
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8119;
+
+    exhaust(port, Server::IoBackend::Epoll, "epoll");
+    exhaust(port + 1, Server::IoBackend::IoUring, "io_uring");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+// Colas de salida por conexion contra un par que no lee: por defecto la cola
+// no tiene limite y sendTo nunca espera, el callback avisa al cruzar
+// highWatermark y al bajar de lowWatermark, y con maxBytes se aplica cada
+// OverflowPolicy: Drop descarta, Disconnect cierra y Block espera hasta
+// blockTimeout (o hasta que haya sitio).
+// Uso: main_backpressure [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Par en formato original con un buffer de recepcion pequeño: lo que no lee
+// se queda en la cola del servidor
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int buffer = 16 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static bool readExact(int fd, void* out, size_t size) {
+    char* bytes = static_cast<char*>(out);
+    while (size > 0) {
+        ssize_t got = recv(fd, bytes, size, 0);
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+// Lee frames Legacy hasta el cierre o hasta que pasa el timeout sin datos.
+// closed: el servidor cerro la conexion
+static int readFrames(int fd, bool& closed) {
+    int frames = 0;
+    std::string body;
+    closed = false;
+    while (true) {
+        size_t length = 0;
+        ssize_t got = recv(fd, &length, sizeof(length), MSG_WAITALL);
+        if (got == 0) {
+            closed = true;
+            return frames;
+        }
+        if (got != static_cast<ssize_t>(sizeof(length))) {
+            return frames;
+        }
+        body.resize(length);
+        if (!readExact(fd, &body[0], length)) {
+            return frames;
+        }
+        ++frames;
+    }
+}
+
+struct Events {
+    std::atomic<int> congested;
+    std::atomic<int> drained;
+    std::atomic<int> overflow;
+    Events() : congested(0), drained(0), overflow(0) {}
+};
+
+// Server con los limites dados y un par que no lee; devuelve su ClientID
+static Server::ClientID setUp(Server& server, Events& events, const SendQueueLimits& limits, size_t port, int& fd) {
+    SocketOptions options;
+    options.sendBuffer = 16 * 1024;
+    server.setSocketOptions(options);
+    server.setSendQueueLimits(limits);
+    server.setBackpressureCallback([&events](Server::ClientID, SendQueueEvent event) {
+        if (event == SendQueueEvent::Congested) {
+            ++events.congested;
+        } else if (event == SendQueueEvent::Drained) {
+            ++events.drained;
+        } else {
+            ++events.overflow;
+        }
+    });
+    server.start(port);
+    fd = connectRaw(port);
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(2);
+    while (server.metrics().connections.empty() && Clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    return server.metrics().connections.empty() ? -1 : server.metrics().connections[0].clientID;
+}
+
+static Message chunk() {
+    Message message(2);
+    message << std::string(16 * 1024, 'q');
+    return message;
+}
+
+static long millisSince(Clock::time_point start) {
+    return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8115;
+    const int count = 400;   // 6.4 MiB: mas que los buffers del kernel y que highWatermark
+
+    {
+        SendQueueLimits limits;
+        check(limits.maxBytes == 0 && limits.policy != OverflowPolicy::Block, "the default queue never blocks");
+        Server server;
+        Events events;
+        int fd = -1;
+        Server::ClientID id = setUp(server, events, limits, port, fd);
+        Message message = chunk();
+        Clock::time_point start = Clock::now();
+        bool threw = false;
+        try {
+            for (int i = 0; i < count; ++i) {
+                server.sendTo(message, id);
+            }
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(!threw && millisSince(start) < 1000, "with the defaults sendTo does not wait for a slow consumer");
+        check(events.congested == 1 && events.drained == 0, "Congested is reported once above highWatermark");
+
+        bool closed = false;
+        int frames = readFrames(fd, closed);
+        check(frames == count && events.overflow == 0, "nothing is dropped without maxBytes");
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(2);
+        while (events.drained == 0 && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        check(events.drained == 1, "Drained is reported once the queue falls below lowWatermark");
+        close(fd);
+    }
+
+    SendQueueLimits bounded;
+    bounded.highWatermark = 256 * 1024;
+    bounded.lowWatermark = 64 * 1024;
+    bounded.maxBytes = 1024 * 1024;
+
+    {
+        bounded.policy = OverflowPolicy::Drop;
+        Server server;
+        Events events;
+        int fd = -1;
+        Server::ClientID id = setUp(server, events, bounded, port + 1, fd);
+        Message message = chunk();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < count; ++i) {
+            server.sendTo(message, id);
+        }
+        check(millisSince(start) < 1000 && events.overflow > 0, "Drop: overflowing sends return at once and are reported");
+        bool closed = false;
+        int frames = readFrames(fd, closed);
+        check(frames > 0 && frames < count && !closed, "Drop: the excess is discarded and the connection stays open");
+        server.sendTo(message, id);
+        check(readFrames(fd, closed) == 1, "Drop: later sends arrive once there is room");
+        close(fd);
+    }
+
+    {
+        bounded.policy = OverflowPolicy::Disconnect;
+        Server server;
+        Events events;
+        int fd = -1;
+        Server::ClientID id = setUp(server, events, bounded, port + 2, fd);
+        Message message = chunk();
+        try {
+            for (int i = 0; i < count; ++i) {
+                server.sendTo(message, id);
+            }
+        } catch (const Server::UnknownClientException&) {
+            // El event loop ya cerro la conexion
+        }
+        check(events.overflow == 1, "Disconnect: the overflow is reported once");
+        bool closed = false;
+        int frames = readFrames(fd, closed);
+        check(closed && frames < count, "Disconnect: the slow consumer is closed");
+        close(fd);
+    }
+
+    {
+        bounded.policy = OverflowPolicy::Block;
+        bounded.blockTimeout = std::chrono::milliseconds(300);
+        Server server;
+        Events events;
+        int fd = -1;
+        Server::ClientID id = setUp(server, events, bounded, port + 3, fd);
+        Message message = chunk();
+        Clock::time_point start = Clock::now();
+        bool timedOut = false;
+        try {
+            for (int i = 0; i < count; ++i) {
+                server.sendTo(message, id);
+            }
+        } catch (const Server::SendingFailedException&) {
+            timedOut = true;
+        }
+        long waited = millisSince(start);
+        check(timedOut && waited >= 250, "Block: a send that finds no room fails after blockTimeout");
+
+        // Con alguien leyendo, los envios esperan a que haya sitio y llegan todos
+        bool closed = false;
+        int frames = 0;
+        std::thread reader([&] { frames = readFrames(fd, closed); });
+        bool threw = false;
+        try {
+            for (int i = 0; i < count; ++i) {
+                server.sendTo(message, id);
+            }
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        reader.join();
+        check(!threw && frames >= count && events.overflow == 0, "Block: sends wait for room instead of dropping");
+        close(fd);
+    }
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
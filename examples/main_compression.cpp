@@ -0,0 +1,136 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+// Compresion negociada: un payload repetitivo viaja comprimido y llega
+// intacto en los dos sentidos; uno aleatorio, uno por debajo del umbral o
+// uno hacia un cliente sin WireFeatureCompression viajan tal cual.
+// Hacia el cliente se mira la forma comprimida que construye el servidor
+// (frameBytesCopied, bytesOut cuenta el tamaño sin comprimir); hacia el
+// servidor, los bytes recibidos (NetworkMetrics::bytesIn).
+// Uso: main_compression [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static std::string repetitive(size_t size) {
+    std::string text;
+    while (text.size() < size) {
+        text += "position=" + std::to_string(text.size() % 1000) + ";velocity=0;";
+    }
+    text.resize(size);
+    return text;
+}
+
+static std::string random(size_t size) {
+    std::mt19937 generator(42);
+    std::string text(size, '\0');
+    for (char& c : text) {
+        c = static_cast<char>(generator());
+    }
+    return text;
+}
+
+struct Peer {
+    Client client;
+    Server::ClientID id = -1;
+    std::string last;
+    int received = 0;
+};
+
+static void connect(Server& server, Peer& peer, size_t port, uint32_t features) {
+    server.defineAction(9, [&peer](Server::ClientID& clientID, const Message&) { peer.id = clientID; });
+    peer.client.setWireFeatures(features);
+    peer.client.defineAction(1, [&peer](const Message& message) {
+        message >> peer.last;
+        ++peer.received;
+    });
+    peer.client.connect("localhost", port);
+    peer.client.send(Message(9));
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (peer.id < 0 && Clock::now() < deadline) {
+        server.update();
+    }
+}
+
+// Envia text a peer y devuelve los bytes de la forma comprimida que construyo
+// el servidor (0 si lo envio tal cual)
+static uint64_t deliver(Server& server, Peer& peer, const std::string& text) {
+    Message message(1);
+    message << text;
+    // Lo que cuesta la forma normal, para descontarlo
+    uint64_t before = frameBytesCopied();
+    OutboundFrame plainForm(message);
+    uint64_t plainBytes = frameBytesCopied() - before;
+
+    int expected = peer.received + 1;
+    before = frameBytesCopied();
+    server.sendTo(message, peer.id);
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (peer.received < expected && Clock::now() < deadline) {
+        peer.client.update();
+    }
+    return frameBytesCopied() - before - plainBytes;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8105;
+    const size_t size = 1024 * 1024;
+    std::string text = repetitive(size);
+    std::string noise = random(size);
+
+    Server server;
+    server.setCompressionThreshold(4096);
+    std::string upstream;
+    server.defineAction(2, [&upstream](Server::ClientID&, const Message& message) { message >> upstream; });
+    server.start(port);
+
+    Peer packed;
+    connect(server, packed, port, WireFeatureCompact | WireFeatureCompression);
+    check((packed.client.wireFeatures() & WireFeatureCompression) != 0, "compression is negotiated");
+
+    uint64_t wire = deliver(server, packed, text);
+    check(packed.last == text, "compressed payload arrives intact");
+    check(wire > 0 && wire < size / 4, "repetitive payload travels compressed");
+
+    wire = deliver(server, packed, noise);
+    check(packed.last == noise && wire == 0, "incompressible payload travels as is");
+
+    std::string small = repetitive(1000);
+    wire = deliver(server, packed, small);
+    check(packed.last == small && wire == 0, "payload below the threshold travels as is");
+
+    uint64_t before = server.metrics().bytesIn;
+    Message message(2);
+    message << text;
+    packed.client.send(message);
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (upstream.empty() && Clock::now() < deadline) {
+        server.update();
+    }
+    check(upstream == text && server.metrics().bytesIn - before < size / 4,
+          "client payloads are compressed too");
+
+    Peer plain;
+    connect(server, plain, port, WireFeatureCompact);
+    wire = deliver(server, plain, text);
+    check(plain.last == text && wire == 0, "peers without compression get the payload uncompressed");
+
+    packed.client.disconnect();
+    plain.client.disconnect();
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+// Canal UDP junto a TCP: los datagramas pasan por las mismas acciones con el
+// ClientID de su conexion TCP, en los dos sentidos. Un token desconocido se
+// ignora, lo viejo de cada tipo se descarta, y sin WireFeatureDatagrams
+// (o por un endpoint local) no hay canal.
+// Uso: main_datagrams [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Datagrama con el formato de DatagramSocket pero con un token inventado
+static void sendForged(size_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    Message message(5);
+    message << -1;
+    FrameHandle frame = makeFrame(message);
+    uint64_t header[2] = {0x1234567890abcdefULL, 1};
+    iovec iov[3];
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    size_t count = 1 + frame->fillIovec(iov + 1, 0, WireFormat::Compact);
+    msghdr datagram = msghdr();
+    datagram.msg_name = &address;
+    datagram.msg_namelen = sizeof(address);
+    datagram.msg_iov = iov;
+    datagram.msg_iovlen = count;
+    sendmsg(fd, &datagram, 0);
+    close(fd);
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8102;
+    std::string unixAddress = "unix://@main_datagrams_" + std::to_string(getpid());
+
+    DatagramSequences sequences;
+    check(sequences.accept(1, 5) && !sequences.accept(1, 3) && !sequences.accept(1, 5)
+          && sequences.accept(2, 1) && sequences.accept(1, 6),
+          "only newer sequences of each type are accepted");
+
+    Server server;
+    server.enableDatagrams();
+    server.addEndpoint(unixAddress);
+    Server::ClientID tcpID = -1;
+    int fromClient = 0;
+    bool sameID = true;
+    bool forgedSeen = false;
+    server.defineAction(6, [&tcpID](Server::ClientID& clientID, const Message&) { tcpID = clientID; });
+    server.defineAction(5, [&](Server::ClientID& clientID, const Message& message) {
+        int value;
+        message >> value;
+        forgedSeen = forgedSeen || value < 0;
+        sameID = sameID && clientID == tcpID;
+        ++fromClient;
+    });
+    server.start(port);
+
+    Client client;
+    int fromServer = 0;
+    client.defineAction(8, [&fromServer](const Message&) { ++fromServer; });
+    client.setWireFeatures(WireFeatureCompact | WireFeatureDatagrams);
+    client.connect("localhost", port);
+    check(client.hasDatagrams(), "datagram channel is negotiated over TCP");
+
+    client.send(Message(6));
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(3);
+    while (tcpID < 0 && Clock::now() < deadline) {
+        server.update();
+    }
+    sendForged(port);
+    for (int i = 0; i < 50; ++i) {
+        Message message(5);
+        message << i;
+        client.sendDatagram(message);
+    }
+    deadline = Clock::now() + std::chrono::seconds(3);
+    while (fromClient < 50 && Clock::now() < deadline) {
+        server.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(fromClient == 50 && sameID, "client datagrams reach the actions with the TCP ClientID");
+    check(!forgedSeen, "datagram with an unknown token is ignored");
+
+    // El servidor solo conoce la direccion UDP del cliente tras su primer datagrama
+    for (int i = 0; i < 20; ++i) {
+        server.sendDatagram(Message(8), tcpID);
+    }
+    server.sendDatagramToAll(Message(8));
+    deadline = Clock::now() + std::chrono::seconds(3);
+    while (fromServer < 21 && Clock::now() < deadline) {
+        client.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(fromServer == 21, "server datagrams reach the client actions");
+
+    bool tooLarge = false;
+    try {
+        Message big(5);
+        big << std::string(DatagramSocket::maxDatagramSize, 'x');
+        client.sendDatagram(big);
+    } catch (const Client::DatagramTooLargeException&) {
+        tooLarge = true;
+    }
+    check(tooLarge, "message larger than a datagram is rejected");
+
+    Client plain;
+    plain.connect("localhost", port);
+    bool unavailable = false;
+    try {
+        plain.sendDatagram(Message(5));
+    } catch (const Client::DatagramsUnavailableException&) {
+        unavailable = true;
+    }
+    check(unavailable, "no datagrams without WireFeatureDatagrams");
+
+    Client local;
+    local.setWireFeatures(WireFeatureCompact | WireFeatureDatagrams);
+    local.connect(unixAddress, 0);
+    check(!local.hasDatagrams(), "local endpoints do not get a datagram channel");
+
+    local.disconnect();
+    plain.disconnect();
+    client.disconnect();
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// ConnectionTimeouts: un par mudo y un Client sin handshake no reciben
+// Heartbeat y se cierran al pasar idleTimeout (con su ReapCallback); un
+// Client callado que hizo el handshake sigue vivo porque contesta a los
+// Heartbeat.
+// Uso: main_idle_timeout [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+// Espera a que las metricas publiquen una conexion que no esta en known
+static Server::ClientID newClient(Server& server, const std::set<Server::ClientID>& known) {
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(2);
+    while (Clock::now() < deadline) {
+        for (const ConnectionMetrics& stats : server.metrics().connections) {
+            if (known.count(stats.clientID) == 0) {
+                return stats.clientID;
+            }
+        }
+        std::this_thread::yield();
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8099;
+    const std::chrono::milliseconds idleTimeout(300);
+
+    Server server;
+    Server::ConnectionTimeouts timeouts;
+    timeouts.idleTimeout = idleTimeout;
+    timeouts.heartbeatInterval = std::chrono::milliseconds(100);
+    server.setConnectionTimeouts(timeouts);
+    std::atomic<int> reaped(0);
+    std::mutex reapedMutex;
+    std::set<Server::ClientID> reapedIDs;
+    server.setReapCallback([&](Server::ClientID clientID) {
+        std::lock_guard<std::mutex> lock(reapedMutex);
+        reapedIDs.insert(clientID);
+        ++reaped;
+    });
+    std::atomic<int> received(0);
+    server.defineAction(1, [&](Server::ClientID&, const Message&) { ++received; });
+    server.start(port);
+
+    // Un Client con handshake recibe Heartbeat; uno sin handshake (formato
+    // original) y un par mudo no, y se cierran al pasar idleTimeout
+    Client compact;
+    compact.setWireFeatures(WireFeatureCompact);
+    compact.connect("localhost", port);
+    Server::ClientID compactID = newClient(server, std::set<Server::ClientID>());
+    Client legacy;
+    legacy.connect("localhost", port);
+    Clock::time_point start = Clock::now();
+    Server::ClientID legacyID = newClient(server, std::set<Server::ClientID>{compactID});
+    int mute = connectRaw(port);
+    Server::ClientID muteID = newClient(server, std::set<Server::ClientID>{compactID, legacyID});
+
+    while (reaped < 2 && Clock::now() - start < std::chrono::seconds(3)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    long waited = static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+    bool bothReaped;
+    {
+        std::lock_guard<std::mutex> lock(reapedMutex);
+        bothReaped = reapedIDs == std::set<Server::ClientID>{legacyID, muteID};
+    }
+    check(reaped == 2 && bothReaped, "peers without handshake are reaped and reported to the callback");
+    check(waited >= idleTimeout.count() && waited < idleTimeout.count() + 400, "reaped shortly after idleTimeout");
+
+    // Al par mudo se le cerro la conexion sin mandarle ningun Heartbeat: en
+    // el formato original el flag de control caeria en la longitud
+    timeval timeout = {1, 0};
+    setsockopt(mute, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char buffer[256];
+    ssize_t got;
+    size_t total = 0;
+    while ((got = recv(mute, buffer, sizeof(buffer), 0)) > 0) {
+        total += static_cast<size_t>(got);
+    }
+    check(got == 0 && total == 0, "peers without handshake get no heartbeats before being closed");
+    close(mute);
+
+    // Varios idleTimeout mas sin que el Client negociado envie nada
+    std::this_thread::sleep_for(idleTimeout * 4);
+    check(reaped == 2, "quiet clients answering heartbeats are not reaped");
+    compact.send(Message(1));
+    start = Clock::now();
+    while (received < 1 && Clock::now() - start < std::chrono::seconds(2)) {
+        server.update();
+    }
+    check(received == 1, "quiet clients can still send after the idle period");
+
+    legacy.disconnect();
+    compact.disconnect();
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+
+// InboundLimits: con el cubo de un cliente agotado, Pause entrega todo mas
+// despacio, Drop descarta lo que sobra y Disconnect cierra la conexion. El
+// tope global de mensajes pendientes acota la cola de update().
+// Uso: main_inbound_limits [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+struct Outcome {
+    int delivered;
+    double seconds;
+    NetworkMetrics metrics;
+    size_t peakPending;
+};
+
+// Envia count mensajes de golpe y hace update() hasta recibirlos o waitMs.
+// Con idleMs el servidor no llama a update() durante ese rato.
+static Outcome run(size_t port, const InboundLimits& limits, int count, long waitMs, long idleMs) {
+    Server server;
+    server.setInboundLimits(limits);
+    int delivered = 0;
+    server.defineAction(1, [&delivered](Server::ClientID&, const Message&) { ++delivered; });
+    server.start(port);
+
+    Client client;
+    client.connect("localhost", port);
+    try {
+        for (int i = 0; i < count; ++i) {
+            Message message(1);
+            message << i << std::string(100, 'x');
+            client.send(message);
+        }
+    } catch (const std::exception&) {
+        // Con Disconnect la conexion puede cerrarse mientras se envia
+    }
+
+    Outcome outcome;
+    outcome.peakPending = 0;
+    Clock::time_point start = Clock::now();
+    if (idleMs > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(idleMs));
+        outcome.peakPending = server.metrics().pendingMessages;
+    }
+    while (delivered < count && Clock::now() - start < std::chrono::milliseconds(waitMs)) {
+        server.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    outcome.delivered = delivered;
+    outcome.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    outcome.metrics = server.metrics();
+    try {
+        client.disconnect();
+    } catch (const std::exception&) {
+    }
+    return outcome;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8100;
+    const int count = 400;
+
+    InboundLimits rate;
+    rate.messagesPerSecond = 1000;
+    rate.messageBurst = 50;
+
+    rate.policy = ShedPolicy::Pause;
+    Outcome paused = run(port, rate, count, 5000, 0);
+    check(paused.delivered == count && paused.metrics.messagesShed == 0, "Pause delivers every message");
+    check(paused.metrics.readPauses > 0 && paused.seconds >= 0.3, "Pause paces the client to the bucket rate");
+
+    rate.policy = ShedPolicy::Drop;
+    Outcome dropped = run(port + 1, rate, count, 1000, 0);
+    check(dropped.delivered >= 50 && dropped.delivered < count, "Drop delivers the burst and sheds the rest");
+    check(dropped.metrics.messagesShed == static_cast<uint64_t>(count - dropped.delivered),
+          "Drop counts every shed message");
+    check(dropped.metrics.closed == 0, "Drop keeps the connection");
+
+    rate.policy = ShedPolicy::Disconnect;
+    Outcome disconnected = run(port + 2, rate, count, 1000, 0);
+    check(disconnected.delivered < count && disconnected.metrics.closed == 1, "Disconnect closes the client");
+
+    // Tope global: sin update() la cola no pasa de maxPendingMessages
+    InboundLimits global;
+    global.maxPendingMessages = 100;
+    global.policy = ShedPolicy::Drop;
+    Outcome capped = run(port + 3, global, 5000, 2000, 300);
+    check(capped.peakPending <= 100 && capped.metrics.messagesShed > 0, "global cap bounds pending messages");
+    check(capped.metrics.closed == 0, "global cap never disconnects");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
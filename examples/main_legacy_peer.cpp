@@ -0,0 +1,270 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Un Message Varint enviado a un par sin handshake (formato original) debe
+// llegar en ancho fijo, sin flags en el byte alto de la longitud. Tambien en
+// sentido contrario: un Client contra un Server que no acepta WireFeatureCompact,
+// y un Client que pide features contra un servidor del formato original.
+// Uso: main_legacy_peer [puerto]
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    timeval timeout = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static bool readExact(int fd, void* out, size_t size) {
+    char* bytes = static_cast<char*>(out);
+    while (size > 0) {
+        ssize_t got = recv(fd, bytes, size, 0);
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+template <typename T>
+static T take(const char*& cursor) {
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+}
+
+static Message sample(Message::Encoding encoding) {
+    Message message(7, encoding);
+    message << 300 << static_cast<int64_t>(-5) << std::string("hola")
+            << static_cast<uint16_t>(65000) << static_cast<short>(-2) << 'z';
+    return message;
+}
+
+static void serverToLegacyPeer(size_t port) {
+    Server server;
+    Message received;
+    bool echoRejected = false;
+    server.defineAction(7, [&](Server::ClientID&, const Message& message) {
+        received = message;
+    });
+    server.start(port);
+
+    int fd = connectRaw(port);
+    while (server.metrics().accepted < 1) {
+        std::this_thread::yield();
+    }
+    Server::ClientID legacyID = server.metrics().connections[0].clientID;
+    server.sendTo(sample(Message::Encoding::Varint), legacyID);
+
+    size_t header = 0;
+    Message::Type type = 0;
+    bool gotHeader = readExact(fd, &header, sizeof(header)) && readExact(fd, &type, sizeof(type));
+    check(gotHeader, "legacy peer receives a frame");
+    check((header >> 56) == 0, "no flags in the top byte of the legacy length");
+
+    Message fixed = sample(Message::Encoding::Fixed);
+    check(header == sizeof(Message::Type) + fixed.size(), "legacy length matches the fixed-width payload");
+    check(type == 7, "legacy peer reads the type");
+
+    std::string payload(header > sizeof(type) && header < 4096 ? header - sizeof(type) : 0, '\0');
+    check(!payload.empty() && readExact(fd, &payload[0], payload.size()), "legacy peer reads the payload");
+    if (payload.size() == fixed.size()) {
+        const char* cursor = payload.data();
+        int first = take<int>(cursor);
+        int64_t second = take<int64_t>(cursor);
+        size_t textSize = take<size_t>(cursor);
+        std::string text(cursor, textSize < 16 ? textSize : 0);
+        cursor += text.size();
+        uint16_t fourth = take<uint16_t>(cursor);
+        short fifth = take<short>(cursor);
+        char last = take<char>(cursor);
+        check(first == 300 && second == -5 && text == "hola" && fourth == 65000 && fifth == -2 && last == 'z',
+              "fields decode as fixed width");
+    }
+
+    // Un Message Varint recibido no sabe donde estan sus enteros: reenviarlo
+    // a un par legacy debe fallar en vez de mandar bytes ilegibles
+    Client client;
+    client.setWireFeatures(WireFeatureCompact);
+    client.connect("localhost", port);
+    client.send(sample(Message::Encoding::Varint));
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (received.type() != 7 && std::chrono::steady_clock::now() < deadline) {
+        server.update();
+    }
+    check(received.type() == 7 && received.encoding() == Message::Encoding::Varint,
+          "compact client keeps the varint encoding");
+    try {
+        server.sendTo(received, legacyID);
+    } catch (const Server::SendingFailedException&) {
+        echoRejected = true;
+    }
+    check(echoRejected, "received varint message is not relayed to a legacy peer");
+
+    client.disconnect();
+    close(fd);
+}
+
+static void clientToLegacyServer(size_t port) {
+    Server server;
+    server.setSupportedWireFeatures(0);
+    bool decoded = false;
+    bool done = false;
+    server.defineAction(7, [&](Server::ClientID&, const Message& message) {
+        int first;
+        int64_t second;
+        std::string text;
+        uint16_t fourth;
+        short fifth;
+        char last;
+        message >> first >> second >> text >> fourth >> fifth >> last;
+        decoded = message.encoding() == Message::Encoding::Fixed && first == 300 && second == -5
+            && text == "hola" && fourth == 65000 && fifth == -2 && last == 'z';
+        done = true;
+    });
+    server.start(port);
+
+    // Pide Compact, pero el servidor no lo acepta
+    Client client;
+    client.setWireFeatures(WireFeatureCompact);
+    client.connect("localhost", port);
+    client.send(sample(Message::Encoding::Varint));
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!done && std::chrono::steady_clock::now() < deadline) {
+        server.update();
+    }
+    check(decoded, "client sends fixed width to a server without compact");
+    client.disconnect();
+}
+
+// Servidor como el original: lee size_t de longitud y el mensaje, y no
+// responde a nada. Una longitud con flags en el byte alto lo haria reservar
+// ~2^63 bytes
+struct BaselineServer {
+    int listener = -1;
+    size_t port = 0;
+    std::vector<Message::Type> types;
+    bool saneLengths = true;
+};
+
+static void listenBaseline(BaselineServer& baseline) {
+    baseline.listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (bind(baseline.listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(baseline.listener, 1) != 0
+        || getsockname(baseline.listener, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        std::perror("listen");
+        std::exit(1);
+    }
+    baseline.port = ntohs(address.sin_port);
+}
+
+static void serveBaseline(BaselineServer& baseline, size_t frames) {
+    int fd = accept(baseline.listener, NULL, NULL);
+    timeval timeout = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (baseline.types.size() < frames) {
+        size_t length = 0;
+        if (!readExact(fd, &length, sizeof(length))) {
+            break;
+        }
+        if (length < sizeof(Message::Type) || length > 1024 * 1024) {
+            baseline.saneLengths = false;
+            break;
+        }
+        std::string data(length, '\0');
+        if (!readExact(fd, &data[0], length)) {
+            break;
+        }
+        Message::Type type;
+        std::memcpy(&type, data.data(), sizeof(type));
+        baseline.types.push_back(type);
+    }
+    close(fd);
+    close(baseline.listener);
+}
+
+static void clientToBaselineServer() {
+    BaselineServer baseline;
+    listenBaseline(baseline);
+    std::thread server(serveBaseline, std::ref(baseline), 2);
+
+    Client client;
+    client.setWireFeatures(WireFeatureCompact | WireFeatureCompression);
+    bool connected = true;
+    try {
+        client.connect("localhost", baseline.port);
+    } catch (const Client::ConnectionFailedException&) {
+        connected = false;
+    }
+    check(connected && client.wireFeatures() == 0, "Hello to a server without handshake falls back to Legacy");
+    if (connected) {
+        client.send(sample(Message::Encoding::Varint));
+    }
+    server.join();
+    client.disconnect();
+    check(baseline.saneLengths, "the Hello does not put flags in the length an original server reads");
+    check(baseline.types.size() == 2 && baseline.types[1] == 7,
+          "the original server reads the Hello as a message and then the client's messages");
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8097;
+
+    // Mas enteros de los que caben en la disposicion guardada dentro del Message
+    Message many(7, Message::Encoding::Varint);
+    for (int i = 0; i < 20; ++i) {
+        many << i * 1000 - 3000;
+    }
+    Message copied(many);
+    Message fixed;
+    bool converted = copied.toFixed(fixed) && fixed.size() == 20 * sizeof(int);
+    for (int i = 0; i < 20 && converted; ++i) {
+        int value;
+        fixed >> value;
+        converted = value == i * 1000 - 3000;
+    }
+    check(converted, "a copied varint message with many fields converts to fixed width");
+
+    serverToLegacyPeer(port);
+    clientToLegacyServer(port + 1);
+    clientToBaselineServer();
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
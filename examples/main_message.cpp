@@ -0,0 +1,202 @@
+#include "network/message.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <utility>
+
+// Almacenamiento de Message: payloads de hasta inlineCapacity bytes dentro del
+// objeto y los mayores en bloques del pool, copias a ambos lados del limite,
+// estado de un Message movido, bloques reciclados sin malloc en regimen
+// estable y el layout Varint (copiar o mover no reserva memoria).
+// Uso: main_message
+
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* block = std::malloc(size == 0 ? 1 : size);
+    if (block == NULL) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    std::free(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    std::free(block);
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static bool isInline(const Message& message) {
+    const char* begin = reinterpret_cast<const char*>(&message);
+    return message.data() >= begin && message.data() < begin + sizeof(Message);
+}
+
+static Message filled(size_t size, char value) {
+    Message message(1);
+    message.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        message << value;
+    }
+    return message;
+}
+
+static bool holds(const Message& message, size_t size, char value) {
+    if (message.size() != size) {
+        return false;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (message.data()[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void boundary() {
+    Message small = filled(Message::inlineCapacity, 's');
+    Message large = filled(Message::inlineCapacity + 1, 'l');
+    check(isInline(small) && !isInline(large), "payloads up to inlineCapacity stay inline, larger ones use a block");
+
+    Message smallCopy(small);
+    Message largeCopy(large);
+    check(isInline(smallCopy) && holds(smallCopy, Message::inlineCapacity, 's')
+          && !isInline(largeCopy) && largeCopy.data() != large.data()
+          && holds(largeCopy, Message::inlineCapacity + 1, 'l'),
+          "copies on each side of the boundary keep the payload in their own storage");
+
+    Message assigned = filled(Message::inlineCapacity * 4, 'x');
+    assigned = small;
+    bool shrunk = holds(assigned, Message::inlineCapacity, 's');
+    assigned = large;
+    check(shrunk && holds(assigned, Message::inlineCapacity + 1, 'l') && holds(large, Message::inlineCapacity + 1, 'l'),
+          "copy assignment across the boundary replaces the payload in both directions");
+
+    Message& self = assigned;
+    assigned = self;
+    check(holds(assigned, Message::inlineCapacity + 1, 'l'), "self assignment keeps the payload");
+
+    int value = 0;
+    Message grown(2);
+    grown << 7;
+    grown << std::string(200, 'g');
+    std::string text;
+    grown >> value >> text;
+    check(value == 7 && text == std::string(200, 'g') && !isInline(grown),
+          "growing past inlineCapacity keeps what was already written");
+}
+
+static void moves() {
+    Message inlineSource = filled(16, 'i');
+    Message inlineTarget(std::move(inlineSource));
+    check(holds(inlineTarget, 16, 'i') && isInline(inlineTarget), "moving an inline message copies its bytes");
+
+    Message blockSource = filled(1000, 'b');
+    const char* block = blockSource.data();
+    long before = allocations;
+    Message blockTarget(std::move(blockSource));
+    check(allocations == before && blockTarget.data() == block && holds(blockTarget, 1000, 'b'),
+          "moving a pooled message steals its block without allocating");
+    check(blockSource.size() == 0 && isInline(blockSource) && blockSource.type() == 1,
+          "a moved-from message is empty and back on its inline buffer");
+
+    blockSource << 42;
+    int value = 0;
+    blockSource >> value;
+    check(value == 42 && blockSource.size() == sizeof(int), "a moved-from message can be written and read again");
+
+    Message assigned = filled(500, 'a');
+    assigned = std::move(blockTarget);
+    check(assigned.data() == block && holds(assigned, 1000, 'b') && blockTarget.size() == 0,
+          "move assignment releases the old block and takes the new one");
+
+    bool threw = false;
+    try {
+        std::string missing;
+        blockTarget >> missing;
+    } catch (const Message::DeserializationFailedException&) {
+        threw = true;
+    }
+    check(threw, "reading past the end of a moved-from message throws");
+}
+
+static void pool() {
+    const char* first = NULL;
+    {
+        Message message = filled(1000, 'p');
+        first = message.data();
+    }
+    long before = allocations;
+    Message again = filled(1000, 'q');
+    check(allocations == before && again.data() == first, "a released block is reused by the next message of its size");
+
+    // La primera vuelta llena el pool; a partir de ahi solo se reciclan bloques
+    const std::string payload(3000, 'r');
+    for (int i = 0; i < 1001; ++i) {
+        if (i == 1) {
+            before = allocations;
+        }
+        Message message(3);
+        message << payload;
+        Message copy(message);
+        Message moved(std::move(copy));
+    }
+    check(allocations == before, "steady-state create, copy and move of pooled messages does not allocate");
+}
+
+static void varintLayout() {
+    Message message(4, Message::Encoding::Varint);
+    for (int i = 0; i < 4; ++i) {
+        message << static_cast<int32_t>(-i * 1000) << static_cast<uint16_t>(i);
+    }
+    long before = allocations;
+    Message copy(message);
+    Message moved(std::move(copy));
+    Message fixed;
+    bool converted = moved.toFixed(fixed);
+    check(allocations == before, "copying and moving a Varint message with a few fields does not allocate");
+
+    bool same = converted && fixed.encoding() == Message::Encoding::Fixed;
+    for (int i = 0; i < 4 && same; ++i) {
+        int32_t wide = 0;
+        uint16_t narrow = 0;
+        fixed >> wide >> narrow;
+        same = wide == -i * 1000 && narrow == i;
+    }
+    check(same, "the copied layout still converts to Encoding::Fixed");
+}
+
+int main() {
+    boundary();
+    moves();
+    pool();
+    varintLayout();
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+
+// Metricas de red: cubos y cuantiles de LatencyHistogram, contadores de
+// conexiones y de trafico de metrics() (totales y por conexion), mensajes a
+// la espera de update(), profundidad de la cola de salida con un par que no
+// lee, tiempos por handler y acceptRate.
+// Uso: main_metrics [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// metrics() se publica desde los event loops: esperar hasta que se cumpla
+static bool waitFor(const std::function<bool()>& condition) {
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (!condition() && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+}
+
+static int connectRaw(size_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int buffer = 16 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("connect");
+        std::exit(1);
+    }
+    return fd;
+}
+
+static void histogram() {
+    LatencyHistogram latency;
+    latency.record(std::chrono::nanoseconds(500));
+    latency.record(std::chrono::microseconds(3));
+    latency.record(std::chrono::microseconds(100));
+    latency.record(std::chrono::microseconds(1500));
+    LatencyHistogram::Snapshot snapshot = latency.snapshot();
+    check(snapshot.count == 4 && snapshot.buckets[0] == 1 && snapshot.buckets[2] == 1
+          && snapshot.buckets[7] == 1 && snapshot.buckets[11] == 1,
+          "each sample lands in its log2 microsecond bucket");
+    check(snapshot.totalNanoseconds == 1603500 && snapshot.meanMicroseconds() > 400.8
+          && snapshot.meanMicroseconds() < 400.9, "the snapshot keeps the total and the mean");
+    check(snapshot.percentileMicroseconds(0.0) == 1 && snapshot.percentileMicroseconds(0.5) == 128
+          && snapshot.percentileMicroseconds(0.99) == 2048,
+          "percentiles report the upper bound of their bucket");
+    check(LatencyHistogram::Snapshot().percentileMicroseconds(0.5) == 0
+          && LatencyHistogram::Snapshot().meanMicroseconds() == 0.0, "an empty snapshot reports zero");
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8122;
+    const int count = 10;
+    const std::string payload(100, 'm');
+
+    histogram();
+
+    Server server;
+    SocketOptions options;
+    options.sendBuffer = 16 * 1024;
+    server.setSocketOptions(options);
+    Server::ClientID clientID = -1;
+    server.defineAction(1, [&clientID](Server::ClientID& id, const Message&) {
+        clientID = id;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    server.start(port);
+    NetworkMetrics before = server.metrics();
+    check(before.accepted == 0 && before.closed == 0 && before.connections.empty() && before.handlers.count(1) == 1
+          && before.handlers[1].count == 0, "a fresh server reports no traffic and an empty histogram per action");
+
+    Client client;
+    std::atomic<int> replies(0);
+    client.defineAction(2, [&replies](const Message&) { ++replies; });
+    client.connect("localhost", port);
+    Message message(1);
+    message << payload;
+    for (int i = 0; i < count; ++i) {
+        client.send(message);
+    }
+
+    check(waitFor([&] { return server.metrics().pendingMessages == static_cast<uint64_t>(count); })
+          && server.metrics().pendingBytes >= count * payload.size(),
+          "received messages are pending until update()");
+    NetworkMetrics connected = server.metrics();
+    check(connected.accepted == 1 && connected.connections.size() == 1
+          && connected.connections[0].messagesIn == static_cast<uint64_t>(count)
+          && connected.messagesIn == static_cast<uint64_t>(count)
+          && connected.bytesIn >= count * payload.size(), "accepted, messagesIn and bytesIn count the connection");
+    check(connected.acceptRate(before) > 0.0 && before.acceptRate(connected) == 0.0,
+          "acceptRate is positive after an accept and zero backwards");
+
+    server.update();
+    NetworkMetrics handled = server.metrics();
+    const LatencyHistogram::Snapshot& times = handled.handlers[1];
+    check(handled.pendingMessages == 0 && handled.pendingBytes == 0, "update() empties the pending counters");
+    check(times.count == static_cast<uint64_t>(count) && times.meanMicroseconds() >= 2000.0
+          && times.percentileMicroseconds(0.5) >= 2048, "the handler histogram records each call and its duration");
+
+    Message reply(2);
+    reply << payload;
+    for (int i = 0; i < count; ++i) {
+        server.sendTo(reply, clientID);
+    }
+    waitFor([&] {
+        client.update();
+        return replies == count;
+    });
+    NetworkMetrics sent = server.metrics();
+    check(replies == count && sent.messagesOut >= static_cast<uint64_t>(count)
+          && sent.bytesOut >= count * payload.size() && sent.sendCalls > 0 && sent.ioSyscalls > 0,
+          "messagesOut, bytesOut and syscalls count the replies");
+
+    // Un par que no lee: lo que no cabe en los buffers del kernel queda en cola
+    int fd = connectRaw(port);
+    check(waitFor([&] { return server.metrics().connections.size() == 2; }), "a second connection is published");
+    Server::ClientID slowID = -1;
+    for (const ConnectionMetrics& connection : server.metrics().connections) {
+        if (connection.clientID != clientID) {
+            slowID = connection.clientID;
+        }
+    }
+    Message big(3);
+    big << std::string(64 * 1024, 'q');
+    for (int i = 0; i < 64; ++i) {
+        server.sendTo(big, slowID);
+    }
+    bool queued = waitFor([&] {
+        for (const ConnectionMetrics& connection : server.metrics().connections) {
+            if (connection.clientID == slowID) {
+                return connection.queuedBytes > 64 * 1024;
+            }
+        }
+        return false;
+    });
+    check(queued, "queuedBytes shows the backlog of a slow reader");
+
+    std::string sink(64 * 1024, '\0');
+    bool drained = waitFor([&] {
+        while (recv(fd, &sink[0], sink.size(), MSG_DONTWAIT) > 0) {
+        }
+        for (const ConnectionMetrics& connection : server.metrics().connections) {
+            if (connection.clientID == slowID) {
+                return connection.queuedMessages == 0 && connection.queuedBytes == 0;
+            }
+        }
+        return false;
+    });
+    check(drained, "the queue depth returns to zero once the reader catches up");
+
+    close(fd);
+    client.disconnect();
+    check(waitFor([&] {
+              NetworkMetrics last = server.metrics();
+              return last.closed == 2 && last.connections.empty();
+          }) && server.metrics().accepted == 2, "closed counts both connections and they leave the list");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
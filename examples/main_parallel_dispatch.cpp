@@ -0,0 +1,176 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Despacho paralelo: los mensajes de un mismo cliente se ejecutan en orden,
+// la excepcion de un handler se relanza en update(), waitForDispatch() o
+// setParallelDispatch() (una sola vez), y destruir el Server con una
+// excepcion pendiente no termina el programa.
+// Uso: main_parallel_dispatch [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Bombea update() hasta que handled llegue a count o venza el plazo
+static void pumpUntil(Server& server, std::atomic<int>& handled, int count) {
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (handled < count && Clock::now() < deadline) {
+        server.update();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+}
+
+// Server con un handler que lanza; el mensaje se despacha sin esperar
+static void throwingServer(Server& server, Client& client, std::atomic<int>& handled, size_t port) {
+    server.setParallelDispatch(2, false);
+    server.defineAction(2, [&handled](Server::ClientID&, const Message&) {
+        ++handled;
+        throw std::runtime_error("boom");
+    });
+    server.start(port);
+    client.connect("localhost", port);
+    client.send(Message(2));
+    pumpUntil(server, handled, 1);
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8111;
+
+    {
+        const int clients = 4;
+        const int perClient = 500;
+        Server server;
+        server.setParallelDispatch(4);
+        std::mutex mutex;
+        std::map<Server::ClientID, int> last;
+        bool inOrder = true;
+        std::atomic<int> handled(0);
+        server.defineAction(1, [&](Server::ClientID& clientID, const Message& message) {
+            int index;
+            message >> index;
+            std::lock_guard<std::mutex> lock(mutex);
+            std::map<Server::ClientID, int>::iterator it = last.find(clientID);
+            inOrder = inOrder && (it == last.end() ? index == 0 : index == it->second + 1);
+            last[clientID] = index;
+            ++handled;
+        });
+        server.start(port);
+
+        std::vector<std::unique_ptr<Client>> peers;
+        for (int c = 0; c < clients; ++c) {
+            peers.push_back(std::unique_ptr<Client>(new Client()));
+            peers.back()->connect("localhost", port);
+        }
+        for (int i = 0; i < perClient; ++i) {
+            for (auto& client : peers) {
+                Message message(1);
+                message << i;
+                client->send(message);
+            }
+        }
+        pumpUntil(server, handled, clients * perClient);
+        check(handled == clients * perClient && last.size() == static_cast<size_t>(clients) && inOrder,
+              "messages of each client run in order");
+        for (auto& client : peers) {
+            client->disconnect();
+        }
+    }
+
+    {
+        Server server;
+        server.setParallelDispatch(2, true);
+        server.defineAction(2, [](Server::ClientID&, const Message&) { throw std::runtime_error("boom"); });
+        server.start(port + 1);
+        Client client;
+        client.connect("localhost", port + 1);
+        client.send(Message(2));
+        bool rethrown = false;
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while (!rethrown && Clock::now() < deadline) {
+            try {
+                server.update();
+            } catch (const std::runtime_error& e) {
+                rethrown = std::string(e.what()) == "boom";
+            }
+        }
+        check(rethrown, "update() rethrows a handler exception when waiting for completion");
+        client.disconnect();
+    }
+
+    {
+        Server server;
+        Client client;
+        std::atomic<int> handled(0);
+        throwingServer(server, client, handled, port + 2);
+        bool rethrown = false;
+        try {
+            server.waitForDispatch();
+        } catch (const std::runtime_error& e) {
+            rethrown = std::string(e.what()) == "boom";
+        }
+        check(rethrown, "waitForDispatch() rethrows a handler exception");
+        bool again = false;
+        try {
+            server.waitForDispatch();
+        } catch (const std::exception&) {
+            again = true;
+        }
+        check(!again, "the exception is rethrown only once");
+
+        client.send(Message(2));
+        pumpUntil(server, handled, 2);
+        rethrown = false;
+        try {
+            server.setParallelDispatch(0);
+        } catch (const std::runtime_error&) {
+            rethrown = true;
+        }
+        std::atomic<int> after(0);
+        server.defineAction(3, [&after](Server::ClientID&, const Message&) { ++after; });
+        client.send(Message(3));
+        pumpUntil(server, after, 1);
+        check(rethrown && after == 1, "setParallelDispatch() rethrows after reconfiguring the pool");
+        client.disconnect();
+    }
+
+    // En un proceso hijo: si el destructor relanzara, std::terminate lo abortaria
+    std::fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        {
+            Server server;
+            Client client;
+            std::atomic<int> handled(0);
+            throwingServer(server, client, handled, port + 3);
+            client.disconnect();
+        }
+        std::_Exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+          "destroying the Server with a pending handler exception does not terminate");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
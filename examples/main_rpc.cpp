@@ -0,0 +1,158 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// RPC sobre Server/Client: peticiones en vuelo con future y con callback,
+// errores del handler remoto, tipos sin handler, timeouts y futures
+// pendientes al desconectar.
+// Uso: main_rpc [puerto]
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// update() del servidor en otro hilo mientras vive
+class Pump {
+public:
+    explicit Pump(Server& server) : server(server), running(true), thread(&Pump::run, this) {}
+
+    ~Pump() {
+        stop();
+    }
+
+    void stop() {
+        running = false;
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+private:
+    Server& server;
+    std::atomic<bool> running;
+    std::thread thread;
+
+    void run() {
+        while (running) {
+            server.update();
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+};
+
+static Message request(int value) {
+    Message message(10);
+    message << value;
+    return message;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8098;
+
+    Server server;
+    server.defineRequestAction(10, [](Server::ClientID&, const Message& message) {
+        int value;
+        message >> value;
+        Message response(11);
+        response << value * 3;
+        return response;
+    });
+    server.defineRequestAction(12, [](Server::ClientID&, const Message&) -> Message {
+        throw std::runtime_error("boom");
+    });
+    server.start(port);
+
+    Client client;
+    client.connect("localhost", port);
+    std::unique_ptr<Pump> pump(new Pump(server));
+
+    // Muchas en vuelo a la vez: cada respuesta va a su future
+    std::vector<std::future<Message>> futures;
+    for (int i = 0; i < 200; ++i) {
+        futures.push_back(client.call(request(i)));
+    }
+    bool matched = true;
+    for (int i = 0; i < 200; ++i) {
+        Message response = futures[i].get();
+        int value;
+        response >> value;
+        matched = matched && response.type() == 11 && value == 3 * i;
+    }
+    check(matched, "pipelined futures get their own responses");
+
+    // Los callbacks se ejecutan en update()
+    int answered = 0;
+    for (int i = 0; i < 50; ++i) {
+        client.call(request(i), [&answered, i](const Message& response, std::exception_ptr error) {
+            int value = 0;
+            if (!error) {
+                response >> value;
+            }
+            if (value == 3 * i) {
+                ++answered;
+            }
+        });
+    }
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (answered < 50 && std::chrono::steady_clock::now() < deadline) {
+        client.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(answered == 50, "callbacks run in update() with their responses");
+
+    std::string remoteError;
+    try {
+        client.call(Message(12)).get();
+    } catch (const Client::RemoteErrorException& e) {
+        remoteError = e.what();
+    }
+    check(remoteError.find("boom") != std::string::npos, "handler exception arrives as RemoteErrorException");
+
+    bool noHandler = false;
+    try {
+        client.call(Message(99)).get();
+    } catch (const Client::RemoteErrorException&) {
+        noHandler = true;
+    }
+    check(noHandler, "request without handler fails with RemoteErrorException");
+
+    // Sin update() en el servidor nadie responde
+    pump->stop();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool timedOut = false;
+    try {
+        client.call(request(1), std::chrono::milliseconds(100)).get();
+    } catch (const Client::RequestTimeoutException&) {
+        timedOut = true;
+    }
+    std::chrono::milliseconds waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    check(timedOut && waited.count() >= 100 && waited.count() < 1000, "unanswered call times out after ~100 ms");
+
+    std::future<Message> pending = client.call(request(2));
+    client.disconnect();
+    bool failedOnDisconnect = false;
+    try {
+        pending.get();
+    } catch (const Client::NotConnectedException&) {
+        failedOnDisconnect = true;
+    }
+    check(failedOnDisconnect, "pending future fails with NotConnectedException on disconnect");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Coalescencia de envios: muchos hilos enviando a la vez (con y sin
+// maxDelay) o un eco con update() en su hilo no dejan mensajes sin salir
+// por un aviso perdido, un sendTo con
+// OverflowPolicy::Block dentro de update() o de un SendBatch no espera hasta
+// blockTimeout, y una cola por encima de highWatermark sale aunque haya un
+// SendBatch abierto o un maxDelay largo.
+// Uso: main_send_coalescing [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Cliente que recibe en su propio hilo y cuenta los mensajes de tipo 2
+class Receiver {
+public:
+    Receiver(Server& server, size_t port) : received(0), stop(false) {
+        server.defineAction(1, [this](Server::ClientID& clientID, const Message&) { id = clientID; });
+        client.defineAction(2, [this](const Message&) { ++received; });
+        client.connect("localhost", port);
+        client.send(Message(1));
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+        while (id < 0 && Clock::now() < deadline) {
+            server.update();
+        }
+        pump = std::thread([this] {
+            while (!stop) {
+                client.update();
+            }
+        });
+    }
+
+    ~Receiver() {
+        stop = true;
+        pump.join();
+        client.disconnect();
+    }
+
+    // Espera hasta tener count mensajes; devuelve si llegaron antes de timeout
+    bool waitFor(int count, std::chrono::milliseconds timeout) {
+        Clock::time_point deadline = Clock::now() + timeout;
+        while (received < count && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        return received >= count;
+    }
+
+    Server::ClientID id = -1;
+    std::atomic<int> received;
+
+private:
+    Client client;
+    std::atomic<bool> stop;
+    std::thread pump;
+};
+
+// Varios hilos enviando mensajes pequeños, algunos dentro de un SendBatch
+static bool concurrentSends(size_t port, std::chrono::microseconds maxDelay) {
+    Server server;
+    SendCoalescing coalescing;
+    coalescing.maxDelay = maxDelay;
+    server.setSendCoalescing(coalescing);
+    server.start(port);
+
+    const int threads = 4;
+    const int perThread = 5000;
+    Receiver receiver(server, port);
+    std::vector<std::thread> senders;
+    for (int t = 0; t < threads; ++t) {
+        senders.emplace_back([&server, &receiver, t] {
+            Message message(2);
+            message << std::string(32, 's');
+            for (int i = 0; i < perThread; ++i) {
+                if (t % 2 == 0 && i % 10 == 0) {
+                    Server::SendBatch batch(server);
+                    server.sendTo(message, receiver.id);
+                    server.sendTo(message, receiver.id);
+                    ++i;
+                } else {
+                    server.sendTo(message, receiver.id);
+                }
+            }
+        });
+    }
+    for (std::thread& sender : senders) {
+        sender.join();
+    }
+    return receiver.waitFor(threads * perThread, std::chrono::seconds(10));
+}
+
+// Eco en bucle con update() en otro hilo durante duration: cada respuesta
+// sale al cerrarse el SendBatch de update(), a menudo mientras el event loop
+// atiende el aviso anterior. Falla si pasa un segundo sin ninguna respuesta
+static bool pingPong(size_t port, int clients, std::chrono::milliseconds duration) {
+    Server server;
+    server.defineAction(4, [&server](Server::ClientID& clientID, const Message& message) {
+        server.sendTo(message, clientID);
+    });
+    server.start(port);
+    std::atomic<bool> running(true);
+    std::thread updater([&server, &running] {
+        while (running) {
+            server.update();
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    });
+
+    std::vector<std::unique_ptr<Client>> peers;
+    Clock::time_point lastReply = Clock::now();
+    for (int c = 0; c < clients; ++c) {
+        Client* client = new Client();
+        peers.push_back(std::unique_ptr<Client>(client));
+        client->defineAction(4, [client, &lastReply](const Message& message) {
+            lastReply = Clock::now();
+            client->send(message);
+        });
+        client->connect("localhost", port);
+    }
+    Message ping(4);
+    ping << std::string(16, 'p');
+    for (auto& client : peers) {
+        for (int d = 0; d < 16; ++d) {
+            client->send(ping);
+        }
+    }
+    Clock::time_point end = Clock::now() + duration;
+    bool stalled = false;
+    while (!stalled && Clock::now() < end) {
+        for (auto& client : peers) {
+            client->update();
+        }
+        stalled = Clock::now() - lastReply > std::chrono::seconds(1);
+    }
+    for (auto& client : peers) {
+        client->disconnect();
+    }
+    running = false;
+    updater.join();
+    return !stalled;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8106;
+
+    check(concurrentSends(port, std::chrono::microseconds(0)),
+          "concurrent sends all arrive without maxDelay");
+    check(concurrentSends(port + 1, std::chrono::microseconds(200)),
+          "concurrent sends all arrive with maxDelay");
+    check(pingPong(port + 2, 64, std::chrono::seconds(5)),
+          "echo round trips with update() in its own thread never stall");
+
+    {
+        // Cola pequeña con Block: los envios esperan a que salgan los
+        // anteriores, que estan retenidos por el SendBatch del llamante
+        Server server;
+        SendQueueLimits limits;
+        limits.maxBytes = 4096;
+        limits.highWatermark = 2048;
+        limits.lowWatermark = 512;
+        limits.policy = OverflowPolicy::Block;
+        limits.blockTimeout = std::chrono::milliseconds(2000);
+        server.setSendQueueLimits(limits);
+        server.start(port + 3);
+        Receiver receiver(server, port + 3);
+        server.defineAction(3, [&server, &receiver](Server::ClientID&, const Message&) {
+            Message message(2);
+            message << std::string(1000, 'a');
+            for (int i = 0; i < 20; ++i) {
+                server.sendTo(message, receiver.id);
+            }
+        });
+
+        Clock::time_point start = Clock::now();
+        bool threw = false;
+        try {
+            Server::SendBatch batch(server);
+            Message message(2);
+            message << std::string(1000, 'b');
+            for (int i = 0; i < 20; ++i) {
+                server.sendTo(message, receiver.id);
+            }
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(!threw && receiver.waitFor(20, std::chrono::milliseconds(1000))
+              && Clock::now() - start < limits.blockTimeout,
+              "Block inside a SendBatch does not wait for blockTimeout");
+
+        Client trigger;
+        trigger.connect("localhost", port + 3);
+        trigger.send(Message(3));
+        start = Clock::now();
+        threw = false;
+        try {
+            while (receiver.received < 40 && Clock::now() - start < std::chrono::seconds(3)) {
+                server.update();
+            }
+        } catch (const std::exception&) {
+            threw = true;
+        }
+        check(!threw && receiver.received == 40 && Clock::now() - start < limits.blockTimeout,
+              "Block inside an action run by update() does not wait for blockTimeout");
+        trigger.disconnect();
+    }
+
+    {
+        // maxDelay largo y SendBatch abierto: solo highWatermark saca el mensaje
+        Server server;
+        SendQueueLimits limits;
+        limits.highWatermark = 64 * 1024;
+        limits.lowWatermark = 16 * 1024;
+        server.setSendQueueLimits(limits);
+        SendCoalescing coalescing;
+        coalescing.maxDelay = std::chrono::seconds(3);
+        coalescing.maxBytes = 64 * 1024 * 1024;
+        server.setSendCoalescing(coalescing);
+        server.start(port + 4);
+        Receiver receiver(server, port + 4);
+
+        Message big(2);
+        big << std::string(256 * 1024, 'h');
+        Server::SendBatch batch(server);
+        server.sendTo(big, receiver.id);
+        check(receiver.waitFor(1, std::chrono::milliseconds(1000)),
+              "a queue above highWatermark is flushed while a SendBatch is open");
+    }
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+
+// Transporte de memoria compartida (shm://): eco en orden de mensajes de
+// todos los tamaños, incluidos mayores que un anillo, RPC, cierre detectado
+// por el servidor y reconexion. El servidor no abre ningun puerto TCP.
+// Uso: main_shm_endpoint
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Tamaño del mensaje i: pequeños, medianos y alguno mayor que el anillo
+static size_t sizeOf(int i) {
+    if (i % 50 == 49) {
+        return 3 * ShmChannel::defaultRingCapacity;
+    }
+    return static_cast<size_t>(i % 7) * 1000;
+}
+
+static char fillOf(int i) {
+    return static_cast<char>('a' + i % 26);
+}
+
+// Envia count mensajes y comprueba que el eco vuelve entero y en orden
+static bool echo(Server& server, Client& client, int count) {
+    int next = 0;
+    bool inOrder = true;
+    client.defineAction(2, [&next, &inOrder](const Message& message) {
+        int index;
+        std::string text;
+        message >> index >> text;
+        inOrder = inOrder && index == next && text == std::string(sizeOf(index), fillOf(index));
+        ++next;
+    });
+    for (int i = 0; i < count; ++i) {
+        Message message(1);
+        message << i << std::string(sizeOf(i), fillOf(i));
+        client.send(message);
+    }
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(20);
+    while (next < count && Clock::now() < deadline) {
+        server.update();
+        client.update();
+    }
+    return inOrder && next == count;
+}
+
+int main() {
+    std::string address = "shm://main_shm_endpoint_" + std::to_string(getpid());
+
+    Server server;
+    server.defineAction(1, [&server](Server::ClientID& clientID, const Message& message) {
+        Message reply(2);
+        int index;
+        std::string text;
+        message >> index >> text;
+        reply << index << text;
+        server.sendTo(reply, clientID);
+    });
+    server.defineRequestAction(3, [](Server::ClientID&, const Message& request) {
+        int value;
+        request >> value;
+        Message response(4);
+        response << value + 1;
+        return response;
+    });
+    server.start(address);
+
+    {
+        Client client;
+        client.connect(address, 0);
+        check(echo(server, client, 200), "echo arrives whole and in order, including frames larger than the ring");
+
+        // El future se completa sin update() del cliente; el servidor si lo necesita
+        std::atomic<bool> answered(false);
+        std::thread pump([&server, &answered] {
+            while (!answered) {
+                server.update();
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        });
+        Message request(3);
+        request << 41;
+        int value = 0;
+        try {
+            client.call(request).get() >> value;
+        } catch (const std::exception&) {
+        }
+        answered = true;
+        pump.join();
+        check(value == 42, "RPC works over shm");
+        client.disconnect();
+    }
+
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(3);
+    while (server.metrics().closed < 1 && Clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    check(server.metrics().closed == 1, "server notices the disconnect");
+
+    Client again;
+    again.connect(address, 0);
+    check(echo(server, again, 20), "a new client can connect after the first leaves");
+    again.disconnect();
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streams por trozos: dos ficheros a la vez (con sendfile, por TCP y por
+// unix) y un stream generado llegan enteros y en orden, sin mezclarse, y
+// sin WireFeatureStreams negociado sendStream lanza. shm:// no negocia
+// WireFeature, asi que no admite streams.
+// Uso: main_stream [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Byte esperado en cada posicion: un trozo fuera de orden no coincide
+static char patternAt(uint64_t position, unsigned seed) {
+    return static_cast<char>((position * 31 + position / 4093 + seed) & 0xff);
+}
+
+// Comprueba los trozos de cada stream segun llegan
+struct Received {
+    uint64_t bytes = 0;
+    size_t chunks = 0;
+    bool inOrder = true;
+    bool done = false;
+    bool aborted = false;
+};
+
+static void accept(Received& stream, const StreamChunk& chunk, unsigned seed) {
+    for (size_t i = 0; i < chunk.size; ++i) {
+        if (chunk.data[i] != patternAt(stream.bytes + i, seed)) {
+            stream.inOrder = false;
+            break;
+        }
+    }
+    stream.bytes += chunk.size;
+    ++stream.chunks;
+    if (chunk.last) {
+        stream.done = true;
+        stream.aborted = chunk.aborted;
+    }
+}
+
+static std::string writeFile(uint64_t size, unsigned seed) {
+    char path[] = "/tmp/main_stream_XXXXXX";
+    int fd = mkstemp(path);
+    std::vector<char> block(1 << 16);
+    for (uint64_t written = 0; fd >= 0 && written < size; written += block.size()) {
+        for (size_t i = 0; i < block.size(); ++i) {
+            block[i] = patternAt(written + i, seed);
+        }
+        if (write(fd, block.data(), block.size()) != static_cast<ssize_t>(block.size())) {
+            std::perror("write");
+            std::exit(1);
+        }
+    }
+    close(fd);
+    return path;
+}
+
+static void runTransport(const char* name, const std::string& address, Server& server, size_t port,
+                         const std::string& path, uint64_t fileSize) {
+    Server::ClientID clientID = -1;
+    server.defineAction(1, [&clientID](Server::ClientID& id, const Message&) { clientID = id; });
+    std::map<uint64_t, Received> upstream;
+    server.defineStreamAction(5, [&upstream](Server::ClientID&, const StreamChunk& chunk) {
+        accept(upstream[chunk.streamID], chunk, 3);
+    });
+
+    Client client;
+    client.setWireFeatures(WireFeatureCompact | WireFeatureStreams);
+    client.connect(address, port);
+    client.send(Message(1));
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (clientID < 0 && Clock::now() < deadline) {
+        server.update();
+    }
+
+    // Dos streams del mismo fichero a la vez: cada uno debe llegar entero y
+    // en su orden aunque sus trozos se intercalen
+    std::map<uint64_t, Received> downstream;
+    client.defineStreamAction(7, [&downstream](const StreamChunk& chunk) {
+        accept(downstream[chunk.streamID], chunk, 1);
+    });
+    Server::StreamID first = server.sendFile(clientID, 7, path);
+    Server::StreamID second = server.sendFile(clientID, 7, path);
+
+    // Y uno generado en el sentido contrario, en trozos de tamaño irregular
+    uint64_t generated = 0;
+    const uint64_t generatedSize = 3 * 1024 * 1024 + 17;
+    client.sendStream(5, std::make_shared<StreamSource>([&generated, generatedSize](char* buffer, size_t capacity) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(std::min<size_t>(capacity, 7777), generatedSize - generated));
+        for (size_t i = 0; i < size; ++i) {
+            buffer[i] = patternAt(generated + i, 3);
+        }
+        generated += size;
+        return size;
+    }));
+
+    deadline = Clock::now() + std::chrono::seconds(20);
+    while ((!downstream[first].done || !downstream[second].done || !upstream[1].done)
+           && Clock::now() < deadline) {
+        client.update();
+        server.update();
+    }
+
+    std::string label = std::string(name) + ": ";
+    const Received& a = downstream[first];
+    const Received& b = downstream[second];
+    check(a.done && b.done && !a.aborted && !b.aborted, (label + "both file streams complete").c_str());
+    check(a.bytes == fileSize && b.bytes == fileSize, (label + "file streams deliver every byte").c_str());
+    check(a.inOrder && b.inOrder && a.chunks > 1 && b.chunks > 1,
+          (label + "file chunks reassemble in order per stream").c_str());
+    const Received& up = upstream[1];
+    check(up.done && !up.aborted && up.bytes == generatedSize && up.inOrder,
+          (label + "generated client stream arrives whole and in order").c_str());
+    client.disconnect();
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8101;
+    const uint64_t fileSize = 8 * 1024 * 1024;
+    std::string path = writeFile(fileSize, 1);
+    std::string unixAddress = "unix://@main_stream_" + std::to_string(getpid());
+
+    {
+        Server server;
+        server.addEndpoint(unixAddress);
+        server.start(port);
+        runTransport("tcp", "localhost", server, port, path, fileSize);
+        runTransport("unix", unixAddress, server, port, path, fileSize);
+    }
+
+    {
+        Server server;
+        server.start(port + 1);
+        Client client;
+        client.connect("localhost", port + 1);
+        bool unavailable = false;
+        try {
+            client.sendFile(5, path);
+        } catch (const Client::StreamsUnavailableException&) {
+            unavailable = true;
+        }
+        check(unavailable, "sendStream without WireFeatureStreams throws");
+        client.disconnect();
+    }
+
+    unlink(path.c_str());
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
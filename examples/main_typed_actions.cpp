@@ -0,0 +1,162 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+// Acciones tipadas: makeMessage y MessageCodec (el de copia directa y uno
+// especializado, en Fixed y en Varint) ida y vuelta, DispatchTable con types
+// densos (< maxDenseType) y en el mapa de reserva (>= 4096 y negativos), y
+// defineAction<T> en Server y Client a traves de la red.
+// Uso: main_typed_actions [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+// Trivialmente copiable: MessageCodec por defecto
+struct Move {
+    static const Message::Type messageType = 7;
+    int x;
+    int y;
+    double speed;
+};
+
+// Con un string y un type fuera de la tabla densa: MessageCodec especializado
+struct Chat {
+    static const Message::Type messageType = 5000;
+    int channel;
+    std::string text;
+};
+
+template <>
+struct MessageCodec<Chat> {
+    static void encode(Message& message, const Chat& value) {
+        message << value.channel << value.text;
+    }
+    static void decode(const Message& message, Chat& value) {
+        message >> value.channel >> value.text;
+    }
+};
+
+static void codecs() {
+    Move move = {3, -4, 1.5};
+    Message message = makeMessage(move);
+    Move decoded = {0, 0, 0.0};
+    MessageCodec<Move>::decode(message, decoded);
+    check(message.type() == Move::messageType && message.size() == sizeof(Move)
+          && decoded.x == 3 && decoded.y == -4 && decoded.speed == 1.5,
+          "makeMessage copies a trivially copyable struct and decodes it back");
+
+    Chat chat = {-2, "hola"};
+    Chat fixed;
+    Chat varint;
+    Message fixedMessage = makeMessage(chat);
+    Message varintMessage = makeMessage(chat, Message::Encoding::Varint);
+    MessageCodec<Chat>::decode(fixedMessage, fixed);
+    MessageCodec<Chat>::decode(varintMessage, varint);
+    check(fixedMessage.type() == Chat::messageType && fixed.channel == -2 && fixed.text == "hola",
+          "a specialized MessageCodec round-trips with Encoding::Fixed");
+    check(varint.channel == -2 && varint.text == "hola" && varintMessage.size() < fixedMessage.size(),
+          "a specialized MessageCodec round-trips with Encoding::Varint");
+}
+
+static void dispatchTable() {
+    typedef DispatchTable<int&> Table;
+    Table table;
+    table.define(0, [](int& seen, const Message&) { seen = 0; });
+    table.define(Table::maxDenseType - 1, [](int& seen, const Message&) { seen = 1; });
+    table.define(Table::maxDenseType, [](int& seen, const Message&) { seen = 2; });
+    table.define(1 << 20, [](int& seen, const Message&) { seen = 3; });
+    table.define(-5, [](int& seen, const Message&) { seen = 4; });
+    table.define<Chat>([](int& seen, const Chat& chat) { seen = chat.channel; });
+
+    const Message::Type types[] = {0, Table::maxDenseType - 1, Table::maxDenseType, 1 << 20, -5};
+    bool routed = true;
+    for (int i = 0; i < 5; ++i) {
+        int seen = -1;
+        routed = routed && table.contains(types[i]) && table.dispatch(seen, Message(types[i])) && seen == i;
+    }
+    check(routed, "types below and above maxDenseType, and negative ones, reach their handler");
+
+    int seen = -1;
+    Chat chat = {42, "fallback"};
+    check(table.dispatch(seen, makeMessage(chat)) && seen == 42,
+          "a typed handler above maxDenseType decodes through the fallback map");
+
+    check(!table.dispatch(seen, Message(1)) && !table.dispatch(seen, Message(4097)) && !table.contains(-6),
+          "types without a handler are not dispatched");
+
+    table.remove(Table::maxDenseType - 1);
+    table.remove(1 << 20);
+    check(!table.contains(Table::maxDenseType - 1) && !table.contains(1 << 20) && table.contains(0)
+          && table.contains(Table::maxDenseType), "remove() clears dense and fallback entries only");
+
+    Table copy = table;
+    copy.define(0, [](int& seen, const Message&) { seen = 10; });
+    int original = -1;
+    int copied = -1;
+    table.dispatch(original, Message(0));
+    copy.dispatch(copied, Message(0));
+    check(original == 0 && copied == 10, "redefining a type in a copy leaves the original table intact");
+}
+
+static void overTheNetwork(size_t port) {
+    Server server;
+    std::atomic<int> moves(0);
+    bool moveOk = false;
+    server.defineAction<Move>([&](Server::ClientID& clientID, const Move& move) {
+        moveOk = move.x == 10 + moves && move.y == -1 && move.speed == 0.25;
+        ++moves;
+        Chat reply = {move.x, "ack"};
+        server.sendTo(makeMessage(reply, Message::Encoding::Varint), clientID);
+    });
+    server.start(port);
+
+    Client client;
+    std::atomic<int> chats(0);
+    int lastChannel = -1;
+    std::string lastText;
+    client.defineAction<Chat>([&](const Chat& chat) {
+        lastChannel = chat.channel;
+        lastText = chat.text;
+        ++chats;
+    });
+    client.connect("localhost", port);
+    for (int i = 0; i < 3; ++i) {
+        Move move = {10 + i, -1, 0.25};
+        client.send(makeMessage(move));
+    }
+
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(5);
+    while (chats < 3 && Clock::now() < deadline) {
+        server.update();
+        client.update();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    check(moves == 3 && moveOk, "Server::defineAction<T> decodes each message into T");
+    check(chats == 3 && lastChannel == 12 && lastText == "ack",
+          "Client::defineAction<T> decodes a Varint reply with a type above maxDenseType");
+    client.disconnect();
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8121;
+
+    codecs();
+    dispatchTable();
+    overTheNetwork(port);
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+#include "network/server.hpp"
+#include "network/client.hpp"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Endpoints AF_UNIX: en ruta de fichero junto al listener TCP y en el espacio
+// abstracto sin TCP. Eco en orden por los dos, el mismo handshake que por TCP,
+// un socket viejo en la ruta se reemplaza y el fichero se borra al destruir
+// el Server.
+// Uso: main_unix_endpoint [puerto]
+
+typedef std::chrono::steady_clock Clock;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    std::printf("%s %s\n", condition ? "[OK]  " : "[FAIL]", what);
+    if (!condition) {
+        ++failures;
+    }
+}
+
+static bool exists(const std::string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+// Deja en path un socket sin nadie escuchando, como tras una caida
+static void leaveStaleSocket(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::perror("bind");
+        std::exit(1);
+    }
+    close(fd);
+}
+
+static void defineEcho(Server& server) {
+    server.defineAction(1, [&server](Server::ClientID& clientID, const Message& message) {
+        int index;
+        std::string text;
+        message >> index >> text;
+        Message reply(2);
+        reply << index << text;
+        server.sendTo(reply, clientID);
+    });
+}
+
+static bool echo(Server& server, Client& client, int count) {
+    int next = 0;
+    bool inOrder = true;
+    client.defineAction(2, [&next, &inOrder](const Message& message) {
+        int index;
+        std::string text;
+        message >> index >> text;
+        inOrder = inOrder && index == next && text.size() == static_cast<size_t>(index) * 997;
+        ++next;
+    });
+    for (int i = 0; i < count; ++i) {
+        Message message(1);
+        message << i << std::string(static_cast<size_t>(i) * 997, 'u');
+        client.send(message);
+    }
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+    while (next < count && Clock::now() < deadline) {
+        server.update();
+        client.update();
+    }
+    return inOrder && next == count;
+}
+
+int main(int argc, char** argv) {
+    size_t port = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 8103;
+    std::string path = "/tmp/main_unix_endpoint_" + std::to_string(getpid()) + ".sock";
+    std::string pathAddress = "unix://" + path;
+    std::string abstractAddress = "unix://@main_unix_endpoint_" + std::to_string(getpid());
+
+    leaveStaleSocket(path);
+    {
+        Server server;
+        defineEcho(server);
+        server.addEndpoint(pathAddress);
+        bool started = true;
+        try {
+            server.start(port);
+        } catch (const Server::StartFailedException&) {
+            started = false;
+        }
+        check(started, "a stale socket file at the path is replaced");
+        if (!started) {
+            return 1;
+        }
+
+        Client local;
+        local.connect(pathAddress, 0);
+        check(echo(server, local, 100), "path endpoint echoes in order");
+
+        Client compact;
+        compact.setWireFeatures(WireFeatureCompact | WireFeatureFragments);
+        compact.connect(pathAddress, 0);
+        check((compact.wireFeatures() & WireFeatureCompact) != 0, "unix clients negotiate wire features");
+        check(echo(server, compact, 100), "negotiated unix client echoes in order");
+
+        Client tcp;
+        tcp.connect("localhost", port);
+        check(echo(server, tcp, 20), "the TCP listener keeps working next to the unix endpoint");
+
+        local.disconnect();
+        compact.disconnect();
+        tcp.disconnect();
+    }
+    check(!exists(path), "socket file is removed when the Server is destroyed");
+
+    {
+        Server server;
+        defineEcho(server);
+        server.start(abstractAddress);
+        Client client;
+        client.connect(abstractAddress, 0);
+        check(echo(server, client, 100), "abstract endpoint echoes in order without TCP");
+        client.disconnect();
+    }
+
+    bool refused = false;
+    try {
+        Client client;
+        client.connect(abstractAddress, 0);
+    } catch (const Client::ConnectionFailedException&) {
+        refused = true;
+    }
+    check(refused, "connecting to a closed unix endpoint fails");
+
+    std::printf("%s\n", failures == 0 ? "All checks passed" : "Some checks FAILED");
+    return failures == 0 ? 0 : 1;
+}
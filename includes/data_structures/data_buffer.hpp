@@ -1,7 +1,8 @@
 #ifndef DATA_BUFFER_HPP
 #define DATA_BUFFER_HPP
 
-#include <vector>
+#include <cstddef>
+#include <memory>
 #include <stdexcept>
 #include <string>
 
@@ -10,8 +11,9 @@
  * @brief Contenedor polimórfico para almacenar objetos en formato de bytes.
  * 
  * Esta clase proporciona un buffer dinámico que permite serializar y deserializar
- * objetos de diferentes tipos en formato binario. Utiliza un vector de caracteres
- * como almacenamiento subyacente y mantiene posiciones separadas para lectura y escritura.
+ * objetos de diferentes tipos en formato binario. Utiliza un bloque de bytes sin
+ * inicializar que crece de forma geométrica como almacenamiento subyacente y
+ * mantiene posiciones separadas para lectura y escritura.
  * 
  * Características principales:
  * - Serialización/deserialización de tipos básicos y objetos complejos
@@ -22,9 +24,10 @@
  */
 class DataBuffer {
 private:
-    std::vector<char> buffer;  ///< Almacenamiento interno de datos en formato de bytes
-    size_t read_pos;           ///< Posición actual para operaciones de lectura
-    size_t write_pos;          ///< Posición actual para operaciones de escritura
+    std::unique_ptr<char[]> buffer;  ///< Almacenamiento interno (sin inicializar más allá de write_pos)
+    size_t buffer_capacity;          ///< Bytes reservados en buffer
+    size_t read_pos;                 ///< Posición actual para operaciones de lectura
+    size_t write_pos;                ///< Posición actual para operaciones de escritura
 
 public:
     // ============ CONSTRUCTORES Y DESTRUCTOR ============
@@ -50,7 +53,7 @@ public:
     
     /**
      * @brief Destructor.
-     * Libera automáticamente todos los recursos gracias al uso de std::vector.
+     * Libera automáticamente todos los recursos gracias al uso de std::unique_ptr.
      */
     ~DataBuffer();
 
@@ -75,10 +78,33 @@ public:
     /**
      * @brief Limpia completamente el buffer.
      * 
-     * Reinicia todas las posiciones y libera la memoria del vector.
-     * El buffer queda listo para ser reutilizado.
+     * Reinicia todas las posiciones pero conserva la memoria reservada, de modo
+     * que reutilizar el buffer no vuelve a reservar. Ver shrink_to_fit().
      */
     void clear();
+
+    /**
+     * @brief Reserva memoria para al menos capacity bytes.
+     * @param capacity Número de bytes a reservar.
+     * 
+     * @note Útil cuando se conoce el tamaño final: evita las reservas intermedias.
+     * Nunca reduce la capacidad.
+     */
+    void reserve(size_t capacity);
+
+    /**
+     * @brief Obtiene la memoria reservada actualmente.
+     * @return Número de bytes que se pueden escribir sin volver a reservar.
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Ajusta la memoria reservada a los datos escritos.
+     * 
+     * Libera la capacidad sobrante, por ejemplo tras un pico de uso en un
+     * buffer de larga vida. Con el buffer vacío libera toda la memoria.
+     */
+    void shrink_to_fit();
     
     /**
      * @brief Verifica si el buffer está vacío.
@@ -144,9 +170,16 @@ private:
      * @brief Garantiza que el buffer tenga capacidad suficiente.
      * @param needed Número mínimo de bytes necesarios.
      * 
-     * Redimensiona el vector interno si es necesario para acomodar los bytes requeridos.
+     * Si no caben, duplica la capacidad (o usa needed si es mayor), de modo que
+     * escribir n bytes en total cuesta O(n) copias amortizadas.
      */
     void ensure_capacity(size_t needed);
+
+    /**
+     * @brief Cambia el bloque de memoria conservando los datos escritos.
+     * @param capacity Nueva capacidad, mayor o igual que write_pos.
+     */
+    void reallocate(size_t capacity);
     
     /**
      * @brief Escribe un bloque de bytes en el buffer.
@@ -2,6 +2,7 @@
 #define DATA_BUFFER_TPP
 
 #include "data_buffer.hpp"
+#include <cstring>
 
 // ============ IMPLEMENTACIONES DE TEMPLATES ============
 
@@ -19,6 +20,9 @@
  *       - Tipos booleanos (bool)
  *       - Estructuras simples sin punteros ni manejo dinámico de memoria
  * 
+ * @note Si el dato cabe en la capacidad reservada se copia aquí mismo (en
+ *       línea en el llamante); solo al crecer se pasa por write_bytes.
+ *
  * @warning No usar con tipos complejos que requieran constructores de copia
  *          o que contengan punteros a memoria dinámica.
  */
@@ -28,6 +32,13 @@ DataBuffer& DataBuffer::operator<<(const T& data)
     // Convertir el dato a un array de bytes usando reinterpret_cast
     const char* bytes = reinterpret_cast<const char*>(&data);
     
+    // Camino rápido: hay sitio, sin reservar ni llamar a write_bytes
+    if (buffer_capacity - write_pos >= sizeof(T)) {
+        std::memcpy(buffer.get() + write_pos, bytes, sizeof(T));
+        write_pos += sizeof(T);
+        return *this;
+    }
+
     // Escribir los bytes en el buffer
     write_bytes(bytes, sizeof(T));
     
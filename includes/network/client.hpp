@@ -2,11 +2,22 @@
 # define LIBFTPP_CLIENT_HPP
 
 # include "network/message.hpp"
+# include "network/frame.hpp"
+# include "network/flow_control.hpp"
+# include "network/shm_channel.hpp"
+# include "network/datagram_socket.hpp"
+# include "network/dispatch_table.hpp"
+# include "network/stream.hpp"
+# include "network/socket_options.hpp"
 # include <functional>
+# include <chrono>
+# include <future>
+# include <map>
 # include <queue>
 # include <atomic>
 # include <thread>
 # include <mutex>
+# include <condition_variable>
 # include <unordered_map>
 # include <stdexcept>
 # include <string>
@@ -14,16 +25,75 @@
 class Client {
 public:
     using Action = std::function<void(const Message& msg)>;
+    using BackpressureCallback = std::function<void(SendQueueEvent event)>;
+    using RequestID = uint64_t;
+    // Resultado de call(): error es null si llego la respuesta
+    using ResponseCallback = std::function<void(const Message& response, std::exception_ptr error)>;
+    using StreamID = uint64_t;
+    using StreamAction = std::function<void(const StreamChunk& chunk)>;
+
+    static const long defaultCallTimeoutMs = 5000;
 
     Client();
     ~Client();
 
+    // address "unix:///ruta" o "unix://@nombre" usa un socket AF_UNIX, y
+    // "shm://nombre" memoria compartida, con un Server de la misma maquina
+    // que escuche en esa direccion (port se ignora en ambos)
     void connect(const std::string& address, const size_t& port);
     void disconnect();
     void defineAction(const Message::Type& messageType, const Action& action);
-    void send(const Message& message);
+    // Accion tipada: handler(const T&) para T::messageType, decodificado con MessageCodec<T>
+    template <typename T, typename Handler>
+    void defineAction(const Handler& handler);
+    // Ver Server::sendTo para priority
+    void send(const Message& message, SendPriority priority = SendPriority::Normal);
     void update();
 
+    // Ver Server::sendStream. Solo con WireFeatureStreams negociado (si no,
+    // StreamsUnavailableException); sendfile solo por TCP o unix.
+    StreamID sendStream(Message::Type type, const std::shared_ptr<StreamSource>& source,
+                        SendPriority priority = SendPriority::Bulk);
+    StreamID sendFile(Message::Type type, const std::string& path, SendPriority priority = SendPriority::Bulk);
+    // Trozos de los streams del servidor, en update() y en orden con los mensajes
+    void defineStreamAction(const Message::Type& messageType, const StreamAction& action);
+
+    // Canal UDP (ver Server::enableDatagrams). Solo con WireFeatureDatagrams
+    // aceptado en el handshake de una conexion TCP; si no, lanza
+    // DatagramsUnavailableException. Los recibidos pasan por las acciones.
+    void sendDatagram(const Message& message);
+    bool hasDatagrams() const;
+
+    // RPC sobre la misma conexion: cada peticion lleva un ID de correlacion y
+    // la responde el RequestAction del servidor para su tipo. Se pueden tener
+    // muchas en vuelo y las respuestas se emparejan en cualquier orden.
+    // El future se completa desde el hilo de red (sin depender de update());
+    // el callback se ejecuta en update(), como las acciones.
+    // Errores: RequestTimeoutException, RemoteErrorException, y
+    // NotConnectedException en los futures pendientes al desconectar
+    // (los callbacks pendientes se descartan).
+    std::future<Message> call(const Message& request,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds(defaultCallTimeoutMs));
+    void call(const Message& request, const ResponseCallback& callback,
+              std::chrono::milliseconds timeout = std::chrono::milliseconds(defaultCallTimeoutMs));
+
+    // WireFeature a pedir en el handshake de connect(); 0 = sin handshake (Legacy).
+    // Contra un servidor sin handshake connect() espera la respuesta al Hello
+    // unos 2 s y sigue en Legacy. Sin handshake el Server no envia Heartbeat
+    // (ver Server::ConnectionTimeouts)
+    void setWireFeatures(uint32_t features);
+    uint32_t wireFeatures() const;
+
+    void setSendQueueLimits(const SendQueueLimits& limits);
+    // Antes de connect()
+    void setLaneScheduling(const LaneScheduling& scheduling);
+    // Antes de connect(). backlog se ignora; en shm:// no se aplica nada.
+    // ConnectionFailedException si el kernel rechaza alguna opcion
+    void setSocketOptions(const SocketOptions& options);
+    // Antes de connect(). Ver Server::setCompressionThreshold
+    void setCompressionThreshold(size_t threshold);
+    void setBackpressureCallback(const BackpressureCallback& callback);
+
     class AlreadyConnectedException : public std::exception {
         const char* what() const noexcept;
     };
@@ -42,19 +112,132 @@ public:
         explicit SendingFailedException();
     };
 
+    class DatagramsUnavailableException : public std::exception {
+        const char* what() const noexcept;
+    };
+
+    class DatagramTooLargeException : public std::runtime_error {
+    public:
+        explicit DatagramTooLargeException();
+    };
+
+    class StreamsUnavailableException : public std::exception {
+        const char* what() const noexcept;
+    };
+
+    class RequestTimeoutException : public std::runtime_error {
+    public:
+        explicit RequestTimeoutException();
+    };
+
+    // El handler del servidor lanzo una excepcion (o no habia handler)
+    class RemoteErrorException : public std::runtime_error {
+    public:
+        explicit RemoteErrorException(const std::string& msg);
+    };
+
 private:
     int sockfd;
+    int epollFd;
+    int wakeFd;
+    SocketOptions socketOptions;
+    bool tcpSocket;   // TCP_QUICKACK se rearma tras cada recv
     std::atomic<bool> isConnected;
     std::atomic<bool> shouldStop;
 
-    std::thread receiverThread;
+    std::thread eventLoopThread;
+    FrameReader reader;
+    FrameWriter writer;
+    // Anillos compartidos si la conexion es shm; sockfd es entonces el socket de encuentro
+    std::unique_ptr<ShmChannel> shm;
     std::mutex mutex;
-    std::queue<Message> receivedMessages;
-    std::queue<Message> messagesToSend;
-    std::unordered_map<Message::Type, Action> actions;
+    std::condition_variable drained;
+    // Mensaje o trozo de stream (streamID != 0) a la espera de update()
+    struct Inbound {
+        Message message;
+        StreamID streamID;
+
+        Inbound(Message&& message, StreamID streamID = 0);
+    };
+    std::queue<Inbound> receivedMessages;
+    std::queue<FrameHandle> messagesToSend;
+    // Copy-on-write: update() solo copia el puntero, no la tabla
+    std::shared_ptr<const DispatchTable<>> actions;
+    typedef std::unordered_map<Message::Type, StreamAction> StreamActionMap;
+    std::shared_ptr<const StreamActionMap> streamActions;
+    std::atomic<StreamID> nextStreamID;
+    // Bytes de trozos de stream recibidos que aun no paso update(); la parte
+    // ya en receivedMessages esta en queuedStreamBytes (protegida por mutex).
+    // Con defaultStreamWindow se deja de leer hasta que update() despierte.
+    std::atomic<size_t> pendingStreamBytes;
+    size_t queuedStreamBytes;
+    std::atomic<bool> readsPaused;
 
-    void receiverLoop();
-    void sendMessage(const Message& message);
+    // Estado de la cola de salida, protegido por mutex
+    SendQueueLimits limits;
+    BackpressureCallback backpressureCallback;
+    size_t queuedBytes;
+    bool congested;
+    bool overflowed;
+
+    uint32_t requestedWireFeatures;
+    std::atomic<uint32_t> negotiatedWireFeatures;
+    size_t compressionThreshold;
+
+    // Canal UDP conectado a la misma direccion que el socket TCP. La cola y
+    // las secuencias de envio se protegen con mutex.
+    DatagramSocket datagrams;
+    uint64_t datagramSession;
+    DatagramSequences datagramSequences;
+    std::vector<DatagramSocket::Outgoing> datagramQueue;
+
+    // Llamadas RPC en vuelo, protegidas por callMutex. Los plazos se ordenan
+    // en callDeadlines para que el event loop duerma justo hasta el primero.
+    typedef std::multimap<std::chrono::steady_clock::time_point, RequestID> DeadlineMap;
+    struct PendingCall {
+        std::promise<Message> promise;
+        ResponseCallback callback;
+        DeadlineMap::iterator deadline;
+    };
+    struct Completion {
+        ResponseCallback callback;
+        Message response;
+        std::exception_ptr error;
+    };
+    std::mutex callMutex;
+    std::unordered_map<RequestID, PendingCall> pendingCalls;
+    DeadlineMap callDeadlines;
+    RequestID nextRequestID;
+    std::queue<Completion> completions; // Protegida por mutex, se vacia en update()
+
+    void editActions(const std::function<void(DispatchTable<>&)>& edit);
+    void sendFrame(const FrameHandle& frame);
+    void startCall(const Message& request, PendingCall&& pending, std::chrono::milliseconds timeout);
+    void completeCall(RequestID requestID, Message&& response, std::exception_ptr error);
+    void expireCalls();
+    int nextCallTimeout();
+    void failPendingCalls();
+    void eventLoop();
+    void wakeUp();
+    void connectSocket(const std::string& address, const size_t& port);
+    void connectShm(const std::string& name);
+    void negotiateIfRequested();
+    void negotiateWireFeatures();
+    bool readFromServer();
+    bool streamsFull() const;
+    bool drainFrames(std::queue<Inbound>& parsed);
+    bool flushPendingMessages();
+    bool flushWriter();
+    bool openDatagrams();
+    void queueDatagram(const FrameHandle& frame);
+    void receiveDatagrams();
+    void notifyBackpressure(SendQueueEvent event);
+    void closeDescriptors();
 };
 
+template <typename T, typename Handler>
+void Client::defineAction(const Handler& handler) {
+    editActions([&handler](DispatchTable<>& table) { table.template define<T>(handler); });
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#ifndef LIBFTPP_COMPRESSION_HPP
+# define LIBFTPP_COMPRESSION_HPP
+
+# include <cstddef>
+
+// Compresion de bloques en el formato de bloque de LZ4: secuencias de
+// [token][literales][offset de 16 bits][longitud extra], con busqueda
+// voraz de coincidencias por tabla hash de 4 bytes. Sin estado entre
+// bloques ni diccionario: cada payload se comprime por separado.
+
+// Tamaño maximo de la salida de compressBlock para size bytes de entrada
+size_t compressBound(size_t size);
+// Devuelve los bytes escritos en out (que debe tener compressBound(size))
+size_t compressBlock(const char* data, size_t size, char* out);
+// Descomprime exactamente outSize bytes. Lanza si el bloque es invalido
+// o no produce outSize bytes; nunca lee ni escribe fuera de los buffers.
+void decompressBlock(const char* data, size_t size, char* out, size_t outSize);
+
+#endif
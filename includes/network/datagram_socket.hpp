@@ -0,0 +1,78 @@
+#ifndef LIBFTPP_DATAGRAM_SOCKET_HPP
+# define LIBFTPP_DATAGRAM_SOCKET_HPP
+
+# include "network/frame.hpp"
+# include <sys/socket.h>
+# include <unordered_map>
+# include <vector>
+
+// Numeros de secuencia por Message::Type: el emisor numera cada tipo por
+// separado y el receptor descarta lo que no sea mas nuevo que lo ultimo
+// aceptado de ese tipo (gana el valor mas reciente).
+class DatagramSequences {
+public:
+    uint64_t next(Message::Type type);
+    bool accept(Message::Type type, uint64_t sequence);
+
+private:
+    std::unordered_map<Message::Type, uint64_t> sent;
+    std::unordered_map<Message::Type, uint64_t> received;
+};
+
+// Socket UDP no bloqueante que envia y recibe por lotes (sendmmsg/recvmmsg).
+// Cada datagrama es [uint64_t token][uint64_t secuencia][frame Compact] con
+// un solo Message; el token identifica la conexion TCP a la que pertenece.
+// No es fiable ni ordenado: lo que no cabe en el buffer del socket se descarta.
+class DatagramSocket {
+public:
+    // MTU de Ethernet menos las cabeceras IP y UDP: sin fragmentacion IP
+    static const size_t maxDatagramSize = 1472;
+    static const size_t headerSize = 2 * sizeof(uint64_t);
+    static const size_t batchSize = 32;
+
+    struct Outgoing {
+        FrameHandle frame;
+        uint64_t token;
+        uint64_t sequence;
+        sockaddr_storage address;
+        socklen_t addressLength;   // 0 en un socket conectado
+    };
+
+    struct Incoming {
+        uint64_t token;
+        uint64_t sequence;
+        sockaddr_storage address;
+        socklen_t addressLength;
+        uint8_t flags;
+        Message message;
+    };
+
+    DatagramSocket();
+    ~DatagramSocket();
+
+    bool bind(size_t port);
+    // Lado cliente: solo envia a y recibe de address
+    bool connect(const sockaddr* address, socklen_t addressLength);
+    void close();
+    int fd() const;
+
+    // Devuelve cuantos datagramas se enviaron
+    size_t send(const std::vector<Outgoing>& datagrams);
+    // Lee hasta vaciar el socket (edge-triggered); descarta los mal formados
+    void receive(std::vector<Incoming>& received);
+
+    static bool fits(const OutboundFrame& frame);
+
+private:
+    int socketFd;
+    FrameReader reader;
+    std::vector<char> buffers;
+
+    DatagramSocket(const DatagramSocket&);
+    DatagramSocket& operator=(const DatagramSocket&);
+
+    bool open(int family);
+    bool parse(const char* data, size_t size, Incoming& incoming);
+};
+
+#endif
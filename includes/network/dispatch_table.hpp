@@ -0,0 +1,72 @@
+#ifndef LIBFTPP_DISPATCH_TABLE_HPP
+# define LIBFTPP_DISPATCH_TABLE_HPP
+
+# include "network/message.hpp"
+# include <memory>
+# include <vector>
+# include <unordered_map>
+# include <type_traits>
+
+// Como se escribe/lee un struct de mensaje tipado. Por defecto el struct se
+// copia entero con << / >> (solo tipos trivialmente copiables); los structs
+// con strings o contenedores especializan MessageCodec.
+template <typename T>
+struct MessageCodec {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "MessageCodec: specialize MessageCodec<T> for non trivially copyable message structs");
+
+    static void encode(Message& message, const T& value);
+    static void decode(const Message& message, T& value);
+};
+
+// Message de un struct tipado: T declara static const Message::Type messageType
+template <typename T>
+Message makeMessage(const T& value, Message::Encoding encoding = Message::Encoding::Fixed);
+
+// Handlers indexados por Message::Type. Los types pequeños y no negativos (lo
+// habitual) van en un vector denso; el resto en un mapa. Cada entrada guarda
+// un puntero a una funcion que decodifica el struct y llama al handler, asi
+// que despachar es un acceso indexado y una llamada indirecta, sin hash.
+// Copiar la tabla comparte los handlers (copy-on-write en Server y Client).
+template <typename... Args>
+class DispatchTable {
+public:
+    static const Message::Type maxDenseType = 4096;
+
+    // handler(args..., const Message&)
+    template <typename Handler>
+    void define(Message::Type type, const Handler& handler);
+    // handler(args..., const T&), con el type de T::messageType
+    template <typename T, typename Handler>
+    void define(const Handler& handler);
+    void remove(Message::Type type);
+
+    // false si no hay handler para el type del mensaje
+    bool dispatch(Args... args, const Message& message) const;
+    bool contains(Message::Type type) const;
+
+private:
+    typedef void (*Invoker)(const void* handler, Args... args, const Message& message);
+
+    struct Entry {
+        Invoker invoke;
+        std::shared_ptr<const void> handler;
+
+        Entry();
+    };
+
+    std::vector<Entry> dense;
+    std::unordered_map<Message::Type, Entry> sparse;
+
+    template <typename Handler>
+    static void invokeRaw(const void* handler, Args... args, const Message& message);
+    template <typename T, typename Handler>
+    static void invokeTyped(const void* handler, Args... args, const Message& message);
+
+    void set(Message::Type type, Invoker invoke, const std::shared_ptr<const void>& handler);
+    const Entry* find(Message::Type type) const;
+};
+
+# include "dispatch_table.tpp"
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef LIBFTPP_DISPATCH_TABLE_TPP
+# define LIBFTPP_DISPATCH_TABLE_TPP
+# include "dispatch_table.hpp"
+
+template <typename T>
+void MessageCodec<T>::encode(Message& message, const T& value) {
+    message << value;
+}
+
+template <typename T>
+void MessageCodec<T>::decode(const Message& message, T& value) {
+    message >> value;
+}
+
+template <typename T>
+Message makeMessage(const T& value, Message::Encoding encoding) {
+    Message message(T::messageType, encoding);
+    MessageCodec<T>::encode(message, value);
+    return message;
+}
+
+template <typename... Args>
+const Message::Type DispatchTable<Args...>::maxDenseType;
+
+template <typename... Args>
+DispatchTable<Args...>::Entry::Entry()
+: invoke(nullptr) {}
+
+template <typename... Args>
+template <typename Handler>
+void DispatchTable<Args...>::define(Message::Type type, const Handler& handler) {
+    typedef typename std::decay<Handler>::type Stored;
+    set(type, &invokeRaw<Stored>, std::make_shared<const Stored>(handler));
+}
+
+template <typename... Args>
+template <typename T, typename Handler>
+void DispatchTable<Args...>::define(const Handler& handler) {
+    typedef typename std::decay<Handler>::type Stored;
+    set(T::messageType, &invokeTyped<T, Stored>, std::make_shared<const Stored>(handler));
+}
+
+template <typename... Args>
+void DispatchTable<Args...>::remove(Message::Type type) {
+    if (type >= 0 && type < maxDenseType) {
+        if (static_cast<size_t>(type) < dense.size()) {
+            dense[static_cast<size_t>(type)] = Entry();
+        }
+    } else {
+        sparse.erase(type);
+    }
+}
+
+template <typename... Args>
+bool DispatchTable<Args...>::dispatch(Args... args, const Message& message) const {
+    const Entry* entry = find(message.type());
+    if (!entry) {
+        return false;
+    }
+    entry->invoke(entry->handler.get(), args..., message);
+    return true;
+}
+
+template <typename... Args>
+bool DispatchTable<Args...>::contains(Message::Type type) const {
+    return find(type) != nullptr;
+}
+
+template <typename... Args>
+template <typename Handler>
+void DispatchTable<Args...>::invokeRaw(const void* handler, Args... args, const Message& message) {
+    (*static_cast<const Handler*>(handler))(args..., message);
+}
+
+template <typename... Args>
+template <typename T, typename Handler>
+void DispatchTable<Args...>::invokeTyped(const void* handler, Args... args, const Message& message) {
+    T value;
+    MessageCodec<T>::decode(message, value);
+    (*static_cast<const Handler*>(handler))(args..., static_cast<const T&>(value));
+}
+
+template <typename... Args>
+void DispatchTable<Args...>::set(Message::Type type, Invoker invoke, const std::shared_ptr<const void>& handler) {
+    Entry entry;
+    entry.invoke = invoke;
+    entry.handler = handler;
+    if (type >= 0 && type < maxDenseType) {
+        if (dense.size() <= static_cast<size_t>(type)) {
+            dense.resize(static_cast<size_t>(type) + 1);
+        }
+        dense[static_cast<size_t>(type)] = entry;
+    } else {
+        sparse[type] = entry;
+    }
+}
+
+template <typename... Args>
+const typename DispatchTable<Args...>::Entry* DispatchTable<Args...>::find(Message::Type type) const {
+    if (type >= 0 && type < maxDenseType) {
+        if (static_cast<size_t>(type) >= dense.size() || !dense[static_cast<size_t>(type)].invoke) {
+            return nullptr;
+        }
+        return &dense[static_cast<size_t>(type)];
+    }
+    auto it = sparse.find(type);
+    return it == sparse.end() ? nullptr : &it->second;
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef LIBFTPP_FLOW_CONTROL_HPP
+# define LIBFTPP_FLOW_CONTROL_HPP
+
+# include <chrono>
+# include <cstddef>
+
+// Que hacer cuando un envio superaria maxBytes en la cola de una conexion
+enum class OverflowPolicy {
+    Drop,        // Descartar el mensaje nuevo
+    Disconnect,  // Cerrar la conexion lenta
+    Block        // Bloquear al llamante hasta que haya sitio o venza blockTimeout
+};
+
+// Transiciones notificadas por el callback de backpressure
+enum class SendQueueEvent {
+    Congested,   // La cola supero highWatermark
+    Drained,     // La cola volvio a bajar de lowWatermark
+    Overflow     // Se aplico la OverflowPolicy (Drop o Disconnect)
+};
+
+// Limites de la cola de salida de una conexion, en bytes de frame
+// (mensajes encolados + pendientes de escribir en el socket).
+// Por defecto la cola no tiene limite y solo se avisa por el callback al
+// cruzar las marcas: un consumidor lento nunca frena a quien envia. Block
+// hay que pedirlo, junto con un maxBytes.
+struct SendQueueLimits {
+    size_t highWatermark = 4 * 1024 * 1024;
+    size_t lowWatermark = 1024 * 1024;
+    size_t maxBytes = 0;   // 0 = sin limite
+    OverflowPolicy policy = OverflowPolicy::Drop;
+    std::chrono::milliseconds blockTimeout = std::chrono::milliseconds(5000);
+};
+
+// Cuando se despierta al event loop para escribir lo encolado por sendTo y
+// compañia. Todo lo pendiente de una conexion sale junto en un sendmsg, asi
+// que retener los envios un poco junta mas mensajes por syscall.
+struct SendCoalescing {
+    // Cuanto puede esperar un envio a que se le unan otros (0 = despertar ya)
+    std::chrono::microseconds maxDelay = std::chrono::microseconds(0);
+    // Con maxDelay o dentro de un SendBatch: si lo retenido en el event loop
+    // llega a maxBytes se le despierta sin esperar
+    size_t maxBytes = 64 * 1024;
+};
+
+// Que hacer con los mensajes de un cliente que supera InboundLimits
+enum class ShedPolicy {
+    Pause,       // Dejar de leer su socket hasta tener credito (backpressure de TCP)
+    Drop,        // Leer y descartar los mensajes que exceden
+    Disconnect   // Cerrar la conexion
+};
+
+// Bytes de trozos de stream recibidos que pueden esperar a update(); al
+// llegar, se deja de leer y TCP frena al emisor (ver StreamSource)
+const size_t defaultStreamWindow = 8 * 1024 * 1024;
+
+// Admision de mensajes entrantes. Cada cliente tiene un cubo de tokens de
+// mensajes y otro de bytes de payload (rate 0 = sin limite, burst 0 = un
+// segundo de rate). maxPending* acota lo que espera a update() sumando
+// todos los clientes (0 = sin limite); al superarlo nunca se desconecta:
+// con Disconnect se descarta.
+// Los trozos de stream no pasan por los cubos ni se descartan (el stream
+// quedaria incompleto): solo los acota maxPendingStreamBytes, pausando.
+struct InboundLimits {
+    double messagesPerSecond = 0;
+    double messageBurst = 0;
+    double bytesPerSecond = 0;
+    double byteBurst = 0;
+    size_t maxPendingMessages = 0;
+    size_t maxPendingBytes = 0;
+    size_t maxPendingStreamBytes = defaultStreamWindow;   // 0 = sin limite
+    ShedPolicy policy = ShedPolicy::Pause;
+};
+
+// Carril de salida de un mensaje. El orden solo se garantiza dentro de un carril.
+enum class SendPriority {
+    High = 0,    // Control y mensajes pequeños sensibles a la latencia
+    Normal = 1,
+    Bulk = 2     // Transferencias grandes
+};
+
+const size_t sendPriorityCount = 3;
+
+// Reparto de la conexion entre carriles. Los frames con payload mayor que
+// chunkSize se trocean (si el otro extremo negocio WireFeatureFragments)
+// para que un frame urgente pueda colarse entre dos trozos.
+struct LaneScheduling {
+    bool strict = false;   // true: siempre el carril mas prioritario con datos
+    // Round robin ponderado por trozo/frame, indexado por SendPriority
+    unsigned weights[sendPriorityCount] = {8, 4, 1};
+    size_t chunkSize = 64 * 1024;   // 0 = no trocear
+};
+
+#endif
@@ -0,0 +1,317 @@
+#ifndef LIBFTPP_FRAME_HPP
+# define LIBFTPP_FRAME_HPP
+
+# include "network/message.hpp"
+# include <deque>
+# include <vector>
+# include <memory>
+# include <mutex>
+# include <cstdint>
+# include "network/varint.hpp"
+# include "network/flow_control.hpp"
+# include "network/stream.hpp"
+# include <sys/types.h>
+
+// Formatos en el cable, elegidos por conexion durante el handshake:
+//  Legacy:  [size_t flags<<56 | longitud][Message::Type][payload]
+//           longitud = sizeof(Message::Type) + payload. Con flags = 0 es el
+//           formato original byte a byte.
+//  Compact: [varint longitud][flags][varint zigzag(type)][payload]
+//           longitud = bytes que siguen al varint de longitud.
+// Los frames RPC (FrameRequest/FrameResponse) llevan ademas el ID de
+// correlacion entre el type y el payload: uint64_t en Legacy, varint en Compact.
+// Los trozos de un frame grande (FrameFragment) repiten la cabecera del frame
+// y añaden un byte: carril | fragmentLast en el ultimo trozo. El receptor
+// junta los trozos de cada carril y entrega el mensaje al llegar el ultimo.
+// Un payload comprimido (FrameCompressed) es [varint tamaño original][bloque
+// LZ4, ver compression.hpp]; se trocea despues de comprimir.
+// Los trozos de un stream (FrameStream) llevan el ID del stream en el lugar
+// del ID de correlacion y un cuerpo [info][datos] (ver StreamChunk).
+enum class WireFormat { Legacy, Compact };
+
+// Capacidades que se negocian en el handshake (mascara de bits)
+enum WireFeature : uint32_t {
+    WireFeatureCompact = 1u << 0,
+    WireFeatureFragments = 1u << 1,  // Acepta frames troceados (FrameFragment)
+    WireFeatureCompression = 1u << 2,// Acepta payloads comprimidos (FrameCompressed)
+    WireFeatureDatagrams = 1u << 3,  // Canal UDP paralelo (ver DatagramSocket)
+    WireFeatureStreams = 1u << 4     // Acepta streams por trozos (FrameStream)
+};
+
+// Payloads mas pequeños no se comprimen aunque se haya negociado
+const size_t defaultCompressionThreshold = 4096;
+
+enum FrameFlag : uint8_t {
+    FrameVarintPayload = 0x01,  // Campos enteros codificados con Message::Encoding::Varint
+    FrameRequest = 0x02,        // Peticion RPC: lleva ID de correlacion
+    FrameResponse = 0x04,       // Respuesta RPC al ID de correlacion que lleva
+    FrameRemoteError = 0x08,    // Con FrameResponse: el payload es el error del handler (string)
+    FrameFragment = 0x10,       // Trozo de un frame mayor; nunca llega a los handlers
+    FrameCompressed = 0x20,     // Payload comprimido; el receptor lo descomprime
+    FrameStream = 0x40,         // Trozo de un stream: va a las acciones de stream
+    FrameControl = 0x80         // Frame interno de la libreria, nunca llega a los handlers
+};
+
+// Tipos de los frames de control (van en el campo type). El Hello no es
+// un frame de control: ver helloMessageType
+enum class ControlType : Message::Type {
+    HelloAck = 2,   // servidor -> cliente: uint32_t con las WireFeature aceptadas,
+                    // y el uint64_t token del canal UDP si incluye WireFeatureDatagrams
+    Heartbeat = 3,  // servidor -> cliente tras un rato sin enviar nada
+    HeartbeatAck = 4, // cliente -> servidor: respuesta al Heartbeat
+    DatagramHello = 5 // cliente -> servidor por UDP: da a conocer su direccion
+};
+
+// Frame listo para enviar: las cabeceras se codifican una vez y el payload se
+// envia directamente desde el Message, sin pasar por serialize().
+// Es inmutable, asi que un mismo frame se comparte entre todas las colas de
+// un broadcast mediante FrameHandle, aunque cada conexion use otro formato.
+// La forma comprimida se calcula la primera vez que una conexion la pide y
+// la comparten las demas. Los metodos con compressed = true solo son validos
+// si compress() devolvio true.
+// Un frame de stream no lleva payload: es la plantilla de cabecera de sus
+// trozos, que el FrameWriter genera leyendo stream() segun puede enviar.
+class OutboundFrame;
+using FrameHandle = std::shared_ptr<const OutboundFrame>;
+
+class OutboundFrame {
+public:
+    static const size_t legacyHeaderSize = sizeof(size_t) + sizeof(Message::Type);
+    static const size_t maxLegacyHeaderSize = legacyHeaderSize + sizeof(uint64_t);
+    static const size_t maxCompactHeaderSize = 3 * maxVarintSize + 1;
+    static const size_t maxFragmentHeaderSize = maxCompactHeaderSize + 1;
+    static const uint8_t fragmentLast = 0x80;
+
+    // correlationId solo se escribe si flags incluye FrameRequest o FrameResponse
+    explicit OutboundFrame(const Message& message, uint8_t flags = 0, uint64_t correlationId = 0,
+                           SendPriority priority = SendPriority::Normal);
+    OutboundFrame(Message::Type type, uint64_t streamID, const std::shared_ptr<StreamSource>& source,
+                  SendPriority priority);
+
+    size_t size(WireFormat format, bool compressed = false) const;
+    // Rellena hasta 2 iovecs con los bytes del frame a partir de offset
+    size_t fillIovec(struct iovec* iov, size_t offset, WireFormat format, bool compressed = false) const;
+
+    Message::Type type() const;
+    SendPriority priority() const;
+    bool isControl() const;
+    const char* payload(bool compressed = false) const;
+    size_t payloadSize(bool compressed = false) const;
+    size_t headerSize(WireFormat format, bool compressed = false) const;
+    // Cabecera de un trozo de chunkSize bytes del payload; devuelve su tamaño
+    size_t encodeFragmentHeader(char* out, WireFormat format, size_t chunkSize, uint8_t info,
+                                bool compressed = false) const;
+    // Null salvo en los frames de stream
+    const std::shared_ptr<StreamSource>& stream() const;
+    // Cabecera de un trozo de stream de chunkSize bytes, con su byte de info
+    size_t encodeStreamHeader(char* out, WireFormat format, size_t chunkSize, uint8_t info) const;
+
+    // Comprime el payload (una sola vez, thread-safe). false si es menor que
+    // threshold, es un frame de control o comprimido no ocuparia menos.
+    bool compress(size_t threshold) const;
+    // Con FrameVarintPayload: el mismo frame con los enteros en ancho fijo,
+    // para las conexiones sin WireFeatureCompact (se calcula una vez,
+    // thread-safe). Null si el Message no sabe reescribirse (Message::toFixed)
+    FrameHandle fixedWidth() const;
+    bool varintPayload() const;
+
+private:
+    // Cabeceras y payload de una forma del frame
+    struct Form {
+        char legacyHeader[maxLegacyHeaderSize];
+        char compactHeader[maxCompactHeaderSize];
+        size_t legacyHeaderLength;
+        size_t compactHeaderSize;
+        std::vector<char> storage;  // Solo la forma comprimida
+        const char* payload;
+        size_t payloadSize;
+    };
+
+    void encodeForm(Form& form, uint8_t formFlags) const;
+    size_t encodeHeader(char* out, WireFormat format, uint8_t flags, size_t bodySize) const;
+    const Form& form(bool compressed) const;
+
+    Form plain;
+    uint8_t flags;
+    uint64_t correlationId;
+    SendPriority lane;
+    Message message;
+    mutable std::once_flag compressOnce;
+    mutable std::unique_ptr<Form> packed;
+    mutable std::once_flag fixedOnce;
+    mutable std::shared_ptr<const OutboundFrame> fixed;
+    std::shared_ptr<StreamSource> source;
+};
+
+FrameHandle makeFrame(const Message& message, uint8_t flags = 0, uint64_t correlationId = 0,
+                      SendPriority priority = SendPriority::Normal);
+FrameHandle makeControlFrame(ControlType type, uint32_t value);
+
+// El Hello (cliente -> servidor: helloMagic y el uint32_t con las WireFeature
+// pedidas) va como un mensaje normal sin flags con un tipo reservado. Un
+// servidor sin handshake lo lee como un mensaje sin accion y no responde, asi
+// que el cliente sigue en Legacy; con FrameControl el flag caeria en su
+// longitud. La respuesta (ControlType::HelloAck) si es un frame de control.
+const Message::Type helloMessageType = -0x6c696266;
+const uint64_t helloMagic = 0x6c69626674707068ULL;
+FrameHandle makeHelloFrame(uint32_t features);
+// Si msg, recibido con flags, es un Hello: deja en features las pedidas
+bool parseHello(const Message& msg, uint8_t flags, uint32_t& features);
+FrameHandle makeStreamFrame(Message::Type type, uint64_t streamID, const std::shared_ptr<StreamSource>& source,
+                            SendPriority priority = SendPriority::Bulk);
+// El frame tal como puede ir a una conexion en format: un payload Varint en
+// Legacy pasa a ancho fijo (el par no lo sabria leer y el flag pisaria el
+// byte alto de la longitud). Null si no se puede reescribir.
+FrameHandle frameForFormat(const FrameHandle& frame, WireFormat format);
+// Bytes escritos al construir frames salientes en todo el proceso: las
+// cabeceras y el payload de cada forma (normal, comprimida, en ancho fijo)
+uint64_t frameBytesCopied();
+
+// Cola de frames salientes de una conexion. flush() agrupa varios frames en
+// una sola llamada sendmsg (writev con MSG_NOSIGNAL) y recuerda el punto
+// exacto donde quedo si el socket devuelve EAGAIN. Cada frame se codifica
+// en el formato vigente al hacer push().
+// Los frames esperan en un carril por SendPriority; el planificador va
+// pasando frames (o trozos de chunkSize) a la cola lista para el cable
+// solo hasta tener unos chunkSize bytes por delante, asi que un frame
+// urgente espera como mucho eso, no la transferencia entera.
+// Los streams se leen de su StreamSource al pasar cada trozo a la cola lista,
+// asi que ocupan como mucho un trozo en memoria; pendingBytes() no los cuenta.
+class FrameWriter {
+public:
+    FrameWriter();
+
+    void push(const Message& message);
+    // En el carril de frame->priority(); los de control siempre en High
+    void push(const FrameHandle& frame);
+    // false si el socket fallo; true si se envio todo o el resto espera EPOLLOUT
+    bool flush(int fd);
+    // Para destinos que no son sockets: iovecs de los bytes pendientes y
+    // avance tras escribir `bytes` de ellos
+    size_t gather(struct iovec* iov, size_t maxIovecs) const;
+    void advance(size_t bytes);
+    bool empty() const;
+    size_t pendingBytes() const;
+    // Llamadas a sendmsg hechas por flush() desde el ultimo clear()
+    uint64_t sendCalls() const;
+    void clear();
+
+    // Fija el orden en el cable de todo lo encolado hasta ahora
+    void commit();
+    // Hace commit(): lo encolado antes sale antes que lo del nuevo formato
+    void setFormat(WireFormat format);
+    WireFormat format() const;
+
+    void setScheduling(const LaneScheduling& scheduling);
+    // Solo si el otro extremo negocio WireFeatureFragments
+    void setFragmentation(bool enabled);
+    // Solo si negocio WireFeatureCompression: comprime los payloads de al
+    // menos threshold bytes que hagan push() desde ahora. 0 = no comprimir.
+    // pendingBytes() sigue contando el tamaño sin comprimir.
+    void setCompression(size_t threshold);
+    // Solo si el destino de flush() es un socket: los trozos de streams de
+    // fichero pasan con sendfile sin copiarse al proceso. Sin el, se leen a un
+    // buffer y salen tambien por gather().
+    void setSendfile(bool enabled);
+    // Bytes de trozos de stream escritos desde el ultimo clear()
+    uint64_t streamedBytes() const;
+
+private:
+    struct Entry {
+        FrameHandle frame;
+        WireFormat format;
+        bool compressed;
+        size_t payloadSent;   // Bytes del payload (en el cable) ya pasados a trozos
+        size_t logicalLeft;   // Parte de pendingBytes aun sin asignar a un segmento
+        bool stream;          // payloadSent es la posicion en frame->stream()
+    };
+
+    // Unidad en el cable: un frame entero o un trozo con su propia cabecera
+    struct Segment {
+        FrameHandle frame;
+        WireFormat format;
+        bool compressed;
+        bool whole;
+        size_t size;          // Bytes en el cable
+        size_t logical;       // Bytes que descuenta de pendingBytes al completarse
+        size_t payloadOffset;
+        size_t payloadSize;
+        size_t headerSize;
+        char header[OutboundFrame::maxFragmentHeaderSize];
+        // Trozo de stream: datos ya leidos, o con sendfile se leen de source
+        std::vector<char> data;
+        bool fromFile;
+        bool stream;
+    };
+
+    std::deque<Entry> lanes[sendPriorityCount];
+    std::deque<Segment> ready;
+    size_t readyBytes;
+    size_t frontOffset;
+    size_t queuedBytes;
+    WireFormat currentFormat;
+    uint64_t syscalls;
+    LaneScheduling scheduling;
+    bool fragmentation;
+    size_t compressionThreshold;
+    bool sendfileEnabled;
+    uint64_t streamed;
+    int credits[sendPriorityCount];
+
+    static const size_t defaultReadyTarget = 64 * 1024;
+
+    size_t readyTarget() const;
+    void refill(size_t targetBytes, bool streams = true);
+    size_t pickLane(bool streams);
+    void scheduleFrom(size_t lane);
+    void scheduleStream(size_t lane);
+};
+
+// Buffer de recepcion reutilizable: recv escribe directamente en el espacio
+// libre y next() construye Messages a partir de los frames completos sin
+// copias intermedias. Solo se compacta (memmove del frame parcial) cuando
+// se acaba el espacio al final, y crece si un frame no cabe.
+class FrameReader {
+public:
+    explicit FrameReader(size_t initialCapacity = 65536);
+
+    // Una llamada a recv; mismo valor de retorno que ::recv
+    ssize_t receive(int fd);
+    // Añade bytes que no vienen de un socket
+    void feed(const char* data, size_t size);
+    // Extrae el siguiente frame completo; flags recibe sus FrameFlag
+    bool next(Message& message, uint8_t& flags);
+    // Igual, y correlationId recibe el ID de los frames RPC (0 en los demas)
+    bool next(Message& message, uint8_t& flags, uint64_t& correlationId);
+    void clear();
+    // Bytes recibidos por receive() y feed() desde el ultimo clear()
+    uint64_t receivedBytes() const;
+
+    void setFormat(WireFormat format);
+    WireFormat format() const;
+
+    class FrameTooLargeException : public std::runtime_error {
+    public:
+        explicit FrameTooLargeException();
+    };
+
+private:
+    std::vector<char> buffer;
+    size_t readPos;
+    size_t writePos;
+    WireFormat currentFormat;
+    uint64_t totalReceived;
+
+    // Trozos recibidos de cada carril a la espera del ultimo
+    std::vector<char> fragments[sendPriorityCount];
+    std::vector<char> assembled;
+    std::vector<char> inflated;
+
+    void assignPayload(Message& message, Message::Type type, Message::Encoding encoding,
+                       uint8_t& flags, const char* payload, size_t size);
+
+    void makeRoom(size_t needed);
+    void consume(size_t size);
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef LIBFTPP_IO_RING_HPP
+# define LIBFTPP_IO_RING_HPP
+
+# include <linux/io_uring.h>
+# include <sys/socket.h>
+# include <cstddef>
+# include <cstdint>
+# include <stdexcept>
+# include <string>
+# include <vector>
+
+// io_uring con las llamadas al sistema directas (sin liburing): anillos SQ y
+// CQ mapeados, un grupo de buffers provistos para los recv multishot y
+// enter() con timeout. Las peticiones preparadas se envian todas juntas en el
+// siguiente enter(), que tambien espera las completions: una sola syscall por
+// vuelta del event loop para todas las conexiones.
+// No es thread-safe: lo usa un solo event loop.
+class IoRing {
+public:
+    IoRing(unsigned entries, unsigned bufferCount, size_t bufferSize);
+    ~IoRing();
+
+    // Kernel >= 6.0 (accept/recv multishot y buffers provistos) y io_uring permitido
+    static bool available();
+
+    // Multishot: una completion por conexion / evento / recv hasta cancelarlas
+    void accept(int fd, uint64_t userData);
+    void poll(int fd, uint32_t events, uint64_t userData);
+    void receive(int fd, uint64_t userData);
+    // msg (y sus iovec) deben seguir vivos hasta el siguiente enter(); los
+    // datos, hasta la completion
+    void sendMessage(int fd, const struct msghdr* msg, uint64_t userData);
+    // Cancela todas las peticiones con ese userData
+    void cancel(uint64_t userData);
+    // Cancela las peticiones del fd y lo cierra despues, enlazadas: el fd
+    // sigue abierto hasta que se procesa la cancelacion
+    void cancelAndClose(int fd);
+
+    // Envia lo preparado y espera al menos una completion, o timeoutMs (-1 = sin limite)
+    void enter(int timeoutMs);
+    // Solo envia lo preparado, sin esperar
+    void submit();
+    // Copia hasta max completions y las retira del anillo
+    size_t reap(struct io_uring_cqe* cqes, size_t max);
+
+    // Buffer de una completion con IORING_CQE_F_BUFFER; hay que devolverlo con recycle
+    const char* buffer(const struct io_uring_cqe& cqe) const;
+    void recycle(const struct io_uring_cqe& cqe);
+
+    // Llamadas a io_uring_enter hechas
+    uint64_t enters() const;
+
+    class IoRingFailedException : public std::runtime_error {
+    public:
+        explicit IoRingFailedException(const std::string& msg);
+    };
+
+private:
+    int ringFd;
+    void* ringMapping;
+    size_t ringSize;
+    struct io_uring_sqe* sqes;
+    size_t sqesSize;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned sqLocalTail;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+
+    struct io_uring_buf* bufferRing;
+    size_t bufferRingSize;
+    unsigned bufferMask;
+    unsigned short bufferTail;
+    size_t bufferSize;
+    std::vector<char> bufferStorage;
+    uint64_t enterCount;
+
+    struct io_uring_sqe* prepare(uint8_t opcode, int fd, uint64_t userData);
+    void provide(unsigned short id);
+    void release();
+
+    IoRing(const IoRing&);
+    IoRing& operator=(const IoRing&);
+};
+
+#endif
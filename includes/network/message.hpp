@@ -5,16 +5,31 @@
 # include <vector>
 # include <stdexcept>
 # include <cstring>
+# include <cstdint>
+# include <type_traits>
 
 class Message {
 public:
     using Type = int;
 
-    explicit Message(Type type = 0);
+    // Codificacion de los campos enteros: Fixed copia sizeof(T) bytes (formato
+    // original); Varint usa LEB128, con zigzag para los tipos con signo.
+    // Viaja en los flags del frame, asi que los handlers no cambian.
+    enum class Encoding { Fixed, Varint };
+
+    // Payloads de hasta inlineCapacity bytes viven dentro del propio Message;
+    // los mayores usan bloques reciclados de un pool (sin malloc en regimen estable)
+    static const size_t inlineCapacity = 64;
+
+    explicit Message(Type type = 0, Encoding encoding = Encoding::Fixed);
     Message(const Message& other);
+    Message(Message&& other) noexcept;
     Message& operator=(const Message& other);
+    Message& operator=(Message&& other) noexcept;
+    ~Message();
     
     Type type() const;
+    Encoding encoding() const;
 
     template <typename T>
     Message& operator<<(const T& data);
@@ -27,7 +42,19 @@ public:
 
     std::string serialize() const;
     void deserialize(const std::string& data);
+    void deserialize(const char* data, size_t size);
+    // Reconstruye el mensaje a partir de las partes de un frame
+    void assign(Type type, Encoding encoding, const char* payload, size_t size);
+    // Copia el mensaje en out con Encoding::Fixed (para pares que no
+    // negociaron WireFeatureCompact). false si es Varint y no se sabe donde
+    // estan sus enteros: solo se sabe en los construidos con operator<<
+    bool toFixed(Message& out) const;
 
+    // Acceso directo al payload (sin el tipo) para el envio sin copias
+    const char* data() const;
+    size_t size() const;
+
+    void reserve(size_t capacity);
     void resetRead() const;
 
     class DeserializationFailedException : public std::runtime_error {
@@ -37,8 +64,51 @@ public:
 
 private:
     Type msgType;
-    std::vector<char> buffer;
+    Encoding fieldEncoding;
+    char* storage;
+    size_t length;
+    size_t capacity;
     mutable size_t readPos;
+    char inlineBuffer[inlineCapacity];
+
+    // Enteros escritos en Varint: donde empiezan y su sizeof, para toFixed().
+    // Los primeros inlineFieldCapacity viven dentro del Message (copiar o
+    // mover no toca malloc); solo los mensajes con mas van a overflowFields
+    struct VarintField {
+        uint32_t offset;
+        uint8_t width;
+        bool isSigned;
+    };
+    static const size_t inlineFieldCapacity = 8;
+    VarintField inlineFields[inlineFieldCapacity];
+    size_t fieldCount;
+    std::vector<VarintField> overflowFields;
+    bool layoutKnown;
+
+    // Enteros de mas de un byte (sin bool): candidatos a varint
+    template <typename T>
+    struct IsVarintField : std::integral_constant<bool,
+        std::is_integral<T>::value && !std::is_same<T, bool>::value && (sizeof(T) > 1)> {};
+
+    template <typename T>
+    void writeField(const T& data, std::true_type);
+    template <typename T>
+    void writeField(const T& data, std::false_type);
+    template <typename T>
+    void readField(T& data, std::true_type) const;
+    template <typename T>
+    void readField(T& data, std::false_type) const;
+
+    void append(const void* bytes, size_t size);
+    void read(void* bytes, size_t size) const;
+    void appendVarint(uint64_t value);
+    void recordVarintField(size_t offset, uint8_t width, bool isSigned);
+    const VarintField& varintField(size_t index) const;
+    void copyLayout(const Message& other);
+    void clearLayout(bool known);
+    uint64_t readVarint() const;
+    void resize(size_t newLength);
+    void releaseStorage();
 };
 
 // Declaraciones externas para las especializaciones de std::string
@@ -53,4 +123,4 @@ const Message& Message::operator>>(std::string& data) const;
 
 # include "message.tpp"
 
-#endif
\ No newline at end of file
+#endif
@@ -1,33 +1,69 @@
 #ifndef LIBFTPP_MESSAGE_TPP
 # define LIBFTPP_MESSAGE_TPP
 # include "message.hpp"
+# include "network/varint.hpp"
 
 template <typename T>
 Message& Message::operator<<(const T& data) {
-    size_t oldSize = buffer.size();
-    buffer.resize(oldSize + sizeof(T));
-    std::memcpy(&buffer[oldSize], &data, sizeof(T));
+    writeField(data, IsVarintField<T>());
     return *this;
 }
 
 template <typename T>
 Message& Message::operator>>(T& data) {
-    if (readPos + sizeof(T) > buffer.size()) {
-        throw DeserializationFailedException("Not enough data to read");
-    }
-    std::memcpy(&data, &buffer[readPos], sizeof(T));
-    readPos += sizeof(T);
+    readField(data, IsVarintField<T>());
     return *this;
 }
 
 template <typename T>
 const Message& Message::operator>>(T& data) const {
-    if (readPos + sizeof(T) > buffer.size()) {
-        throw DeserializationFailedException("Not enough data to read");
-    }
-    std::memcpy(&data, &buffer[readPos], sizeof(T));
-    readPos += sizeof(T);
+    readField(data, IsVarintField<T>());
     return *this;
 }
 
-#endif
\ No newline at end of file
+template <typename T>
+void Message::writeField(const T& data, std::true_type) {
+    if (fieldEncoding == Encoding::Fixed) {
+        append(&data, sizeof(T));
+        return;
+    }
+    recordVarintField(length, static_cast<uint8_t>(sizeof(T)), std::is_signed<T>::value);
+    if (std::is_signed<T>::value) {
+        appendVarint(zigzagEncode(static_cast<int64_t>(data)));
+    } else {
+        appendVarint(static_cast<uint64_t>(data));
+    }
+}
+
+template <typename T>
+void Message::writeField(const T& data, std::false_type) {
+    append(&data, sizeof(T));
+}
+
+template <typename T>
+void Message::readField(T& data, std::true_type) const {
+    if (fieldEncoding == Encoding::Fixed) {
+        read(&data, sizeof(T));
+        return;
+    }
+    uint64_t raw = readVarint();
+    if (std::is_signed<T>::value) {
+        int64_t value = zigzagDecode(raw);
+        data = static_cast<T>(value);
+        if (static_cast<int64_t>(data) != value) {
+            throw DeserializationFailedException("Varint out of range");
+        }
+    } else {
+        data = static_cast<T>(raw);
+        if (static_cast<uint64_t>(data) != raw) {
+            throw DeserializationFailedException("Varint out of range");
+        }
+    }
+}
+
+template <typename T>
+void Message::readField(T& data, std::false_type) const {
+    read(&data, sizeof(T));
+}
+
+#endif
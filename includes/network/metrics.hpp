@@ -0,0 +1,103 @@
+#ifndef LIBFTPP_METRICS_HPP
+# define LIBFTPP_METRICS_HPP
+
+# include "network/message.hpp"
+# include <atomic>
+# include <chrono>
+# include <cstdint>
+# include <map>
+# include <vector>
+
+// Histograma de duraciones con cubos log2 en microsegundos: el cubo i cuenta
+// las muestras en [2^(i-1), 2^i) us y el 0 las de menos de 1 us.
+// record() solo hace sumas atomicas relajadas; snapshot() se puede llamar
+// desde cualquier hilo sin bloquear a quien registra.
+class LatencyHistogram {
+public:
+    static const size_t bucketCount = 32;
+
+    struct Snapshot {
+        uint64_t count;
+        uint64_t totalNanoseconds;
+        uint64_t buckets[bucketCount];
+
+        Snapshot();
+        double meanMicroseconds() const;
+        // Limite superior (us) del cubo que contiene el cuantil q (0..1)
+        uint64_t percentileMicroseconds(double q) const;
+    };
+
+    LatencyHistogram();
+
+    void record(std::chrono::nanoseconds duration);
+    Snapshot snapshot() const;
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalNanoseconds;
+    std::atomic<uint64_t> buckets[bucketCount];
+};
+
+// Contadores de trafico. Los escribe un solo event loop y se leen con
+// cargas relajadas: cada valor es exacto, pero no forman un corte atomico.
+struct TrafficCounters {
+    std::atomic<uint64_t> bytesIn;
+    std::atomic<uint64_t> bytesOut;
+    std::atomic<uint64_t> messagesIn;
+    std::atomic<uint64_t> messagesOut;
+    std::atomic<uint64_t> sendCalls;      // Llamadas a sendmsg
+    std::atomic<uint64_t> queuedMessages; // Frames en la cola de salida aun sin pasar al socket
+    std::atomic<uint64_t> queuedBytes;    // Bytes aun sin escribir, incluido el FrameWriter
+    std::atomic<uint64_t> messagesShed;   // Entrantes descartados por InboundLimits
+    std::atomic<uint64_t> readPauses;     // Veces que se dejo de leer por InboundLimits
+
+    TrafficCounters();
+};
+
+struct ConnectionMetrics {
+    long long clientID;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;
+    uint64_t messagesOut;
+    uint64_t sendCalls;
+    uint64_t queuedMessages;
+    uint64_t queuedBytes;
+    uint64_t messagesShed;
+    uint64_t readPauses;
+
+    ConnectionMetrics(long long clientID, const TrafficCounters& counters);
+};
+
+struct NetworkMetrics {
+    std::chrono::steady_clock::time_point takenAt;
+    uint64_t accepted;
+    uint64_t closed;
+    // accept fallidos por falta de descriptores o memoria: con EMFILE/ENFILE
+    // la conexion pendiente se acepta y se cierra, el resto se reintenta
+    uint64_t acceptFailures;
+    // Totales desde start(), incluidas las conexiones ya cerradas
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    uint64_t messagesIn;
+    uint64_t messagesOut;
+    uint64_t sendCalls;
+    uint64_t messagesShed;
+    uint64_t readPauses;
+    // epoll_wait/io_uring_enter, accept, recv, sendmsg y lecturas del eventfd
+    // de los event loops, mas los avisos de envio (eventfd, timerfd) de los
+    // hilos que llaman a sendTo (sin los de shm ni UDP)
+    uint64_t ioSyscalls;
+    // Mensajes recibidos a la espera de update() en este momento
+    uint64_t pendingMessages;
+    uint64_t pendingBytes;
+    std::vector<ConnectionMetrics> connections;
+    // Tiempo de cada handler (defineAction / defineRequestAction) por tipo
+    std::map<Message::Type, LatencyHistogram::Snapshot> handlers;
+
+    NetworkMetrics();
+    // Conexiones aceptadas por segundo entre previous y esta instantanea
+    double acceptRate(const NetworkMetrics& previous) const;
+};
+
+#endif
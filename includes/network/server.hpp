@@ -2,13 +2,30 @@
 # define LIBFTPP_SERVER_HPP
 
 # include "network/message.hpp"
+# include "network/frame.hpp"
+# include "network/flow_control.hpp"
+# include "network/shm_channel.hpp"
+# include "network/datagram_socket.hpp"
+# include "network/io_ring.hpp"
+# include "network/stream.hpp"
+# include "network/socket_options.hpp"
+# include "network/dispatch_table.hpp"
+# include "network/timing_wheel.hpp"
+# include "network/token_bucket.hpp"
+# include "network/metrics.hpp"
+# include "threading/worker_pool.hpp"
 # include <functional>
 # include <vector>
 # include <queue>
 # include <atomic>
 # include <thread>
 # include <mutex>
+# include <condition_variable>
 # include <map>
+# include <deque>
+# include <exception>
+# include <memory>
+# include <random>
 # include <unordered_map>
 # include <stdexcept>
 # include <string>
@@ -17,17 +34,150 @@ class Server {
 public:
     using ClientID = long long;
     using Action = std::function<void(ClientID& clientID, const Message& msg)>; // Mantener const Message&
+    using BackpressureCallback = std::function<void(ClientID clientID, SendQueueEvent event)>;
+    // Handler RPC: lo que devuelve viaja como respuesta a Client::call. Si lanza,
+    // el cliente recibe el what() como Client::RemoteErrorException.
+    using RequestAction = std::function<Message(ClientID& clientID, const Message& request)>;
+    using RequestID = uint64_t;
+    using ReapCallback = std::function<void(ClientID clientID)>;
+    using StreamID = uint64_t;
+    using StreamAction = std::function<void(ClientID& clientID, const StreamChunk& chunk)>;
 
-    Server();
+    // Deteccion de pares muertos (0 = desactivado). Una conexion sin recibir
+    // nada durante idleTimeout se cierra; si no se le ha enviado nada durante
+    // heartbeatInterval se le manda un Heartbeat, al que Client responde, asi
+    // que un cliente vivo pero callado no llega al idleTimeout. Los Heartbeat
+    // solo van a quien hizo el handshake (Client::setWireFeatures): a los
+    // clientes sin Hello solo se les aplica idleTimeout.
+    struct ConnectionTimeouts {
+        std::chrono::milliseconds idleTimeout = std::chrono::milliseconds(0);
+        std::chrono::milliseconds heartbeatInterval = std::chrono::milliseconds(0);
+    };
+
+    // Backend de E/S de los event loops. IoUring agrupa en un io_uring_enter
+    // por vuelta los accept, recv y sendmsg de todas las conexiones TCP y unix
+    // de un shard (accept y recv multishot con buffers provistos). Necesita
+    // Linux >= 6.0; si no esta disponible se usa epoll.
+    enum class IoBackend {
+        Epoll,
+        IoUring
+    };
+
+    explicit Server(size_t eventLoopCount = 1);
     ~Server();
 
     void start(const size_t& port);
+    // Solo en una direccion local, sin listener TCP: "unix:///ruta", "unix://@nombre"
+    // o "shm://nombre"
+    void start(const std::string& address);
+    // Punto de escucha adicional, antes de start(): "unix://..." para sockets
+    // AF_UNIX (ver unix_socket.hpp), "shm://nombre" para memoria compartida
+    // (ver ShmChannel). Mismo framing y mismas acciones que por TCP.
+    void addEndpoint(const std::string& address);
     void defineAction(const Message::Type& messageType, const Action& action);
-    void sendTo(const Message& message, ClientID clientID);
-    void sendToArray(const Message& message, std::vector<ClientID> clientIDs);
-    void sendToAll(const Message& message);
+    // Accion tipada: handler(ClientID&, const T&) para T::messageType; el
+    // payload se decodifica en T con MessageCodec<T> antes de llamarla
+    template <typename T, typename Handler>
+    void defineAction(const Handler& handler);
+    void defineRequestAction(const Message::Type& messageType, const RequestAction& action);
+    // priority elige el carril de salida (ver LaneScheduling); el orden
+    // entre mensajes solo se mantiene dentro del mismo carril.
+    // Un Message Varint va en ancho fijo a los clientes sin WireFeatureCompact;
+    // si es uno recibido (no se puede reescribir) lanza SendingFailedException
+    void sendTo(const Message& message, ClientID clientID, SendPriority priority = SendPriority::Normal);
+    void sendToArray(const Message& message, const std::vector<ClientID>& clientIDs,
+                     SendPriority priority = SendPriority::Normal);
+    void sendToAll(const Message& message, SendPriority priority = SendPriority::Normal);
+
+    // Transferencias grandes en memoria constante. El stream sale en trozos
+    // (FrameStream) de LaneScheduling::chunkSize leidos de source segun el
+    // socket admite mas, con sendfile si es un fichero y la conexion TCP o
+    // unix va por epoll. En el receptor cada trozo llega, en orden, a su
+    // accion de stream del tipo indicado. Solo con WireFeatureStreams
+    // negociado (StreamsUnavailableException si no). Cuenta para la cola
+    // de salida solo su cabecera: lo no leido espera en source.
+    StreamID sendStream(ClientID clientID, Message::Type type, const std::shared_ptr<StreamSource>& source,
+                        SendPriority priority = SendPriority::Bulk);
+    StreamID sendFile(ClientID clientID, Message::Type type, const std::string& path,
+                      SendPriority priority = SendPriority::Bulk);
+    // Trozos de los streams que envian los clientes, en update() como las acciones
+    void defineStreamAction(const Message::Type& messageType, const StreamAction& action);
+
+    // Canal UDP no fiable y sin orden para datos donde gana el valor mas
+    // reciente. Antes de start(port): abre un socket UDP en el mismo puerto y
+    // los clientes TCP que pidan WireFeatureDatagrams reciben un token. Los
+    // datagramas mas viejos que el ultimo recibido del mismo tipo se descartan
+    // y los que llegan pasan por las mismas acciones en update().
+    void enableDatagrams();
+    // Un Message por datagrama (DatagramTooLargeException si no cabe). Se
+    // descarta sin error si el cliente aun no envio ningun datagrama.
+    void sendDatagram(const Message& message, ClientID clientID);
+    void sendDatagramToAll(const Message& message);
     void update();
 
+    // Reparte los mensajes de update() en un WorkerPool: los de un mismo
+    // cliente se ejecutan en orden, clientes distintos en paralelo.
+    // Con waitForCompletion, update() no vuelve hasta terminar el lote.
+    // workerCount = 0 vuelve al modo secuencial.
+    void setParallelDispatch(size_t workerCount, bool waitForCompletion = true);
+    void waitForDispatch();
+
+    // WireFeature que se aceptan en el handshake de los clientes (por defecto todas)
+    void setSupportedWireFeatures(uint32_t features);
+
+    void setSendQueueLimits(const SendQueueLimits& limits);
+    void setBackpressureCallback(const BackpressureCallback& callback);
+    // Antes de start(). Acota lo que cada cliente puede meter en la cola de
+    // update() y el total pendiente (ver InboundLimits). Los datagramas solo
+    // cuentan para el total y se descartan al superarlo.
+    void setInboundLimits(const InboundLimits& limits);
+
+    // Antes de start(). Se aplica a cada conexion aceptada.
+    void setLaneScheduling(const LaneScheduling& scheduling);
+    // Antes de start(). Ver SendCoalescing y SendBatch
+    void setSendCoalescing(const SendCoalescing& coalescing);
+    // Antes de start(). Las opciones TCP se ponen en los listeners y las
+    // heredan las conexiones aceptadas; en los endpoints unix solo cuentan
+    // backlog y los buffers. StartFailedException si el kernel rechaza alguna.
+    void setSocketOptions(const SocketOptions& options);
+    // Antes de start(). Con WireFeatureCompression negociado se comprimen los
+    // payloads de al menos threshold bytes (0 = nunca)
+    void setCompressionThreshold(size_t threshold);
+
+    // Antes de start(). El callback se llama desde el event loop tras cerrar
+    // una conexion por idleTimeout.
+    void setConnectionTimeouts(const ConnectionTimeouts& timeouts);
+    void setReapCallback(const ReapCallback& callback);
+
+    // Antes de start(). ioBackend() devuelve el que se usa de verdad
+    void setIoBackend(IoBackend backend);
+    IoBackend ioBackend() const;
+
+    // Instantanea de contadores e histogramas. No toma ningun lock de los
+    // event loops: lee contadores atomicos y la lista de conexiones que cada
+    // shard publica al aceptar o cerrar (puede ir una vuelta de epoll atrasada).
+    NetworkMetrics metrics();
+
+    // Mientras vive, los envios de este hilo a este Server no despiertan a los
+    // event loops (salvo al llegar a SendCoalescing::maxBytes): al destruirse
+    // se despierta una vez a cada uno con envios, y los mensajes de una misma
+    // conexion salen en un solo sendmsg. Se pueden anidar. update() abre uno
+    // mientras ejecuta las acciones (no en el despacho paralelo).
+    class SendBatch {
+    public:
+        explicit SendBatch(Server& server);
+        ~SendBatch();
+
+    private:
+        friend class Server;
+        Server& server;
+        SendBatch* previous;
+        std::vector<bool> deferred;   // Por shard
+
+        SendBatch(const SendBatch&);
+        SendBatch& operator=(const SendBatch&);
+    };
+
     class AlreadyStartedException : public std::exception {
         const char* what() const noexcept;
     };
@@ -56,23 +206,299 @@ public:
         explicit BatchSendingFailedException();
     };
 
+    class DatagramTooLargeException : public std::runtime_error {
+    public:
+        explicit DatagramTooLargeException();
+    };
+
+    class StreamsUnavailableException : public std::runtime_error {
+    public:
+        explicit StreamsUnavailableException();
+    };
+
 private:
-    int serverSocket;
+    // Cabecera del sendmsg en vuelo por io_uring (el kernel la copia al enviarla)
+    struct RingSend {
+        struct msghdr header;
+        std::vector<struct iovec> iov;
+    };
+
+    // Estado de cada socket aceptado, solo lo toca el hilo del event loop.
+    // En conexiones shm, fd es el socket de encuentro y shm queda a null
+    // hasta recibir los descriptores del cliente.
+    struct Connection {
+        int fd;
+        bool isShm;
+        bool isLocal;   // Aceptada por un endpoint unix:// o shm://
+        // Se respondio a su Hello (acknowledgeHello): entiende frames de
+        // control (Heartbeat).
+        // En el formato original FrameControl caeria en la longitud
+        bool helloAcknowledged;
+        std::unique_ptr<ShmChannel> shm;
+        FrameReader reader;
+        FrameWriter writer;
+        // Para los timeouts: ultima vez que se recibio / envio algo
+        std::chrono::steady_clock::time_point lastReceived;
+        std::chrono::steady_clock::time_point lastSent;
+        std::shared_ptr<TrafficCounters> counters;
+        // Admision (InboundLimits). Con lectura pausada el socket no se lee
+        // hasta resumeAt, o hasta que update() vacie la cola si es max()
+        TokenBucket messageBucket;
+        TokenBucket byteBucket;
+        bool readPaused;
+        std::chrono::steady_clock::time_point resumeAt;
+        // io_uring: recv multishot armado (o cancelandose) y sendmsg en vuelo.
+        // Con un envio en vuelo el writer no avanza hasta su completion.
+        bool recvArmed;
+        bool recvCancelled;
+        bool sendInFlight;
+        std::unique_ptr<RingSend> ringSend;
+
+        Connection();
+    };
+
+    // Cola de salida de un cliente, protegida por el mutex del shard.
+    // queuedBytes cuenta tambien lo que ya esta en el FrameWriter sin escribir.
+    struct Outbox {
+        std::deque<FrameHandle> frames;
+        size_t queuedBytes;
+        WireFormat format;
+        bool streams;   // El cliente negocio WireFeatureStreams
+        bool congested;
+        bool overflowed;
+        // El mismo objeto que Connection::counters
+        std::shared_ptr<TrafficCounters> counters;
+
+        Outbox();
+    };
+
+    // Mensaje recibido a la espera de update(); requestID != 0 si es una
+    // peticion RPC, streamID != 0 si es un trozo de stream
+    struct Inbound {
+        ClientID clientID;
+        Message message;
+        RequestID requestID;
+        StreamID streamID;
+
+        Inbound(ClientID clientID, Message&& message, RequestID requestID, StreamID streamID = 0);
+    };
+
+    typedef std::vector<std::pair<ClientID, std::shared_ptr<const TrafficCounters>>> CounterList;
+
+    // Un event loop con su propio listener (SO_REUSEPORT), epoll y tabla de clientes.
+    // El ClientID codifica el shard propietario: clientID % shards.size()
+    struct Shard {
+        size_t index;
+        int listenFd;
+        int epollFd;
+        int wakeFd;
+        std::thread thread;
+
+        std::mutex mutex;
+        std::condition_variable drained;
+        std::vector<Inbound> receivedMessages;
+        std::map<ClientID, Outbox> messagesToSend;
+        SendQueueLimits limits;
+        BackpressureCallback backpressureCallback;
+
+        std::unordered_map<ClientID, Connection> connections;
+        ClientID nextSequence;
+        // Un timer por conexion con timeouts: vence en el proximo plazo a revisar
+        TimingWheel timers;
+        // Conexiones con la lectura pausada (puede haber ids ya cerrados)
+        std::vector<ClientID> pausedReads;
+
+        // Con IoBackend::IoUring (null con epoll). Los frames de un envio en
+        // vuelo de una conexion ya cerrada se guardan hasta su completion.
+        std::unique_ptr<IoRing> ring;
+        std::unordered_map<ClientID, FrameWriter> retiredWriters;
+        std::unordered_map<ClientID, std::unique_ptr<RingSend>> retiredSends;
+        // Llamadas al sistema de E/S del event loop, para las metricas
+        std::atomic<uint64_t> syscalls;
+
+        // Coalescencia de envios (SendCoalescing). heldBytes: encolado desde
+        // el ultimo flushPendingMessages (se modifica con mutex). wakePending
+        // evita escribir en el eventfd si ya hay un aviso sin atender.
+        // flushTimerFd (timerfd, solo con maxDelay) vence al acabar la espera.
+        // flushUrgent: alguna cola supero highWatermark, no se retiene nada.
+        // flushSignals: syscalls de aviso hechas desde los hilos que envian
+        std::atomic<size_t> heldBytes;
+        std::atomic<bool> wakePending;
+        std::atomic<bool> flushArmed;
+        std::atomic<bool> flushUrgent;
+        int flushTimerFd;
+        std::atomic<uint64_t> flushSignals;
+
+        // Metricas: totales del shard y lista de contadores por conexion,
+        // republicada (copy-on-write) al final de la vuelta si cambio
+        TrafficCounters totals;
+        std::atomic<uint64_t> accepted;
+        std::atomic<uint64_t> closed;
+        std::atomic<uint64_t> acceptFailures;
+
+        // Sin descriptores (EMFILE/ENFILE) accept no saca la conexion de la
+        // cola y el listener edge-triggered no vuelve a avisar: spareFd es un
+        // descriptor de reserva que se libera para aceptar y cerrar. Los
+        // listeners que no se pudieron vaciar (tokens) se reintentan desde
+        // el loop en acceptRetryAt
+        int spareFd;
+        std::vector<ClientID> acceptRetries;
+        std::chrono::steady_clock::time_point acceptRetryAt;
+        std::shared_ptr<const CounterList> publishedCounters;
+        bool countersChanged;
+
+        Shard(size_t index);
+    };
+
     std::atomic<bool> isRunning;
     std::atomic<bool> shouldStop;
 
-    std::thread acceptorThread;
+    struct ActionTable {
+        DispatchTable<ClientID&> actions;
+        std::unordered_map<Message::Type, RequestAction> requestActions;
+        std::unordered_map<Message::Type, StreamAction> streamActions;
+        // Tiempo de los handlers; se conserva al redefinir la accion
+        std::unordered_map<Message::Type, std::shared_ptr<LatencyHistogram>> handlerTimes;
+
+        void track(Message::Type type);
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards;
+    // Listeners extra compartidos por todos los shards (EPOLLEXCLUSIVE)
+    struct Endpoint {
+        std::string address;
+        std::string path;   // Ruta unix:// o nombre shm://
+        bool isShm;
+        int fd;
+    };
+    std::vector<Endpoint> endpoints;
     std::mutex mutex;
-    std::map<ClientID, int> clients;
-    std::vector<std::pair<ClientID, Message>> receivedMessages;
-    std::map<ClientID, std::queue<Message>> messagesToSend;
-    std::unordered_map<Message::Type, Action> actions;
+    // Copy-on-write: update() solo copia el puntero, no la tabla
+    std::shared_ptr<const ActionTable> actions;
+
+    // Despacho paralelo: una cola (strand) por cliente con mensajes pendientes
+    std::unique_ptr<WorkerPool> dispatchPool;
+    bool waitForDispatchCompletion;
+    std::mutex dispatchMutex;
+    std::condition_variable dispatchDone;
+    std::unordered_map<ClientID, std::deque<Inbound>> strands;
+    size_t messagesInFlight;
+    std::exception_ptr dispatchError;
+
+    std::atomic<uint32_t> supportedWireFeatures;
+
+    // Canal UDP: lo atiende el event loop del shard 0. Los pares se buscan
+    // por el token que el cliente recibio en el HelloAck.
+    struct DatagramPeer {
+        ClientID clientID;
+        uint64_t token;
+        sockaddr_storage address;
+        socklen_t addressLength;   // 0 hasta recibir su primer datagrama
+        DatagramSequences sequences;
+    };
+    bool datagramsEnabled;
+    DatagramSocket datagrams;
+    std::mutex datagramMutex;
+    std::unordered_map<uint64_t, DatagramPeer> datagramPeers;
+    std::unordered_map<ClientID, uint64_t> datagramTokens;
+    std::vector<DatagramSocket::Outgoing> datagramQueue;
+    std::mt19937_64 tokenGenerator;
 
-    ClientID nextClientID;
+    // Lo que espera a update() en todos los shards. inboundSaturated pide a
+    // update() despertar a los shards con lecturas pausadas por el tope global
+    InboundLimits inboundLimits;
+    bool inboundLimited;   // Algun limite distinto de 0
+    std::atomic<size_t> pendingInboundMessages;
+    std::atomic<size_t> pendingInboundBytes;
+    std::atomic<size_t> pendingStreamBytes;
+    std::atomic<bool> inboundSaturated;
 
-    void acceptorLoop();
-    void handleClient(ClientID clientID, int clientSocket);
-    void sendToClient(const Message& message, ClientID clientID);
+    IoBackend requestedBackend;
+    IoBackend activeBackend;
+
+    std::atomic<StreamID> nextStreamID;
+
+    ConnectionTimeouts timeouts;
+    LaneScheduling laneScheduling;
+    SocketOptions socketOptions;
+    SendCoalescing coalescing;
+    size_t compressionThreshold;
+    ReapCallback reapCallback;
+
+    std::shared_ptr<const ActionTable> currentActions();
+    void editActions(const std::function<void(ActionTable&)>& edit);
+    void dispatch(const ActionTable& table, Inbound& inbound);
+    void sendFrame(const FrameHandle& frame, ClientID clientID);
+    void dispatchParallel(std::vector<Inbound>& messages);
+    // Espera a los mensajes en vuelo y devuelve (y borra) la primera
+    // excepcion de un handler, sin relanzarla
+    std::exception_ptr finishDispatch();
+    void runStrand(ClientID clientID);
+
+    Shard& shardOf(ClientID clientID);
+    size_t shardIndexOf(ClientID clientID) const;
+    void stopShards();
+    void startListeners(bool listenTcp, size_t port);
+
+    void eventLoop(Shard& shard);
+    void eventLoopRing(Shard& shard);
+    int loopTimeoutMs(Shard& shard);
+    void handleEvent(Shard& shard, ClientID token, uint32_t events);
+    void handleCompletion(Shard& shard, const struct io_uring_cqe& cqe);
+    bool watch(Shard& shard, int fd, uint32_t events, ClientID token);
+    void wakeUp(Shard& shard);
+    // Tras encolar frames: despertar, retener (SendBatch) o armar el timer
+    void requestFlush(Shard& shard);
+    void signalFlush(Shard& shard);
+    void acceptClients(Shard& shard, ClientID token);
+    bool shedPendingAccept(Shard& shard, int listenFd);
+    void deferAccept(Shard& shard, ClientID token);
+    void retryAccepts(Shard& shard);
+    void addConnection(Shard& shard, int fd, bool isShm, bool isLocal);
+    void readFromClient(Shard& shard, ClientID clientID, Connection& connection, uint32_t events);
+    bool receiveFromShm(Shard& shard, ClientID clientID, Connection& connection, uint32_t events,
+                        std::vector<Inbound>& parsed);
+    bool receiveFromRing(Shard& shard, ClientID clientID, Connection& connection,
+                         std::vector<Inbound>& parsed);
+    void completeReceive(Shard& shard, ClientID clientID, const struct io_uring_cqe& cqe);
+    bool drainFrames(Shard& shard, ClientID clientID, Connection& connection,
+                     std::vector<Inbound>& parsed);
+    bool admitMessage(Shard& shard, Connection& connection, const Message& msg, bool& disconnect);
+    bool readsBlocked(Connection& connection);
+    bool inboundFull(size_t extraMessages = 0, size_t extraBytes = 0) const;
+    bool streamsFull() const;
+    bool pauseReads(Shard& shard, ClientID clientID, Connection& connection);
+    void resumeReads(Shard& shard, bool woken);
+    int pausedTimeoutMs(const Shard& shard, std::chrono::steady_clock::time_point now) const;
+    void acknowledgeHello(Shard& shard, ClientID clientID, Connection& connection, uint32_t requested);
+    void pushControlFrame(Shard& shard, ClientID clientID, Connection& connection, const FrameHandle& frame);
+    void flushPendingMessages(Shard& shard);
+    bool flushConnection(Shard& shard, ClientID clientID, Connection& connection);
+    void releaseSent(Shard& shard, ClientID clientID, Connection& connection, size_t released, uint64_t streamed);
+    void submitSend(Shard& shard, ClientID clientID, Connection& connection);
+    void completeSend(Shard& shard, ClientID clientID, int result);
+    void publishCounters(Shard& shard);
+    uint64_t openDatagramSession(ClientID clientID);
+    void closeDatagramSession(ClientID clientID);
+    void queueDatagram(const FrameHandle& frame, DatagramPeer& peer);
+    void flushDatagrams();
+    void receiveDatagrams();
+    void closeConnection(Shard& shard, ClientID clientID);
+    void scheduleTimeout(Shard& shard, ClientID clientID, const Connection& connection);
+    void checkTimeouts(Shard& shard);
+
+    typedef std::vector<std::pair<ClientID, SendQueueEvent>> EventList;
+    bool enqueueFrame(Shard& shard, std::unique_lock<std::mutex>& lock, ClientID clientID,
+                      const FrameHandle& frame, EventList& events);
+    void notifyBackpressure(Shard& shard, const EventList& events);
 };
 
+template <typename T, typename Handler>
+void Server::defineAction(const Handler& handler) {
+    editActions([&handler](ActionTable& table) {
+        table.actions.template define<T>(handler);
+        table.track(T::messageType);
+    });
+}
+
 #endif
\ No newline at end of file
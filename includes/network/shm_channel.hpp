@@ -0,0 +1,77 @@
+#ifndef LIBFTPP_SHM_CHANNEL_HPP
+# define LIBFTPP_SHM_CHANNEL_HPP
+
+# include "network/frame.hpp"
+# include <atomic>
+# include <memory>
+# include <string>
+# include <stdexcept>
+
+// Transporte en memoria compartida para Client/Server en la misma maquina
+// (direcciones "shm://nombre"). Un memfd contiene dos anillos SPSC de bytes,
+// uno por sentido, con el mismo formato de frames que un socket. Cada lado
+// espera en su propio eventfd (integrable en epoll); el otro lado solo lo
+// señala si el lector o escritor avisaron de que iban a dormir, asi que en
+// regimen de trafico continuo no hay syscalls por mensaje.
+//
+// El encuentro se hace por un socket AF_UNIX abstracto "libftpp/shm/nombre":
+// el cliente envia el memfd y los dos eventfds con SCM_RIGHTS y mantiene el
+// socket abierto; su cierre indica la desconexion.
+class ShmChannel {
+public:
+    static const size_t defaultRingCapacity = 1 << 20;
+    static const size_t descriptorCount = 3;
+
+    // Lado cliente: crea el memfd, los anillos y los eventfds
+    static std::unique_ptr<ShmChannel> create(size_t ringCapacity = defaultRingCapacity);
+    // Lado servidor: adopta los descriptores recibidos con receiveDescriptors
+    static std::unique_ptr<ShmChannel> attach(const int descriptors[descriptorCount]);
+
+    ~ShmChannel();
+
+    // fd a vigilar con epoll: datos nuevos o espacio libre en el anillo de salida
+    int eventFd() const;
+    void clearEvent();
+
+    // Escribe los frames pendientes del writer; false si el anillo se lleno
+    // (se reintentara cuando el otro lado avise en eventFd)
+    bool flush(FrameWriter& writer);
+    // Pasa al reader lo disponible en el anillo de entrada (como un recv).
+    // Devuelve false si estaba vacio, y deja armado el aviso de datos nuevos.
+    bool drain(FrameReader& reader);
+
+    // "shm://nombre" -> nombre; false si la direccion no es de memoria compartida
+    static bool parseAddress(const std::string& address, std::string& name);
+    // Socket de encuentro (listener no bloqueante / conexion bloqueante); -1 si falla
+    static int listenSocket(const std::string& name, int backlog);
+    static int connectSocket(const std::string& name);
+    bool sendDescriptors(int socketFd) const;
+    // false con errno == EAGAIN si aun no han llegado
+    static bool receiveDescriptors(int socketFd, int descriptors[descriptorCount]);
+
+    class ShmFailedException : public std::runtime_error {
+    public:
+        explicit ShmFailedException(const std::string& msg);
+    };
+
+private:
+    struct Ring;
+
+    int memFd;
+    int localEvent;
+    int remoteEvent;
+    bool isServerSide;
+    size_t mappedSize;
+    char* mapping;
+    Ring* inbound;
+    Ring* outbound;
+
+    ShmChannel(int memFd, int localEvent, int remoteEvent, bool isServerSide);
+    void map(size_t ringCapacity);
+    void signalRemote();
+
+    ShmChannel(const ShmChannel&);
+    ShmChannel& operator=(const ShmChannel&);
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef LIBFTPP_SOCKET_OPTIONS_HPP
+# define LIBFTPP_SOCKET_OPTIONS_HPP
+
+# include <sys/socket.h>
+
+// Opciones de los sockets de datos (Server::setSocketOptions,
+// Client::setSocketOptions). Las TCP_* solo se aplican a TCP; los sockets
+// unix usan los tamaños de buffer y el resto se ignora. 0 = valor del kernel.
+struct SocketOptions {
+    bool noDelay = true;       // TCP_NODELAY: sin Nagle (el FrameWriter ya agrupa)
+    // TCP_QUICKACK: ACK inmediato en vez de retrasarlo. El kernel lo desactiva
+    // solo, asi que se vuelve a poner tras cada recv (una syscall mas)
+    bool quickAck = false;
+    int sendBuffer = 0;        // SO_SNDBUF, bytes
+    int receiveBuffer = 0;     // SO_RCVBUF, bytes
+    // SO_BUSY_POLL: microsegundos de espera activa en la NIC al leer. Por
+    // encima de net.core.busy_read necesita CAP_NET_ADMIN
+    int busyPollMicros = 0;
+    int backlog = SOMAXCONN;   // Solo Server: cola de conexiones de cada listener
+
+    // SO_KEEPALIVE con TCP_KEEPIDLE / TCP_KEEPINTVL (segundos) y TCP_KEEPCNT
+    bool keepAlive = false;
+    int keepAliveIdle = 0;
+    int keepAliveInterval = 0;
+    int keepAliveCount = 0;
+};
+
+// Aplica options a un socket (tcp = false para AF_UNIX). En un listener,
+// antes de listen(), los sockets aceptados las heredan y la ventana TCP se
+// anuncia ya con el tamaño de buffer pedido en el handshake.
+// false si el kernel rechaza alguna opcion; las anteriores quedan aplicadas
+bool applySocketOptions(int fd, const SocketOptions& options, bool tcp);
+// Vuelve a activar TCP_QUICKACK tras un recv si options lo pide
+void rearmQuickAck(int fd, const SocketOptions& options);
+
+#endif
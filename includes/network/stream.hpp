@@ -0,0 +1,81 @@
+#ifndef LIBFTPP_STREAM_HPP
+# define LIBFTPP_STREAM_HPP
+
+# include "network/message.hpp"
+# include <cstddef>
+# include <cstdint>
+# include <functional>
+# include <memory>
+# include <stdexcept>
+# include <string>
+
+// Origen de un stream saliente (Server::sendStream, Client::sendStream).
+// El FrameWriter lo lee por trozos solo cuando la conexion puede enviar,
+// asi que el contenido nunca esta entero en memoria. Los de fichero salen
+// con sendfile cuando el destino es un socket, sin copiarse al proceso.
+// Un stream va a una sola conexion y lo lee el hilo de su event loop.
+class StreamSource {
+public:
+    // Rellena hasta capacity bytes y devuelve cuantos; 0 = fin del stream
+    using Reader = std::function<size_t(char* buffer, size_t capacity)>;
+
+    // size bytes de fd desde offset, con pread (no mueve la posicion del fd).
+    // Con ownsFd se cierra al destruir el StreamSource.
+    StreamSource(int fd, uint64_t offset, uint64_t size, bool ownsFd = false);
+    // Datos generados sobre la marcha, de tamaño no conocido de antemano
+    explicit StreamSource(const Reader& reader);
+    ~StreamSource();
+
+    // El fichero entero (OpenFailedException si no se puede abrir)
+    static std::shared_ptr<StreamSource> open(const std::string& path);
+
+    bool isFile() const;
+    int fd() const;
+    uint64_t offset() const;
+    uint64_t size() const;
+
+    // Hasta capacity bytes a partir de position (relativa a offset en los de
+    // fichero; los Reader la ignoran y leen en orden). 0 = fin.
+    // Lanza ReadFailedException si pread falla o el Reader lanza.
+    size_t read(uint64_t position, char* buffer, size_t capacity);
+
+    class OpenFailedException : public std::runtime_error {
+    public:
+        explicit OpenFailedException(const std::string& path);
+    };
+
+    class ReadFailedException : public std::runtime_error {
+    public:
+        explicit ReadFailedException(const std::string& msg);
+    };
+
+private:
+    int file;
+    bool ownsFile;
+    uint64_t start;
+    uint64_t length;
+    Reader reader;
+
+    StreamSource(const StreamSource&);
+    StreamSource& operator=(const StreamSource&);
+};
+
+// Trozo recibido de un stream, en orden. data solo es valido durante la
+// llamada a la accion. Cada emisor numera sus streams desde 1.
+struct StreamChunk {
+    static const uint8_t infoLast = 0x01;     // Ultimo trozo: el stream termino
+    static const uint8_t infoAborted = 0x02;  // El emisor no pudo leer el origen
+
+    uint64_t streamID;
+    Message::Type type;
+    const char* data;
+    size_t size;
+    bool last;
+    bool aborted;   // Con last: el stream quedo incompleto
+
+    // frame es lo que entrega FrameReader con FrameStream: [info][datos]
+    // (DeserializationFailedException si falta el byte de info)
+    StreamChunk(uint64_t streamID, const Message& frame);
+};
+
+#endif
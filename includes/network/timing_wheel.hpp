@@ -0,0 +1,46 @@
+#ifndef LIBFTPP_TIMING_WHEEL_HPP
+# define LIBFTPP_TIMING_WHEEL_HPP
+
+# include <chrono>
+# include <cstdint>
+# include <list>
+# include <unordered_map>
+# include <vector>
+
+// Rueda de temporizadores con hash: slotCount ranuras de `tick` cada una; un
+// timer mas largo que una vuelta guarda cuantas vueltas le faltan.
+// Programar, cancelar y cada tick cuestan O(1) por timer, sin recorrer todas
+// las claves. No es thread-safe: la usa un solo event loop.
+class TimingWheel {
+public:
+    typedef int64_t Key;
+    typedef std::chrono::steady_clock Clock;
+
+    TimingWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100), size_t slotCount = 512);
+
+    // Reemplaza el timer anterior de la clave, si lo habia
+    void schedule(Key key, std::chrono::milliseconds delay);
+    void cancel(Key key);
+    // Avanza los ticks transcurridos hasta now y añade las claves vencidas
+    void advance(Clock::time_point now, std::vector<Key>& expired);
+    // Milisegundos hasta el siguiente tick, o -1 sin timers (para epoll_wait)
+    int timeoutMs(Clock::time_point now) const;
+
+    bool empty() const;
+    size_t size() const;
+
+private:
+    struct Timer {
+        size_t slot;
+        size_t rounds;
+        std::list<Key>::iterator position;
+    };
+
+    Clock::duration tick;
+    std::vector<std::list<Key>> slots;
+    std::unordered_map<Key, Timer> timers;
+    size_t current;
+    Clock::time_point nextTick;
+};
+
+#endif
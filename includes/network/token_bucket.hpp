@@ -0,0 +1,34 @@
+#ifndef LIBFTPP_TOKEN_BUCKET_HPP
+# define LIBFTPP_TOKEN_BUCKET_HPP
+
+# include <chrono>
+
+// Cubo de tokens: se rellena a rate tokens por segundo hasta burst. Con
+// rate 0 no limita nada. consume() puede dejar el cubo en deuda, que se
+// paga antes de volver a tener tokens; tryConsume() nunca la deja.
+// No es thread-safe: lo usa un solo event loop.
+class TokenBucket {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TokenBucket();
+    // burst 0 = un segundo de rate
+    TokenBucket(double rate, double burst);
+
+    bool limited() const;
+    bool available(Clock::time_point now);
+    bool tryConsume(double amount, Clock::time_point now);
+    void consume(double amount, Clock::time_point now);
+    // Tiempo hasta que available() vuelva a ser true
+    Clock::duration waitTime(Clock::time_point now);
+
+private:
+    double rate;
+    double burst;
+    double tokens;
+    Clock::time_point lastRefill;
+
+    void refill(Clock::time_point now);
+};
+
+#endif
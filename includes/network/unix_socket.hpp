@@ -0,0 +1,18 @@
+#ifndef LIBFTPP_UNIX_SOCKET_HPP
+# define LIBFTPP_UNIX_SOCKET_HPP
+
+# include <string>
+
+// Sockets AF_UNIX para procesos de la misma maquina: mismo framing que TCP
+// pero sin pasar por la pila TCP/IP.
+// Direcciones: "unix:///ruta/al/socket", o "unix://@nombre" para el espacio
+// de nombres abstracto de Linux (sin fichero en disco).
+
+// false si la direccion no es unix://; path empieza por '@' si es abstracta
+bool parseUnixAddress(const std::string& address, std::string& path);
+// Listener no bloqueante; en rutas de fichero reemplaza un socket anterior. -1 si falla
+int listenUnixSocket(const std::string& path, int type, int backlog);
+// Conexion bloqueante; -1 si falla
+int connectUnixSocket(const std::string& path, int type);
+
+#endif
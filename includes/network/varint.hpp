@@ -0,0 +1,20 @@
+#ifndef LIBFTPP_VARINT_HPP
+# define LIBFTPP_VARINT_HPP
+
+# include <cstddef>
+# include <cstdint>
+
+// LEB128: 7 bits por byte, el bit alto indica que sigue otro byte.
+// Un uint64_t ocupa como maximo maxVarintSize bytes.
+const size_t maxVarintSize = 10;
+
+size_t encodeVarint(uint64_t value, char* out);
+// Devuelve los bytes consumidos, 0 si faltan datos. Lanza si el varint es invalido.
+size_t decodeVarint(const char* data, size_t size, uint64_t& value);
+size_t varintSize(uint64_t value);
+
+// Zigzag: los enteros con signo pequeños (positivos o negativos) quedan pequeños
+uint64_t zigzagEncode(int64_t value);
+int64_t zigzagDecode(uint64_t value);
+
+#endif
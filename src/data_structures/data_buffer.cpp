@@ -1,15 +1,20 @@
 #include "data_structures/data_buffer.hpp"
 #include <cstring>  // Para std::memcpy
 
+namespace {
+    // Primera reserva: evita varias reservas diminutas al escribir los primeros campos
+    const size_t minimum_capacity = 64;
+}
+
 // ============ IMPLEMENTACIONES DE MÉTODOS ============
 
 /**
  * @brief Constructor por defecto.
  * 
  * Inicializa un buffer vacío con las posiciones de lectura y escritura en 0.
- * El vector interno se crea vacío y se redimensionará según sea necesario.
+ * No reserva memoria hasta la primera escritura.
  */
-DataBuffer::DataBuffer() : read_pos(0), write_pos(0) {}
+DataBuffer::DataBuffer() : buffer_capacity(0), read_pos(0), write_pos(0) {}
 
 /**
  * @brief Constructor de copia.
@@ -17,11 +22,13 @@ DataBuffer::DataBuffer() : read_pos(0), write_pos(0) {}
  * @param other Buffer del cual copiar todo el contenido y estado actual.
  * 
  * Crea una copia independiente del buffer original, incluyendo:
- * - Todos los datos almacenados
+ * - Todos los datos almacenados (solo se reservan los bytes escritos)
  * - Las posiciones actuales de lectura y escritura
  */
 DataBuffer::DataBuffer(const DataBuffer& other) 
-    : buffer(other.buffer), read_pos(other.read_pos), write_pos(other.write_pos) {}
+    : buffer_capacity(0), read_pos(other.read_pos), write_pos(0) {
+    write_bytes(other.buffer.get(), other.write_pos);
+}
 
 /**
  * @brief Operador de asignación.
@@ -29,15 +36,16 @@ DataBuffer::DataBuffer(const DataBuffer& other)
  * @param other Buffer del cual copiar el contenido.
  * @return DataBuffer& Referencia a este objeto para encadenamiento.
  * 
- * Realiza una copia profunda de todos los datos y estado del buffer original.
+ * Realiza una copia profunda de todos los datos y estado del buffer original,
+ * reutilizando la memoria propia si ya es suficiente.
  * Si other es el mismo objeto (auto-asignación), no realiza ninguna operación.
  */
 DataBuffer& DataBuffer::operator=(const DataBuffer& other) {
     // Verificar auto-asignación
     if (this != &other) {
-        buffer = other.buffer;
+        write_pos = 0;
+        write_bytes(other.buffer.get(), other.write_pos);
         read_pos = other.read_pos;
-        write_pos = other.write_pos;
     }
     return *this;
 }
@@ -45,7 +53,7 @@ DataBuffer& DataBuffer::operator=(const DataBuffer& other) {
 /**
  * @brief Destructor.
  * 
- * Libera automáticamente todos los recursos gracias al uso de std::vector.
+ * Libera automáticamente todos los recursos gracias al uso de std::unique_ptr.
  * No se requiere limpieza manual de memoria.
  */
 DataBuffer::~DataBuffer() {}
@@ -73,25 +81,63 @@ void DataBuffer::append(const std::string& str) {
  * Los datos más allá de write_pos (si los hay) no se incluyen.
  */
 std::string DataBuffer::str() const {
-    return std::string(buffer.begin(), buffer.begin() + write_pos);
+    if (write_pos == 0) {
+        return std::string();
+    }
+    return std::string(buffer.get(), write_pos);
 }
 
 /**
  * @brief Limpia completamente el buffer.
  * 
  * Reinicia el buffer a su estado inicial:
- * - Vacía el vector interno
+ * - Descarta los datos escritos
  * - Establece read_pos y write_pos a 0
- * - Libera cualquier memoria reservada
+ * - Conserva la memoria reservada para las siguientes escrituras
  * 
- * El buffer queda listo para ser reutilizado desde cero.
+ * El buffer queda listo para ser reutilizado desde cero. Para liberar la
+ * memoria, llamar después a shrink_to_fit().
  */
 void DataBuffer::clear() {
-    buffer.clear();
     read_pos = 0;
     write_pos = 0;
 }
 
+/**
+ * @brief Reserva memoria para al menos capacity bytes.
+ * 
+ * @param capacity Número de bytes a reservar.
+ * 
+ * Si la capacidad actual ya es suficiente no hace nada; si no, reserva
+ * exactamente capacity bytes (sin crecimiento geométrico) y copia los datos.
+ */
+void DataBuffer::reserve(size_t capacity) {
+    if (capacity > buffer_capacity) {
+        reallocate(capacity);
+    }
+}
+
+/**
+ * @brief Obtiene la memoria reservada actualmente.
+ * 
+ * @return Número de bytes que caben sin volver a reservar.
+ */
+size_t DataBuffer::capacity() const {
+    return buffer_capacity;
+}
+
+/**
+ * @brief Ajusta la memoria reservada a los datos escritos.
+ * 
+ * Reserva un bloque de write_pos bytes y copia los datos, o libera toda la
+ * memoria si el buffer está vacío. Las posiciones no cambian.
+ */
+void DataBuffer::shrink_to_fit() {
+    if (buffer_capacity > write_pos) {
+        reallocate(write_pos);
+    }
+}
+
 /**
  * @brief Verifica si el buffer está vacío.
  * 
@@ -124,14 +170,36 @@ size_t DataBuffer::size() const {
  * 
  * @param needed Número mínimo de bytes necesarios.
  * 
- * Si el tamaño actual del vector es menor que la capacidad necesaria,
- * redimensiona el vector para que tenga al menos el tamaño needed.
+ * Si la capacidad actual es menor que la necesaria, reserva el doble de la
+ * actual (al menos minimum_capacity, o needed si es mayor). La memoria nueva
+ * no se inicializa: solo se copian los bytes ya escritos.
  * No afecta a las posiciones de lectura/escritura.
  */
 void DataBuffer::ensure_capacity(size_t needed) {
-    if (buffer.size() < needed) {
-        buffer.resize(needed);
+    if (needed <= buffer_capacity) {
+        return;
     }
+    size_t grown = buffer_capacity * 2;
+    if (grown < minimum_capacity) {
+        grown = minimum_capacity;
+    }
+    reallocate(grown > needed ? grown : needed);
+}
+
+/**
+ * @brief Cambia el bloque de memoria conservando los datos escritos.
+ * 
+ * @param capacity Nueva capacidad (0 libera la memoria).
+ * 
+ * @note new char[] no inicializa los bytes, a diferencia de std::vector::resize.
+ */
+void DataBuffer::reallocate(size_t capacity) {
+    std::unique_ptr<char[]> replacement(capacity > 0 ? new char[capacity] : NULL);
+    if (write_pos > 0) {
+        std::memcpy(replacement.get(), buffer.get(), write_pos);
+    }
+    buffer.swap(replacement);
+    buffer_capacity = capacity;
 }
 
 /**
@@ -148,11 +216,15 @@ void DataBuffer::ensure_capacity(size_t needed) {
  * @note Es el método fundamental para todas las operaciones de escritura.
  */
 void DataBuffer::write_bytes(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
     // Asegurar que hay espacio suficiente
     ensure_capacity(write_pos + size);
     
     // Copiar los datos al buffer
-    std::memcpy(buffer.data() + write_pos, data, size);
+    std::memcpy(buffer.get() + write_pos, data, size);
     
     // Actualizar posición de escritura
     write_pos += size;
@@ -179,8 +251,12 @@ void DataBuffer::read_bytes(char* data, size_t size) {
         throw std::runtime_error("DataBuffer: lectura fuera de límites");
     }
     
+    if (size == 0) {
+        return;
+    }
+
     // Copiar los datos desde el buffer
-    std::memcpy(data, buffer.data() + read_pos, size);
+    std::memcpy(data, buffer.get() + read_pos, size);
     
     // Actualizar posición de lectura
     read_pos += size;
@@ -1,26 +1,105 @@
 #include "network/client.hpp"
+#include "network/unix_socket.hpp"
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netdb.h>  // Para getaddrinfo
 #include <cstring>
 #include <errno.h>
+#include <algorithm>
+
+namespace {
+    const long handshakeTimeoutMs = 2000;
+    const uint64_t socketToken = 0;
+    const uint64_t wakeToken = 1;
+    const uint64_t shmToken = 2;
+    const uint64_t datagramEventToken = 3;
+
+    bool addToEpoll(int epollFd, int fd, uint32_t events, uint64_t token) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = token;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+}
+
+const long Client::defaultCallTimeoutMs;
 
 Client::Client()
-: sockfd(-1), isConnected(false), shouldStop(false) {}
+: sockfd(-1), epollFd(-1), wakeFd(-1), tcpSocket(false), isConnected(false), shouldStop(false),
+  actions(std::make_shared<const DispatchTable<>>()), streamActions(std::make_shared<const StreamActionMap>()),
+  nextStreamID(1), pendingStreamBytes(0), queuedStreamBytes(0), readsPaused(false),
+  queuedBytes(0), congested(false), overflowed(false),
+  requestedWireFeatures(0), negotiatedWireFeatures(0),
+  compressionThreshold(defaultCompressionThreshold), datagramSession(0), nextRequestID(1) {}
 
 Client::~Client() {
     disconnect();
 }
 
+Client::Inbound::Inbound(Message&& message, StreamID streamID)
+: message(std::move(message)), streamID(streamID) {}
+
 void Client::connect(const std::string& address, const size_t& port) {
     if (isConnected) {
         throw AlreadyConnectedException();
     }
+    if (eventLoopThread.joinable()) {
+        disconnect(); // Conexion anterior cerrada por el servidor
+    }
+
+    std::string localPath;
+    tcpSocket = false;
+    if (ShmChannel::parseAddress(address, localPath)) {
+        connectShm(localPath);
+    } else {
+        if (parseUnixAddress(address, localPath)) {
+            sockfd = connectUnixSocket(localPath, SOCK_STREAM);
+            if (sockfd < 0) {
+                throw ConnectionFailedException("Failed to connect to server: " + address);
+            }
+            if (!applySocketOptions(sockfd, socketOptions, false)) {
+                closeDescriptors();
+                throw ConnectionFailedException("Failed to set socket options");
+            }
+        } else {
+            connectSocket(address, port);
+        }
+        writer.setSendfile(true);
+        negotiateIfRequested();
+    }
+
+    // Socket no bloqueante + eventfd: el hilo despierta en cuanto hay datos o envios
+    int flags = fcntl(sockfd, F_GETFL, 0);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0
+        || epollFd < 0 || wakeFd < 0
+        || !addToEpoll(epollFd, sockfd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, socketToken)
+        || !addToEpoll(epollFd, wakeFd, EPOLLIN | EPOLLET, wakeToken)
+        || (shm && !addToEpoll(epollFd, shm->eventFd(), EPOLLIN | EPOLLET, shmToken))
+        || (datagrams.fd() >= 0 && !addToEpoll(epollFd, datagrams.fd(), EPOLLIN | EPOLLET, datagramEventToken))) {
+        closeDescriptors();
+        throw ConnectionFailedException("Failed to create event loop");
+    }
+    if (datagrams.fd() >= 0) {
+        // Para que el servidor conozca nuestra direccion UDP
+        queueDatagram(makeControlFrame(ControlType::DatagramHello, 0));
+    }
 
+    queuedBytes = 0;
+    congested = false;
+    overflowed = false;
+    isConnected = true;
+    shouldStop = false;
+    eventLoopThread = std::thread(&Client::eventLoop, this);
+}
+
+void Client::connectSocket(const std::string& address, const size_t& port) {
     // Usar getaddrinfo para resolver la dirección (funciona con localhost y IPs)
     struct addrinfo hints, *result, *rp;
     memset(&hints, 0, sizeof(hints));
@@ -43,6 +122,13 @@ void Client::connect(const std::string& address, const size_t& port) {
         if (sockfd < 0) {
             continue;
         }
+        // Antes de connect: el tamaño de buffer fija la escala de ventana del SYN
+        if (!applySocketOptions(sockfd, socketOptions, true)) {
+            close(sockfd);
+            sockfd = -1;
+            freeaddrinfo(result);
+            throw ConnectionFailedException("Failed to set socket options");
+        }
 
         if (::connect(sockfd, rp->ai_addr, rp->ai_addrlen) == 0) {
             break; // Conexión exitosa
@@ -57,42 +143,268 @@ void Client::connect(const std::string& address, const size_t& port) {
     if (sockfd < 0) {
         throw ConnectionFailedException("Failed to connect to server: " + address + ":" + std::to_string(port));
     }
+    tcpSocket = true;
+}
 
-    isConnected = true;
-    shouldStop = false;
-    receiverThread = std::thread(&Client::receiverLoop, this);
+void Client::negotiateIfRequested() {
+    negotiatedWireFeatures = 0;
+    if (requestedWireFeatures != 0) {
+        try {
+            negotiateWireFeatures();
+        } catch (...) {
+            closeDescriptors();
+            reader.clear();
+            writer.clear();
+            throw;
+        }
+    }
+}
+
+void Client::connectShm(const std::string& name) {
+    sockfd = ShmChannel::connectSocket(name);
+    if (sockfd < 0) {
+        throw ConnectionFailedException("Failed to connect to shm://" + name);
+    }
+
+    // Sin handshake de WireFeature: los anillos siempre van en formato Legacy
+    negotiatedWireFeatures = 0;
+    try {
+        shm = ShmChannel::create();
+    } catch (const ShmChannel::ShmFailedException& e) {
+        closeDescriptors();
+        throw ConnectionFailedException(e.what());
+    }
+    if (!shm->sendDescriptors(sockfd)) {
+        closeDescriptors();
+        throw ConnectionFailedException("Failed to send shared memory descriptors");
+    }
 }
 
 void Client::disconnect() {
-    if (!isConnected) return;
+    // El hilo puede haber terminado solo si el servidor cerro la conexion
+    if (!isConnected && !eventLoopThread.joinable()) return;
 
     shouldStop = true;
     isConnected = false;
     
-    if (receiverThread.joinable()) {
-        receiverThread.join();
+    if (eventLoopThread.joinable()) {
+        wakeUp();
+        eventLoopThread.join();
     }
     
-    close(sockfd);
-    sockfd = -1;
+    closeDescriptors();
+    reader.clear();
+    writer.clear();
     
-    std::lock_guard<std::mutex> lock(mutex);
-    while (!receivedMessages.empty()) receivedMessages.pop();
-    while (!messagesToSend.empty()) messagesToSend.pop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!receivedMessages.empty()) receivedMessages.pop();
+        while (!messagesToSend.empty()) messagesToSend.pop();
+        pendingStreamBytes = 0;
+        queuedStreamBytes = 0;
+        readsPaused = false;
+        while (!completions.empty()) completions.pop();
+        datagramQueue.clear();
+        datagramSequences = DatagramSequences();
+        queuedBytes = 0;
+    }
+    drained.notify_all();
+    failPendingCalls();
 }
 
 void Client::defineAction(const Message::Type& messageType, const Action& action) {
+    editActions([&](DispatchTable<>& table) {
+        if (action) {
+            table.define(messageType, action);
+        } else {
+            table.remove(messageType);
+        }
+    });
+}
+
+void Client::defineStreamAction(const Message::Type& messageType, const StreamAction& action) {
     std::lock_guard<std::mutex> lock(mutex);
-    actions[messageType] = action;
+    std::shared_ptr<StreamActionMap> table = std::make_shared<StreamActionMap>(*streamActions);
+    if (action) {
+        (*table)[messageType] = action;
+    } else {
+        table->erase(messageType);
+    }
+    streamActions = table;
+}
+
+void Client::editActions(const std::function<void(DispatchTable<>&)>& edit) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<DispatchTable<>> table = std::make_shared<DispatchTable<>>(*actions);
+    edit(*table);
+    actions = table;
+}
+
+void Client::send(const Message& message, SendPriority priority) {
+    if (!isConnected) {
+        throw NotConnectedException();
+    }
+    sendFrame(makeFrame(message, 0, 0, priority));
 }
 
-void Client::send(const Message& message) {
+Client::StreamID Client::sendStream(Message::Type type, const std::shared_ptr<StreamSource>& source,
+                                   SendPriority priority) {
     if (!isConnected) {
         throw NotConnectedException();
     }
+    if (!(negotiatedWireFeatures & WireFeatureStreams)) {
+        throw StreamsUnavailableException();
+    }
+    StreamID streamID = nextStreamID++;
+    sendFrame(makeStreamFrame(type, streamID, source, priority));
+    return streamID;
+}
+
+Client::StreamID Client::sendFile(Message::Type type, const std::string& path, SendPriority priority) {
+    return sendStream(type, StreamSource::open(path), priority);
+}
+
+void Client::sendDatagram(const Message& message) {
+    if (!isConnected) {
+        throw NotConnectedException();
+    }
+    if (!hasDatagrams()) {
+        throw DatagramsUnavailableException();
+    }
+    FrameHandle frame = makeFrame(message);
+    if (!DatagramSocket::fits(*frame)) {
+        throw DatagramTooLargeException();
+    }
+    queueDatagram(frame);
+    wakeUp();
+}
+
+bool Client::hasDatagrams() const {
+    return (negotiatedWireFeatures & WireFeatureDatagrams) != 0;
+}
+
+void Client::queueDatagram(const FrameHandle& frame) {
+    DatagramSocket::Outgoing datagram;
+    datagram.frame = frame;
+    datagram.token = datagramSession;
+    datagram.addressLength = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    datagram.sequence = datagramSequences.next(frame->type());
+    datagramQueue.push_back(datagram);
+}
+
+bool Client::openDatagrams() {
+    sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    return getpeername(sockfd, reinterpret_cast<sockaddr*>(&peer), &peerLength) == 0
+        && (peer.ss_family == AF_INET || peer.ss_family == AF_INET6)
+        && datagrams.connect(reinterpret_cast<sockaddr*>(&peer), peerLength);
+}
+
+void Client::receiveDatagrams() {
+    std::vector<DatagramSocket::Incoming> received;
+    datagrams.receive(received);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (DatagramSocket::Incoming& incoming : received) {
+        if (incoming.token != datagramSession || (incoming.flags & FrameControl)) {
+            continue;
+        }
+        // El servidor numera cada tipo: descartar lo que llegue tarde
+        if (datagramSequences.accept(incoming.message.type(), incoming.sequence)) {
+            receivedMessages.push(Inbound(std::move(incoming.message)));
+        }
+    }
+}
 
+void Client::sendFrame(const FrameHandle& original) {
+    WireFormat format = (negotiatedWireFeatures & WireFeatureCompact) ? WireFormat::Compact : WireFormat::Legacy;
+    // Sin WireFeatureCompact el servidor no sabria leer un payload Varint
+    FrameHandle frame = frameForFormat(original, format);
+    if (!frame) {
+        throw SendingFailedException();
+    }
+    size_t bytes = frame->size(format);
+    bool becameCongested = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Un frame mayor que maxBytes se acepta igualmente si la cola esta vacia
+        if (limits.maxBytes != 0 && queuedBytes > 0 && queuedBytes + bytes > limits.maxBytes) {
+            if (limits.policy == OverflowPolicy::Block) {
+                std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + limits.blockTimeout;
+                while (isConnected && queuedBytes > 0 && queuedBytes + bytes > limits.maxBytes) {
+                    if (drained.wait_until(lock, deadline) == std::cv_status::timeout) {
+                        throw SendingFailedException();
+                    }
+                }
+                if (!isConnected) {
+                    throw NotConnectedException();
+                }
+            } else {
+                if (limits.policy == OverflowPolicy::Disconnect) {
+                    overflowed = true;
+                }
+                lock.unlock();
+                if (limits.policy == OverflowPolicy::Disconnect) {
+                    wakeUp();
+                }
+                notifyBackpressure(SendQueueEvent::Overflow);
+                return;
+            }
+        }
+        messagesToSend.push(frame);
+        queuedBytes += bytes;
+        if (!congested && queuedBytes >= limits.highWatermark) {
+            congested = true;
+            becameCongested = true;
+        }
+    }
+    wakeUp();
+    if (becameCongested) {
+        notifyBackpressure(SendQueueEvent::Congested);
+    }
+}
+
+void Client::setSendQueueLimits(const SendQueueLimits& newLimits) {
     std::lock_guard<std::mutex> lock(mutex);
-    messagesToSend.push(message);
+    limits = newLimits;
+}
+
+void Client::setLaneScheduling(const LaneScheduling& scheduling) {
+    if (isConnected) {
+        throw AlreadyConnectedException();
+    }
+    writer.setScheduling(scheduling);
+}
+
+void Client::setSocketOptions(const SocketOptions& options) {
+    if (isConnected) {
+        throw AlreadyConnectedException();
+    }
+    socketOptions = options;
+}
+
+void Client::setCompressionThreshold(size_t threshold) {
+    if (isConnected) {
+        throw AlreadyConnectedException();
+    }
+    compressionThreshold = threshold;
+}
+
+void Client::setBackpressureCallback(const BackpressureCallback& callback) {
+    std::lock_guard<std::mutex> lock(mutex);
+    backpressureCallback = callback;
+}
+
+void Client::notifyBackpressure(SendQueueEvent event) {
+    BackpressureCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        callback = backpressureCallback;
+    }
+    if (callback) {
+        callback(event);
+    }
 }
 
 void Client::update() {
@@ -100,104 +412,466 @@ void Client::update() {
         throw NotConnectedException();
     }
 
-    std::queue<Message> messagesToProcess;
-    std::unordered_map<Message::Type, Action> currentActions;
+    std::queue<Inbound> messagesToProcess;
+    std::queue<Completion> completedCalls;
+    std::shared_ptr<const DispatchTable<>> currentActions;
+    std::shared_ptr<const StreamActionMap> currentStreamActions;
 
     {
         std::lock_guard<std::mutex> lock(mutex);
         messagesToProcess.swap(receivedMessages);
+        completedCalls.swap(completions);
         currentActions = actions;
+        currentStreamActions = streamActions;
+        pendingStreamBytes -= queuedStreamBytes;
+        queuedStreamBytes = 0;
+    }
+    if (readsPaused) {
+        wakeUp(); // Ya hay sitio para mas trozos de stream
+    }
+
+    while (!completedCalls.empty()) {
+        Completion completion = std::move(completedCalls.front());
+        completedCalls.pop();
+        completion.callback(completion.response, completion.error);
     }
 
     while (!messagesToProcess.empty()) {
-        Message msg = std::move(messagesToProcess.front());
+        Inbound inbound = std::move(messagesToProcess.front());
         messagesToProcess.pop();
 
-        auto it = currentActions.find(msg.type());
-        if (it != currentActions.end() && it->second) {
-            it->second(msg);
+        if (inbound.streamID == 0) {
+            currentActions->dispatch(inbound.message);
+            continue;
+        }
+        auto stream = currentStreamActions->find(inbound.message.type());
+        if (stream != currentStreamActions->end()) {
+            stream->second(StreamChunk(inbound.streamID, inbound.message));
         }
     }
 }
 
-void Client::receiverLoop() {
+std::future<Message> Client::call(const Message& request, std::chrono::milliseconds timeout) {
+    PendingCall pending;
+    std::future<Message> result = pending.promise.get_future();
+    startCall(request, std::move(pending), timeout);
+    return result;
+}
+
+void Client::call(const Message& request, const ResponseCallback& callback, std::chrono::milliseconds timeout) {
+    PendingCall pending;
+    pending.callback = callback;
+    startCall(request, std::move(pending), timeout);
+}
+
+void Client::startCall(const Message& request, PendingCall&& pending, std::chrono::milliseconds timeout) {
+    if (!isConnected) {
+        throw NotConnectedException();
+    }
+
+    // Registrar antes de enviar: la respuesta puede llegar antes de que send vuelva
+    RequestID requestID;
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        requestID = nextRequestID++;
+        pending.deadline = callDeadlines.insert(
+            std::make_pair(std::chrono::steady_clock::now() + timeout, requestID));
+        pendingCalls.insert(std::make_pair(requestID, std::move(pending)));
+    }
+
+    try {
+        sendFrame(makeFrame(request, FrameRequest, requestID));
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(callMutex);
+        auto it = pendingCalls.find(requestID);
+        if (it != pendingCalls.end()) {
+            callDeadlines.erase(it->second.deadline);
+            pendingCalls.erase(it);
+        }
+        throw;
+    }
+}
+
+void Client::completeCall(RequestID requestID, Message&& response, std::exception_ptr error) {
+    PendingCall pending;
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        auto it = pendingCalls.find(requestID);
+        if (it == pendingCalls.end()) {
+            return; // Respuesta tardia de una llamada que ya expiro
+        }
+        callDeadlines.erase(it->second.deadline);
+        pending = std::move(it->second);
+        pendingCalls.erase(it);
+    }
+
+    if (pending.callback) {
+        Completion completion;
+        completion.callback = pending.callback;
+        completion.response = std::move(response);
+        completion.error = error;
+        std::lock_guard<std::mutex> lock(mutex);
+        completions.push(std::move(completion));
+    } else if (error) {
+        pending.promise.set_exception(error);
+    } else {
+        pending.promise.set_value(std::move(response));
+    }
+}
+
+void Client::expireCalls() {
+    std::vector<RequestID> expired;
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (auto it = callDeadlines.begin(); it != callDeadlines.end() && it->first <= now; ++it) {
+            expired.push_back(it->second);
+        }
+    }
+
+    for (RequestID requestID : expired) {
+        completeCall(requestID, Message(), std::make_exception_ptr(RequestTimeoutException()));
+    }
+}
+
+int Client::nextCallTimeout() {
+    std::lock_guard<std::mutex> lock(callMutex);
+    if (callDeadlines.empty()) {
+        return -1;
+    }
+    std::chrono::steady_clock::duration left = callDeadlines.begin()->first - std::chrono::steady_clock::now();
+    if (left <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    // Redondear hacia arriba para no despertar un poco antes del plazo
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        left + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count());
+}
+
+void Client::failPendingCalls() {
+    std::unordered_map<RequestID, PendingCall> failed;
+    {
+        std::lock_guard<std::mutex> lock(callMutex);
+        failed.swap(pendingCalls);
+        callDeadlines.clear();
+    }
+
+    for (auto& entry : failed) {
+        if (!entry.second.callback) {
+            entry.second.promise.set_exception(std::make_exception_ptr(NotConnectedException()));
+        }
+    }
+}
+
+void Client::wakeUp() {
+    uint64_t one = 1;
+    ssize_t ret = ::write(wakeFd, &one, sizeof(one));
+    (void)ret; // EAGAIN solo significa que el contador ya esta activado
+}
+
+void Client::eventLoop() {
+    epoll_event events[4];
+
+    // El aviso de datos del anillo solo se arma al encontrarlo vacio
+    if (shm && !readFromServer()) {
+        isConnected = false;
+        drained.notify_all();
+        return;
+    }
+
     while (isConnected && !shouldStop) {
-        // Handle sending
-        {
-            std::lock_guard<std::mutex> lock(mutex);
-            if (!messagesToSend.empty()) {
-                try {
-                    sendMessage(messagesToSend.front());
-                    messagesToSend.pop();
-                } catch (const SendingFailedException&) {
-                    shouldStop = true;
-                    break;
+        int count = epoll_wait(epollFd, events, 4, nextCallTimeout());
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        expireCalls();
+
+        bool ok = true;
+        for (int i = 0; i < count && ok; ++i) {
+            if (events[i].data.u64 == wakeToken) {
+                uint64_t value;
+                while (::read(wakeFd, &value, sizeof(value)) > 0) {}
+                // Lo que quedo sin leer al pausar no volvera a avisar
+                if (readsPaused && !streamsFull()) {
+                    readsPaused = false;
+                    ok = readFromServer();
                 }
+                ok = ok && flushPendingMessages();
+                continue;
+            }
+            if (events[i].data.u64 == datagramEventToken) {
+                receiveDatagrams();
+                continue;
+            }
+            if (events[i].data.u64 == shmToken) {
+                // Datos nuevos o espacio libre en el anillo de salida
+                shm->clearEvent();
+                ok = readFromServer() && flushWriter();
+                continue;
+            }
+            if (shm) {
+                // El servidor nunca escribe en el socket de encuentro: solo puede ser el cierre
+                ok = !(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP));
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+                ok = readFromServer();
             }
+            if (ok && (events[i].events & EPOLLOUT)) {
+                ok = flushWriter();
+            }
+        }
+        if (!ok) {
+            break;
         }
+    }
+
+    isConnected = false;
+    drained.notify_all();
+    failPendingCalls();
+}
 
-        // Handle receiving
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(sockfd, &readfds);
+bool Client::readFromServer() {
+    std::queue<Inbound> parsed;
+    bool alive = true;
 
-        timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 100000; // 100ms
+    while (shm && !streamsFull() && shm->drain(reader)) {
+        if (!drainFrames(parsed)) {
+            alive = false;
+            break;
+        }
+    }
+
+    // Edge-triggered: leer hasta EAGAIN; un recv puede traer varios frames
+    while (!shm && !streamsFull()) {
+        ssize_t bytesRead = reader.receive(sockfd);
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (bytesRead <= 0) {
+            alive = false;
+            break;
+        }
+        if (tcpSocket) {
+            rearmQuickAck(sockfd, socketOptions);
+        }
+
+        if (!drainFrames(parsed)) {
+            alive = false;
+            break;
+        }
+    }
 
-        int activity = select(sockfd + 1, &readfds, NULL, NULL, &timeout);
-        if (activity > 0 && FD_ISSET(sockfd, &readfds)) {
-            // Read message size first
-            size_t messageSize;
-            ssize_t bytesRead = ::recv(sockfd, &messageSize, sizeof(messageSize), MSG_WAITALL);
-            
-            if (bytesRead <= 0) {
-                shouldStop = true;
-                break;
+    if (!parsed.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (!parsed.empty()) {
+            if (parsed.front().streamID != 0) {
+                queuedStreamBytes += parsed.front().message.size();
             }
+            receivedMessages.push(std::move(parsed.front()));
+            parsed.pop();
+        }
+    }
+    if (streamsFull()) {
+        readsPaused = true;
+    }
+    if (alive && !writer.empty()) {
+        alive = flushWriter();
+    }
+    return alive;
+}
 
-            if (bytesRead == sizeof(messageSize)) {
-                // Read message data
-                std::vector<char> messageData(messageSize);
-                bytesRead = ::recv(sockfd, messageData.data(), messageSize, MSG_WAITALL);
-                
-                if (bytesRead <= 0 || static_cast<size_t>(bytesRead) != messageSize) {
-                    shouldStop = true;
-                    break;
-                }
+bool Client::drainFrames(std::queue<Inbound>& parsed) {
+    Message msg(0);
+    uint8_t flags = 0;
+    RequestID requestID = 0;
+    while (true) {
+        try {
+            if (!reader.next(msg, flags, requestID)) {
+                return true;
+            }
+        } catch (const FrameReader::FrameTooLargeException&) {
+            return false;
+        } catch (const std::exception&) {
+            continue; // Ignore malformed messages
+        }
 
-                // Deserialize and queue the message
-                Message msg(0);
+        if (flags & FrameResponse) {
+            std::exception_ptr error;
+            if (flags & FrameRemoteError) {
+                std::string what;
                 try {
-                    std::string dataStr(messageData.data(), messageSize);
-                    msg.deserialize(dataStr);
-                    
-                    std::lock_guard<std::mutex> lock(mutex);
-                    receivedMessages.push(msg);
+                    msg >> what;
                 } catch (const std::exception&) {
-                    // Ignore malformed messages
                 }
+                error = std::make_exception_ptr(RemoteErrorException(what));
+            }
+            completeCall(requestID, std::move(msg), error);
+        } else if (flags & FrameStream) {
+            if (msg.size() > 0 && requestID != 0) {
+                pendingStreamBytes += msg.size();
+                parsed.push(Inbound(std::move(msg), requestID));
+            }
+        } else if (!(flags & FrameControl)) {
+            parsed.push(Inbound(std::move(msg)));
+        } else if (msg.type() == static_cast<Message::Type>(ControlType::Heartbeat)) {
+            // Responder para que el servidor no nos de por muertos; sale en el proximo flush
+            FrameHandle ack = makeControlFrame(ControlType::HeartbeatAck, 0);
+            size_t before = writer.pendingBytes();
+            writer.push(ack);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queuedBytes += writer.pendingBytes() - before;
+            }
+            if (datagrams.fd() >= 0) {
+                // Refrescar la direccion UDP por si un NAT la cambio
+                queueDatagram(makeControlFrame(ControlType::DatagramHello, 0));
             }
         }
     }
+}
 
-    isConnected = false;
+void Client::negotiateWireFeatures() {
+    // Socket aun bloqueante: Hello, y esperar el ack con un timeout. El Hello
+    // es un mensaje normal (ver makeHelloFrame): un servidor sin handshake lo
+    // ignora, nunca responde y la conexion sigue en Legacy.
+    timeval timeout;
+    timeout.tv_sec = handshakeTimeoutMs / 1000;
+    timeout.tv_usec = (handshakeTimeoutMs % 1000) * 1000;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    writer.push(makeHelloFrame(requestedWireFeatures));
+    if (!writer.flush(sockfd) || !writer.empty()) {
+        throw ConnectionFailedException("Failed to send handshake");
+    }
+
+    std::queue<Inbound> early;
+    bool acknowledged = false;
+    while (!acknowledged) {
+        ssize_t bytesRead = reader.receive(sockfd);
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (bytesRead <= 0) {
+            throw ConnectionFailedException("Connection closed during handshake");
+        }
+
+        Message msg(0);
+        uint8_t flags = 0;
+        while (!acknowledged && reader.next(msg, flags)) {
+            if (!(flags & FrameControl)) {
+                early.push(Inbound(std::move(msg))); // Enviado por el servidor antes de ver el Hello
+            } else if (msg.type() == static_cast<Message::Type>(ControlType::HelloAck)) {
+                uint32_t accepted = 0;
+                msg >> accepted;
+                if (accepted & WireFeatureDatagrams) {
+                    msg >> datagramSession;
+                    if (!openDatagrams()) {
+                        accepted &= ~static_cast<uint32_t>(WireFeatureDatagrams);
+                    }
+                }
+                negotiatedWireFeatures = accepted;
+                WireFormat format = (accepted & WireFeatureCompact) ? WireFormat::Compact : WireFormat::Legacy;
+                reader.setFormat(format);
+                writer.setFormat(format);
+                writer.setFragmentation((accepted & WireFeatureFragments) != 0);
+                writer.setCompression((accepted & WireFeatureCompression) ? compressionThreshold : 0);
+                acknowledged = true;
+            }
+        }
+    }
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // Lo que ya este en el buffer no volvera a disparar EPOLLIN
+    if (acknowledged && !drainFrames(early)) {
+        throw ConnectionFailedException("Malformed frame during handshake");
+    }
+    while (!early.empty()) {
+        receivedMessages.push(std::move(early.front()));
+        early.pop();
+    }
 }
 
-void Client::sendMessage(const Message& message) {
-    std::string serialized = message.serialize();
-    size_t messageSize = serialized.size();
+void Client::setWireFeatures(uint32_t features) {
+    requestedWireFeatures = features;
+}
 
-    // Send message size first
-    ssize_t sent = ::send(sockfd, &messageSize, sizeof(messageSize), 0);
-    if (sent != sizeof(messageSize)) {
-        throw SendingFailedException();
+uint32_t Client::wireFeatures() const {
+    return negotiatedWireFeatures;
+}
+
+bool Client::flushPendingMessages() {
+    std::queue<FrameHandle> pending;
+    std::vector<DatagramSocket::Outgoing> datagramBatch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (overflowed) {
+            return false; // OverflowPolicy::Disconnect
+        }
+        pending.swap(messagesToSend);
+        datagramBatch.swap(datagramQueue);
+    }
+    if (!datagramBatch.empty()) {
+        datagrams.send(datagramBatch); // Lo que no quepa se pierde: canal no fiable
     }
 
-    // Send message data
-    sent = ::send(sockfd, serialized.data(), messageSize, 0);
-    if (sent != static_cast<ssize_t>(messageSize)) {
-        throw SendingFailedException();
+    // Toda la cola de una vez: el writer agrupa los frames en un solo sendmsg
+    while (!pending.empty()) {
+        writer.push(pending.front());
+        pending.pop();
+    }
+    return flushWriter();
+}
+
+bool Client::flushWriter() {
+    size_t before = writer.pendingBytes();
+    // Anillo lleno no es un error: el servidor avisa por el eventfd al liberar espacio
+    bool ok = shm ? (shm->flush(writer), true) : writer.flush(sockfd);
+    size_t sent = before - writer.pendingBytes();
+    if (sent == 0) {
+        return ok;
+    }
+
+    bool becameDrained = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedBytes -= std::min(sent, queuedBytes);
+        if (congested && queuedBytes <= limits.lowWatermark) {
+            congested = false;
+            becameDrained = true;
+        }
+    }
+    drained.notify_all();
+    if (becameDrained) {
+        notifyBackpressure(SendQueueEvent::Drained);
+    }
+    return ok;
+}
+
+bool Client::streamsFull() const {
+    return pendingStreamBytes.load(std::memory_order_relaxed) >= defaultStreamWindow;
+}
+
+void Client::closeDescriptors() {
+    shm.reset();
+    datagrams.close();
+    if (sockfd != -1) {
+        close(sockfd);
+        sockfd = -1;
+    }
+    if (epollFd != -1) {
+        close(epollFd);
+        epollFd = -1;
+    }
+    if (wakeFd != -1) {
+        close(wakeFd);
+        wakeFd = -1;
     }
 }
 
@@ -212,5 +886,21 @@ const char* Client::NotConnectedException::what() const noexcept {
 Client::ConnectionFailedException::ConnectionFailedException(const std::string& msg)
 : std::runtime_error("Client: " + msg + ".") {}
 
+Client::RequestTimeoutException::RequestTimeoutException()
+: std::runtime_error("Client: Request timed out.") {}
+
+Client::RemoteErrorException::RemoteErrorException(const std::string& msg)
+: std::runtime_error("Client: Remote error: " + msg + ".") {}
+
 Client::SendingFailedException::SendingFailedException()
-: std::runtime_error("Client: Failed to send message.") {}
\ No newline at end of file
+: std::runtime_error("Client: Failed to send message.") {}
+
+const char* Client::DatagramsUnavailableException::what() const noexcept {
+    return "Client: Datagrams were not negotiated.";
+}
+
+Client::DatagramTooLargeException::DatagramTooLargeException()
+: std::runtime_error("Client: Message does not fit in a datagram.") {}
+const char* Client::StreamsUnavailableException::what() const noexcept {
+    return "Client: Streams were not negotiated.";
+}
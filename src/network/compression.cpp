@@ -0,0 +1,195 @@
+#include "network/compression.hpp"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+    const size_t minMatch = 4;
+    // El formato exige que los ultimos 5 bytes sean literales y que la
+    // ultima coincidencia empiece al menos 12 bytes antes del final
+    const size_t lastLiterals = 5;
+    const size_t matchSearchLimit = 12;
+    const size_t maxOffset = 65535;
+    const unsigned hashLog = 12;
+    // Tras 2^skipTrigger fallos seguidos la busqueda avanza mas deprisa
+    const unsigned skipTrigger = 6;
+    // Los literales cortos se copian de 16 en 16 si hay margen en ambos buffers
+    const size_t wildCopy = 16;
+
+    uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash(uint32_t value) {
+        return (value * 2654435761u) >> (32 - hashLog);
+    }
+
+    uint8_t* writeLength(uint8_t* out, size_t length) {
+        while (length >= 255) {
+            *out++ = 255;
+            length -= 255;
+        }
+        *out++ = static_cast<uint8_t>(length);
+        return out;
+    }
+
+    uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalLength,
+                           size_t offset, size_t matchLength) {
+        uint8_t* token = out++;
+        *token = static_cast<uint8_t>((literalLength < 15 ? literalLength : 15) << 4);
+        if (literalLength >= 15) {
+            out = writeLength(out, literalLength - 15);
+        }
+        std::memcpy(out, literals, literalLength);
+        out += literalLength;
+        if (matchLength == 0) {
+            return out; // Ultima secuencia: solo literales
+        }
+
+        *out++ = static_cast<uint8_t>(offset);
+        *out++ = static_cast<uint8_t>(offset >> 8);
+        size_t extra = matchLength - minMatch;
+        *token |= static_cast<uint8_t>(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            out = writeLength(out, extra - 15);
+        }
+        return out;
+    }
+
+    size_t readLength(const uint8_t*& in, const uint8_t* end, size_t length) {
+        if (length != 15) {
+            return length;
+        }
+        uint8_t byte;
+        do {
+            if (in >= end) {
+                throw std::runtime_error("Compression: Truncated length.");
+            }
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+}
+
+size_t compressBound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+size_t compressBlock(const char* data, size_t size, char* out) {
+    const uint8_t* source = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = source + size;
+    const uint8_t* anchor = source;
+    uint8_t* op = reinterpret_cast<uint8_t*>(out);
+
+    if (size > matchSearchLimit) {
+        const uint8_t* searchLimit = end - matchSearchLimit;
+        const uint8_t* matchLimit = end - lastLiterals;
+        uint32_t table[1u << hashLog];
+        std::memset(table, 0, sizeof(table));
+
+        const uint8_t* ip = source + 1;
+        unsigned misses = 1u << skipTrigger;
+        while (ip < searchLimit) {
+            uint32_t sequence = read32(ip);
+            uint32_t h = hash(sequence);
+            const uint8_t* candidate = source + table[h];
+            table[h] = static_cast<uint32_t>(ip - source);
+
+            if (candidate >= ip || static_cast<size_t>(ip - candidate) > maxOffset
+                || read32(candidate) != sequence) {
+                ip += misses++ >> skipTrigger;
+                continue;
+            }
+
+            // Extender hacia atras sobre los literales pendientes y hacia delante
+            while (ip > anchor && candidate > source && ip[-1] == candidate[-1]) {
+                --ip;
+                --candidate;
+            }
+            const uint8_t* matchEnd = ip + minMatch;
+            const uint8_t* ref = candidate + minMatch;
+            while (matchEnd < matchLimit && *matchEnd == *ref) {
+                ++matchEnd;
+                ++ref;
+            }
+
+            op = writeSequence(op, anchor, static_cast<size_t>(ip - anchor),
+                               static_cast<size_t>(ip - candidate), static_cast<size_t>(matchEnd - ip));
+            ip = matchEnd;
+            anchor = ip;
+            misses = 1u << skipTrigger;
+            if (ip < searchLimit) {
+                table[hash(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - source);
+            }
+        }
+    }
+
+    op = writeSequence(op, anchor, static_cast<size_t>(end - anchor), 0, 0);
+    return static_cast<size_t>(op - reinterpret_cast<uint8_t*>(out));
+}
+
+void decompressBlock(const char* data, size_t size, char* out, size_t outSize) {
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* inEnd = in + size;
+    uint8_t* op = reinterpret_cast<uint8_t*>(out);
+    uint8_t* const outStart = op;
+    uint8_t* const outEnd = op + outSize;
+
+    while (in < inEnd) {
+        uint8_t token = *in++;
+
+        size_t literalLength = readLength(in, inEnd, token >> 4);
+        if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > static_cast<size_t>(outEnd - op)) {
+            throw std::runtime_error("Compression: Literals out of bounds.");
+        }
+        if (literalLength <= wildCopy && static_cast<size_t>(inEnd - in) >= wildCopy
+            && static_cast<size_t>(outEnd - op) >= wildCopy) {
+            std::memcpy(op, in, wildCopy); // Tamaño fijo: sin llamada a memcpy
+        } else {
+            std::memcpy(op, in, literalLength);
+        }
+        in += literalLength;
+        op += literalLength;
+        if (in == inEnd) {
+            break; // Ultima secuencia
+        }
+
+        if (inEnd - in < 2) {
+            throw std::runtime_error("Compression: Truncated offset.");
+        }
+        size_t offset = static_cast<size_t>(in[0]) | (static_cast<size_t>(in[1]) << 8);
+        in += 2;
+        size_t matchLength = readLength(in, inEnd, token & 0x0f) + minMatch;
+        if (offset == 0 || offset > static_cast<size_t>(op - outStart)
+            || matchLength > static_cast<size_t>(outEnd - op)) {
+            throw std::runtime_error("Compression: Match out of bounds.");
+        }
+
+        const uint8_t* match = op - offset;
+        if (offset >= 8 && static_cast<size_t>(outEnd - op) >= matchLength + 8) {
+            // De 8 en 8 bytes: con offset >= 8 cada bloque ya esta escrito
+            uint8_t* matchEnd = op + matchLength;
+            do {
+                std::memcpy(op, match, 8);
+                op += 8;
+                match += 8;
+            } while (op < matchEnd);
+            op = matchEnd;
+        } else if (offset >= matchLength) {
+            std::memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            // Solapada: repite el patron de offset bytes
+            for (size_t i = 0; i < matchLength; ++i) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    if (op != outEnd) {
+        throw std::runtime_error("Compression: Decompressed size mismatch.");
+    }
+}
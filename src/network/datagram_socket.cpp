@@ -0,0 +1,194 @@
+#include "network/datagram_socket.hpp"
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <algorithm>
+
+const size_t DatagramSocket::maxDatagramSize;
+const size_t DatagramSocket::headerSize;
+const size_t DatagramSocket::batchSize;
+
+/* DatagramSequences */
+
+uint64_t DatagramSequences::next(Message::Type type) {
+    return ++sent[type];
+}
+
+bool DatagramSequences::accept(Message::Type type, uint64_t sequence) {
+    uint64_t& last = received[type];
+    if (sequence <= last) {
+        return false; // Repetido o mas viejo que el ultimo entregado
+    }
+    last = sequence;
+    return true;
+}
+
+/* DatagramSocket */
+
+DatagramSocket::DatagramSocket()
+: socketFd(-1), reader(maxDatagramSize) {}
+
+DatagramSocket::~DatagramSocket() {
+    close();
+}
+
+bool DatagramSocket::open(int family) {
+    close();
+    socketFd = ::socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    return socketFd >= 0;
+}
+
+bool DatagramSocket::bind(size_t port) {
+    if (!open(AF_INET)) {
+        return false;
+    }
+    int opt = 1;
+    setsockopt(socketFd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool DatagramSocket::connect(const sockaddr* address, socklen_t addressLength) {
+    if (!open(address->sa_family)) {
+        return false;
+    }
+    if (::connect(socketFd, address, addressLength) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void DatagramSocket::close() {
+    if (socketFd != -1) {
+        ::close(socketFd);
+        socketFd = -1;
+    }
+}
+
+int DatagramSocket::fd() const {
+    return socketFd;
+}
+
+bool DatagramSocket::fits(const OutboundFrame& frame) {
+    return headerSize + frame.size(WireFormat::Compact) <= maxDatagramSize;
+}
+
+size_t DatagramSocket::send(const std::vector<Outgoing>& datagrams) {
+    size_t sent = 0;
+    size_t next = 0;
+    while (next < datagrams.size() && socketFd >= 0) {
+        struct mmsghdr messages[batchSize];
+        struct iovec iov[batchSize][3];
+        char headers[batchSize][headerSize];
+        size_t count = std::min(batchSize, datagrams.size() - next);
+
+        std::memset(messages, 0, sizeof(messages));
+        for (size_t i = 0; i < count; ++i) {
+            const Outgoing& datagram = datagrams[next + i];
+            std::memcpy(headers[i], &datagram.token, sizeof(uint64_t));
+            std::memcpy(headers[i] + sizeof(uint64_t), &datagram.sequence, sizeof(uint64_t));
+            iov[i][0].iov_base = headers[i];
+            iov[i][0].iov_len = headerSize;
+
+            msghdr& header = messages[i].msg_hdr;
+            header.msg_iov = iov[i];
+            header.msg_iovlen = 1 + datagram.frame->fillIovec(iov[i] + 1, 0, WireFormat::Compact);
+            if (datagram.addressLength > 0) {
+                header.msg_name = const_cast<sockaddr_storage*>(&datagram.address);
+                header.msg_namelen = datagram.addressLength;
+            }
+        }
+
+        int result = ::sendmmsg(socketFd, messages, static_cast<unsigned>(count), MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break; // Buffer lleno: el resto se descarta
+            }
+            ++next; // Error de ese destino (p. ej. ICMP port unreachable): saltarlo
+            continue;
+        }
+        sent += static_cast<size_t>(result);
+        next += static_cast<size_t>(result);
+    }
+    return sent;
+}
+
+void DatagramSocket::receive(std::vector<Incoming>& received) {
+    if (buffers.empty()) {
+        buffers.resize(batchSize * maxDatagramSize);
+    }
+
+    while (socketFd >= 0) {
+        struct mmsghdr messages[batchSize];
+        struct iovec iov[batchSize];
+        sockaddr_storage addresses[batchSize];
+
+        std::memset(messages, 0, sizeof(messages));
+        for (size_t i = 0; i < batchSize; ++i) {
+            iov[i].iov_base = buffers.data() + i * maxDatagramSize;
+            iov[i].iov_len = maxDatagramSize;
+            messages[i].msg_hdr.msg_iov = &iov[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+            messages[i].msg_hdr.msg_name = &addresses[i];
+            messages[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+        }
+
+        int count = ::recvmmsg(socketFd, messages, batchSize, MSG_DONTWAIT, NULL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // EAGAIN, o un error pendiente de ICMP que no afecta al resto
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                continue;
+            }
+            Incoming incoming;
+            if (!parse(buffers.data() + i * maxDatagramSize, messages[i].msg_len, incoming)) {
+                continue;
+            }
+            std::memcpy(&incoming.address, &addresses[i], messages[i].msg_hdr.msg_namelen);
+            incoming.addressLength = messages[i].msg_hdr.msg_namelen;
+            received.push_back(std::move(incoming));
+        }
+        if (static_cast<size_t>(count) < batchSize) {
+            return;
+        }
+    }
+}
+
+bool DatagramSocket::parse(const char* data, size_t size, Incoming& incoming) {
+    if (size <= headerSize) {
+        return false;
+    }
+    std::memcpy(&incoming.token, data, sizeof(uint64_t));
+    std::memcpy(&incoming.sequence, data + sizeof(uint64_t), sizeof(uint64_t));
+
+    // Un frame completo por datagrama
+    reader.clear();
+    reader.setFormat(WireFormat::Compact);
+    reader.feed(data + headerSize, size - headerSize);
+    bool complete = false;
+    try {
+        complete = reader.next(incoming.message, incoming.flags);
+    } catch (const std::exception&) {
+        complete = false;
+    }
+    return complete && !(incoming.flags & (FrameFragment | FrameRequest | FrameResponse));
+}
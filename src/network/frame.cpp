@@ -0,0 +1,820 @@
+#include "network/frame.hpp"
+#include "network/compression.hpp"
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <atomic>
+
+namespace {
+    const size_t maxFrameSize = static_cast<size_t>(1) << 30;
+    const size_t legacyLengthMask = (static_cast<size_t>(1) << 56) - 1;
+    const size_t maxIovecs = 128;
+    const size_t minReadSpace = 16384;
+
+    std::atomic<uint64_t> copiedBytes(0);
+}
+
+/* OutboundFrame */
+
+OutboundFrame::OutboundFrame(const Message& message, uint8_t flags, uint64_t correlationId,
+                             SendPriority priority)
+: correlationId(correlationId), lane(priority), message(message) {
+    if (message.encoding() == Message::Encoding::Varint) {
+        flags |= FrameVarintPayload;
+    }
+    this->flags = flags;
+    plain.payload = this->message.data();
+    plain.payloadSize = this->message.size();
+    encodeForm(plain, flags);
+}
+
+OutboundFrame::OutboundFrame(Message::Type type, uint64_t streamID, const std::shared_ptr<StreamSource>& source,
+                             SendPriority priority)
+: flags(FrameStream), correlationId(streamID), lane(priority), message(type), source(source) {
+    plain.payload = message.data();
+    plain.payloadSize = 0;
+    encodeForm(plain, flags);
+}
+
+void OutboundFrame::encodeForm(Form& form, uint8_t formFlags) const {
+    form.legacyHeaderLength = encodeHeader(form.legacyHeader, WireFormat::Legacy, formFlags, form.payloadSize);
+    form.compactHeaderSize = encodeHeader(form.compactHeader, WireFormat::Compact, formFlags, form.payloadSize);
+    copiedBytes.fetch_add(form.legacyHeaderLength + form.compactHeaderSize + form.payloadSize,
+                          std::memory_order_relaxed);
+}
+
+size_t OutboundFrame::encodeHeader(char* out, WireFormat format, uint8_t flags, size_t bodySize) const {
+    Message::Type type = message.type();
+    bool hasCorrelation = (flags & (FrameRequest | FrameResponse | FrameStream)) != 0;
+
+    if (format == WireFormat::Legacy) {
+        size_t headerLength = hasCorrelation ? maxLegacyHeaderSize : legacyHeaderSize;
+        size_t length = headerLength - sizeof(size_t) + bodySize;
+        size_t legacyLength = length | (static_cast<size_t>(flags) << 56);
+        std::memcpy(out, &legacyLength, sizeof(legacyLength));
+        std::memcpy(out + sizeof(legacyLength), &type, sizeof(type));
+        if (hasCorrelation) {
+            std::memcpy(out + legacyHeaderSize, &correlationId, sizeof(correlationId));
+        }
+        return headerLength;
+    }
+
+    char fieldBytes[2 * maxVarintSize];
+    size_t fieldSize = encodeVarint(zigzagEncode(type), fieldBytes);
+    if (hasCorrelation) {
+        fieldSize += encodeVarint(correlationId, fieldBytes + fieldSize);
+    }
+    size_t headerLength = encodeVarint(1 + fieldSize + bodySize, out);
+    out[headerLength++] = static_cast<char>(flags);
+    std::memcpy(out + headerLength, fieldBytes, fieldSize);
+    return headerLength + fieldSize;
+}
+
+const OutboundFrame::Form& OutboundFrame::form(bool compressed) const {
+    return compressed ? *packed : plain;
+}
+
+size_t OutboundFrame::size(WireFormat format, bool compressed) const {
+    return headerSize(format, compressed) + payloadSize(compressed);
+}
+
+size_t OutboundFrame::fillIovec(struct iovec* iov, size_t offset, WireFormat format, bool compressed) const {
+    const Form& current = form(compressed);
+    const char* header = format == WireFormat::Compact ? current.compactHeader : current.legacyHeader;
+    size_t headerLength = headerSize(format, compressed);
+
+    size_t count = 0;
+    if (offset < headerLength) {
+        iov[count].iov_base = const_cast<char*>(header + offset);
+        iov[count].iov_len = headerLength - offset;
+        ++count;
+        offset = 0;
+    } else {
+        offset -= headerLength;
+    }
+    if (offset < current.payloadSize) {
+        iov[count].iov_base = const_cast<char*>(current.payload + offset);
+        iov[count].iov_len = current.payloadSize - offset;
+        ++count;
+    }
+    return count;
+}
+
+Message::Type OutboundFrame::type() const {
+    return message.type();
+}
+
+SendPriority OutboundFrame::priority() const {
+    return lane;
+}
+
+bool OutboundFrame::isControl() const {
+    return (flags & FrameControl) != 0;
+}
+
+const char* OutboundFrame::payload(bool compressed) const {
+    return form(compressed).payload;
+}
+
+size_t OutboundFrame::payloadSize(bool compressed) const {
+    return form(compressed).payloadSize;
+}
+
+size_t OutboundFrame::headerSize(WireFormat format, bool compressed) const {
+    const Form& current = form(compressed);
+    return format == WireFormat::Compact ? current.compactHeaderSize : current.legacyHeaderLength;
+}
+
+size_t OutboundFrame::encodeFragmentHeader(char* out, WireFormat format, size_t chunkSize, uint8_t info,
+                                           bool compressed) const {
+    // El byte de info cuenta como parte del cuerpo del trozo
+    uint8_t fragmentFlags = flags | FrameFragment | (compressed ? FrameCompressed : 0);
+    size_t headerLength = encodeHeader(out, format, fragmentFlags, chunkSize + 1);
+    out[headerLength++] = static_cast<char>(info);
+    return headerLength;
+}
+
+const std::shared_ptr<StreamSource>& OutboundFrame::stream() const {
+    return source;
+}
+
+size_t OutboundFrame::encodeStreamHeader(char* out, WireFormat format, size_t chunkSize, uint8_t info) const {
+    size_t headerLength = encodeHeader(out, format, flags, chunkSize + 1);
+    out[headerLength++] = static_cast<char>(info);
+    return headerLength;
+}
+
+bool OutboundFrame::compress(size_t threshold) const {
+    if (isControl() || message.size() < threshold || message.size() == 0) {
+        return false;
+    }
+    std::call_once(compressOnce, [this]() {
+        std::unique_ptr<Form> result(new Form());
+        result->storage.resize(maxVarintSize + compressBound(message.size()));
+        size_t prefix = encodeVarint(message.size(), result->storage.data());
+        size_t compressedSize = compressBlock(message.data(), message.size(), result->storage.data() + prefix);
+        if (prefix + compressedSize >= message.size()) {
+            return; // No compensa: se envia tal cual
+        }
+        result->storage.resize(prefix + compressedSize);
+        result->storage.shrink_to_fit();
+        result->payload = result->storage.data();
+        result->payloadSize = result->storage.size();
+        encodeForm(*result, flags | FrameCompressed);
+        packed = std::move(result);
+    });
+    return packed != nullptr;
+}
+
+FrameHandle OutboundFrame::fixedWidth() const {
+    std::call_once(fixedOnce, [this]() {
+        Message converted;
+        if (message.toFixed(converted)) {
+            fixed = makeFrame(converted, flags & ~FrameVarintPayload, correlationId, lane);
+        }
+    });
+    return fixed;
+}
+
+bool OutboundFrame::varintPayload() const {
+    return (flags & FrameVarintPayload) != 0;
+}
+
+FrameHandle makeFrame(const Message& message, uint8_t flags, uint64_t correlationId, SendPriority priority) {
+    return std::make_shared<const OutboundFrame>(message, flags, correlationId, priority);
+}
+
+FrameHandle makeControlFrame(ControlType type, uint32_t value) {
+    Message message(static_cast<Message::Type>(type));
+    message << value;
+    return makeFrame(message, FrameControl, 0, SendPriority::High);
+}
+
+FrameHandle makeHelloFrame(uint32_t features) {
+    Message message(helloMessageType);
+    message << helloMagic << features;
+    return makeFrame(message, 0, 0, SendPriority::High);
+}
+
+bool parseHello(const Message& msg, uint8_t flags, uint32_t& features) {
+    if (flags != 0 || msg.type() != helloMessageType || msg.size() != sizeof(helloMagic) + sizeof(features)) {
+        return false;
+    }
+    uint64_t magic = 0;
+    msg.resetRead();
+    msg >> magic;
+    if (magic != helloMagic) {
+        return false;
+    }
+    msg >> features;
+    return true;
+}
+
+FrameHandle makeStreamFrame(Message::Type type, uint64_t streamID, const std::shared_ptr<StreamSource>& source,
+                            SendPriority priority) {
+    return std::make_shared<const OutboundFrame>(type, streamID, source, priority);
+}
+
+uint64_t frameBytesCopied() {
+    return copiedBytes.load(std::memory_order_relaxed);
+}
+
+FrameHandle frameForFormat(const FrameHandle& frame, WireFormat format) {
+    if (format == WireFormat::Compact || !frame->varintPayload()) {
+        return frame;
+    }
+    return frame->fixedWidth();
+}
+
+/* FrameWriter */
+
+FrameWriter::FrameWriter()
+: readyBytes(0), frontOffset(0), queuedBytes(0), currentFormat(WireFormat::Legacy),
+  syscalls(0), fragmentation(false), compressionThreshold(0), sendfileEnabled(false), streamed(0), credits() {}
+
+void FrameWriter::push(const Message& message) {
+    push(makeFrame(message));
+}
+
+void FrameWriter::push(const FrameHandle& frame) {
+    size_t lane = frame->isControl() ? static_cast<size_t>(SendPriority::High)
+                                     : static_cast<size_t>(frame->priority());
+    Entry entry;
+    entry.frame = frame;
+    entry.format = currentFormat;
+    entry.compressed = compressionThreshold > 0 && frame->compress(compressionThreshold);
+    entry.payloadSent = 0;
+    entry.logicalLeft = frame->size(currentFormat);
+    entry.stream = frame->stream() != nullptr;
+    lanes[lane].push_back(entry);
+    queuedBytes += entry.logicalLeft;
+    refill(readyTarget());
+}
+
+bool FrameWriter::flush(int fd) {
+    while (!empty()) {
+        const Segment& front = ready.front();
+        if (front.fromFile && frontOffset >= front.headerSize) {
+            // Cuerpo de un trozo de fichero: del page cache al socket
+            const StreamSource& source = *front.frame->stream();
+            off_t position = static_cast<off_t>(source.offset() + front.payloadOffset + frontOffset - front.headerSize);
+            ssize_t sent = ::sendfile(fd, source.fd(), &position, front.size - frontOffset);
+            ++syscalls;
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            if (sent == 0) {
+                return false; // El fichero encogio: la cabecera ya prometio esos bytes
+            }
+            advance(static_cast<size_t>(sent));
+            continue;
+        }
+
+        struct iovec iov[maxIovecs];
+        struct msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = gather(iov, maxIovecs);
+        ssize_t sent = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        ++syscalls;
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        advance(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+size_t FrameWriter::gather(struct iovec* iov, size_t maxIovecs) const {
+    size_t count = 0;
+    size_t offset = frontOffset;
+    for (auto it = ready.begin(); it != ready.end() && count + 2 <= maxIovecs; ++it) {
+        if (it->stream) {
+            if (offset < it->headerSize) {
+                iov[count].iov_base = const_cast<char*>(it->header + offset);
+                iov[count].iov_len = it->headerSize - offset;
+                ++count;
+                offset = 0;
+            } else {
+                offset -= it->headerSize;
+            }
+            if (it->fromFile) {
+                break; // El cuerpo sale con sendfile en flush()
+            }
+            if (offset < it->payloadSize) {
+                iov[count].iov_base = const_cast<char*>(it->data.data() + offset);
+                iov[count].iov_len = it->payloadSize - offset;
+                ++count;
+            }
+        } else if (it->whole) {
+            count += it->frame->fillIovec(iov + count, offset, it->format, it->compressed);
+        } else {
+            if (offset < it->headerSize) {
+                iov[count].iov_base = const_cast<char*>(it->header + offset);
+                iov[count].iov_len = it->headerSize - offset;
+                ++count;
+                offset = 0;
+            } else {
+                offset -= it->headerSize;
+            }
+            iov[count].iov_base = const_cast<char*>(it->frame->payload(it->compressed) + it->payloadOffset + offset);
+            iov[count].iov_len = it->payloadSize - offset;
+            ++count;
+        }
+        offset = 0;
+    }
+    return count;
+}
+
+void FrameWriter::advance(size_t bytes) {
+    // Avanzar sobre los segmentos enviados por completo
+    while (bytes > 0) {
+        Segment& segment = ready.front();
+        size_t left = segment.size - frontOffset;
+        if (bytes < left) {
+            frontOffset += bytes;
+            if (segment.whole && !segment.compressed) {
+                queuedBytes -= bytes;
+            }
+            break;
+        }
+        bytes -= left;
+        queuedBytes -= (segment.whole && !segment.compressed) ? left : segment.logical;
+        if (segment.stream) {
+            streamed += segment.size;
+        }
+        readyBytes -= segment.size;
+        ready.pop_front();
+        frontOffset = 0;
+    }
+    refill(readyTarget());
+}
+
+bool FrameWriter::empty() const {
+    if (!ready.empty()) {
+        return false;
+    }
+    for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+        if (!lanes[lane].empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t FrameWriter::pendingBytes() const {
+    return queuedBytes;
+}
+
+uint64_t FrameWriter::sendCalls() const {
+    return syscalls;
+}
+
+void FrameWriter::clear() {
+    for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+        lanes[lane].clear();
+        credits[lane] = 0;
+    }
+    ready.clear();
+    readyBytes = 0;
+    frontOffset = 0;
+    queuedBytes = 0;
+    currentFormat = WireFormat::Legacy;
+    syscalls = 0;
+    fragmentation = false;
+    compressionThreshold = 0;
+    sendfileEnabled = false;
+    streamed = 0;
+}
+
+void FrameWriter::commit() {
+    // Los streams no: leerlos enteros a memoria es justo lo que evitan
+    refill(std::numeric_limits<size_t>::max(), false);
+}
+
+void FrameWriter::setFormat(WireFormat format) {
+    commit();
+    // Solo quedan carriles parados en un stream, que saldran tras el cambio
+    for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+        for (Entry& entry : lanes[lane]) {
+            queuedBytes -= entry.logicalLeft;
+            entry.logicalLeft = entry.frame->size(format);
+            queuedBytes += entry.logicalLeft;
+            entry.format = format;
+        }
+    }
+    currentFormat = format;
+}
+
+WireFormat FrameWriter::format() const {
+    return currentFormat;
+}
+
+void FrameWriter::setScheduling(const LaneScheduling& scheduling) {
+    this->scheduling = scheduling;
+}
+
+void FrameWriter::setFragmentation(bool enabled) {
+    fragmentation = enabled;
+}
+
+void FrameWriter::setCompression(size_t threshold) {
+    compressionThreshold = threshold;
+}
+
+void FrameWriter::setSendfile(bool enabled) {
+    sendfileEnabled = enabled;
+}
+
+uint64_t FrameWriter::streamedBytes() const {
+    return streamed;
+}
+
+size_t FrameWriter::readyTarget() const {
+    return scheduling.chunkSize > 0 ? scheduling.chunkSize : defaultReadyTarget;
+}
+
+void FrameWriter::refill(size_t targetBytes, bool streams) {
+    while (readyBytes < targetBytes) {
+        size_t lane = pickLane(streams);
+        if (lane == sendPriorityCount) {
+            break;
+        }
+        scheduleFrom(lane);
+    }
+}
+
+size_t FrameWriter::pickLane(bool streams) {
+    if (scheduling.strict) {
+        for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+            if (!lanes[lane].empty() && (streams || !lanes[lane].front().stream)) {
+                return lane;
+            }
+        }
+        return sendPriorityCount;
+    }
+
+    // Round robin ponderado suave: cada carril con datos gana su peso y el
+    // elegido paga el total, asi los turnos quedan repartidos
+    size_t best = sendPriorityCount;
+    int total = 0;
+    for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+        if (lanes[lane].empty() || (!streams && lanes[lane].front().stream)) {
+            continue;
+        }
+        int weight = scheduling.weights[lane] > 0 ? static_cast<int>(scheduling.weights[lane]) : 1;
+        credits[lane] += weight;
+        total += weight;
+        if (best == sendPriorityCount || credits[lane] > credits[best]) {
+            best = lane;
+        }
+    }
+    if (best != sendPriorityCount) {
+        credits[best] -= total;
+    }
+    return best;
+}
+
+void FrameWriter::scheduleFrom(size_t lane) {
+    Entry& entry = lanes[lane].front();
+    if (entry.stream) {
+        scheduleStream(lane);
+        return;
+    }
+    const OutboundFrame& frame = *entry.frame;
+    Segment segment;
+    segment.frame = entry.frame;
+    segment.format = entry.format;
+    segment.compressed = entry.compressed;
+    segment.fromFile = false;
+    segment.stream = false;
+
+    size_t payloadSize = frame.payloadSize(entry.compressed);
+    bool split = fragmentation && scheduling.chunkSize > 0 && !frame.isControl()
+        && payloadSize > scheduling.chunkSize;
+    if (!split) {
+        segment.whole = true;
+        segment.size = frame.size(entry.format, entry.compressed);
+        segment.logical = entry.logicalLeft;
+        segment.payloadOffset = 0;
+        segment.payloadSize = payloadSize;
+        segment.headerSize = 0;
+        ready.push_back(segment);
+        readyBytes += segment.size;
+        lanes[lane].pop_front();
+        return;
+    }
+
+    size_t remaining = payloadSize - entry.payloadSent;
+    size_t chunk = std::min(remaining, scheduling.chunkSize);
+    bool last = chunk == remaining;
+    uint8_t info = static_cast<uint8_t>(lane) | (last ? OutboundFrame::fragmentLast : 0);
+
+    segment.whole = false;
+    segment.payloadOffset = entry.payloadSent;
+    segment.payloadSize = chunk;
+    segment.headerSize = frame.encodeFragmentHeader(segment.header, entry.format, chunk, info, entry.compressed);
+    segment.size = segment.headerSize + chunk;
+    // pendingBytes cuenta el frame original sin comprimir: la cabecera va con
+    // el primer trozo y el ultimo se lleva lo que quede
+    segment.logical = chunk + (entry.payloadSent == 0 ? frame.headerSize(entry.format, entry.compressed) : 0);
+    if (last || segment.logical > entry.logicalLeft) {
+        segment.logical = entry.logicalLeft;
+    }
+    entry.logicalLeft -= segment.logical;
+    ready.push_back(segment);
+    readyBytes += segment.size;
+
+    entry.payloadSent += chunk;
+    if (last) {
+        lanes[lane].pop_front();
+    }
+}
+
+void FrameWriter::scheduleStream(size_t lane) {
+    Entry& entry = lanes[lane].front();
+    StreamSource& source = *entry.frame->stream();
+    size_t chunk = readyTarget();
+    Segment segment;
+    segment.frame = entry.frame;
+    segment.format = entry.format;
+    segment.compressed = false;
+    segment.whole = false;
+    segment.stream = true;
+    segment.payloadOffset = entry.payloadSent;
+
+    uint8_t info = 0;
+    if (sendfileEnabled && source.isFile()) {
+        // Los datos se quedan en el fichero hasta flush()
+        uint64_t left = source.size() - entry.payloadSent;
+        segment.payloadSize = left < chunk ? static_cast<size_t>(left) : chunk;
+        segment.fromFile = segment.payloadSize > 0;
+        if (segment.payloadSize == left) {
+            info = StreamChunk::infoLast;
+        }
+    } else {
+        segment.fromFile = false;
+        segment.data.resize(chunk);
+        size_t got = 0;
+        try {
+            // Un Reader puede devolver menos de lo pedido sin haber terminado
+            while (got < chunk) {
+                size_t read = source.read(entry.payloadSent + got, segment.data.data() + got, chunk - got);
+                if (read == 0) {
+                    break;
+                }
+                got += read;
+            }
+            uint64_t end = entry.payloadSent + got;
+            if (got < chunk || (source.isFile() && end >= source.size())) {
+                info = StreamChunk::infoLast;
+                if (source.isFile() && end < source.size()) {
+                    info |= StreamChunk::infoAborted; // El fichero encogio
+                }
+            }
+        } catch (const StreamSource::ReadFailedException&) {
+            info = StreamChunk::infoLast | StreamChunk::infoAborted;
+        }
+        segment.data.resize(got);
+        segment.payloadSize = got;
+    }
+
+    bool last = (info & StreamChunk::infoLast) != 0;
+    segment.headerSize = entry.frame->encodeStreamHeader(segment.header, entry.format, segment.payloadSize, info);
+    segment.size = segment.headerSize + segment.payloadSize;
+    // pendingBytes solo cuenta la cabecera del frame, y la descuenta el ultimo trozo
+    segment.logical = last ? entry.logicalLeft : 0;
+    entry.logicalLeft -= segment.logical;
+    entry.payloadSent += segment.payloadSize;
+    readyBytes += segment.size;
+    ready.push_back(std::move(segment));
+    if (last) {
+        lanes[lane].pop_front();
+    }
+}
+
+/* FrameReader */
+
+FrameReader::FrameReader(size_t initialCapacity)
+: buffer(initialCapacity), readPos(0), writePos(0), currentFormat(WireFormat::Legacy), totalReceived(0) {}
+
+ssize_t FrameReader::receive(int fd) {
+    makeRoom(minReadSpace);
+    ssize_t bytesRead;
+    do {
+        bytesRead = ::recv(fd, buffer.data() + writePos, buffer.size() - writePos, 0);
+    } while (bytesRead < 0 && errno == EINTR);
+
+    if (bytesRead > 0) {
+        writePos += static_cast<size_t>(bytesRead);
+        totalReceived += static_cast<uint64_t>(bytesRead);
+    }
+    return bytesRead;
+}
+
+void FrameReader::feed(const char* data, size_t size) {
+    makeRoom(size);
+    std::memcpy(buffer.data() + writePos, data, size);
+    writePos += size;
+    totalReceived += size;
+}
+
+bool FrameReader::next(Message& message, uint8_t& flags) {
+    uint64_t correlationId;
+    return next(message, flags, correlationId);
+}
+
+bool FrameReader::next(Message& message, uint8_t& flags, uint64_t& correlationId) {
+    while (true) {
+        const char* start = buffer.data() + readPos;
+        size_t available = writePos - readPos;
+
+        size_t prefixSize;
+        size_t length;
+        if (currentFormat == WireFormat::Legacy) {
+            if (available < sizeof(size_t)) {
+                return false;
+            }
+            size_t raw;
+            std::memcpy(&raw, start, sizeof(raw));
+            prefixSize = sizeof(raw);
+            length = raw & legacyLengthMask;
+            flags = static_cast<uint8_t>(raw >> 56);
+        } else {
+            uint64_t raw = 0;
+            try {
+                prefixSize = decodeVarint(start, available, raw);
+            } catch (const std::runtime_error&) {
+                throw FrameTooLargeException();
+            }
+            if (prefixSize == 0) {
+                return false;
+            }
+            length = static_cast<size_t>(raw);
+        }
+
+        if (length > maxFrameSize) {
+            throw FrameTooLargeException();
+        }
+        if (available - prefixSize < length) {
+            // Frame incompleto: asegurar que cabra entero en el buffer
+            makeRoom(prefixSize + length - available);
+            return false;
+        }
+
+        const char* frame = start + prefixSize;
+        consume(prefixSize + length);
+
+        Message::Type type;
+        size_t headerSize;
+        if (currentFormat == WireFormat::Legacy) {
+            if (length < sizeof(type)) {
+                throw Message::DeserializationFailedException("Data too short for message type");
+            }
+            std::memcpy(&type, frame, sizeof(type));
+            headerSize = sizeof(type);
+        } else {
+            uint64_t rawType = 0;
+            size_t typeSize = length > 1 ? decodeVarint(frame + 1, length - 1, rawType) : 0;
+            if (typeSize == 0) {
+                throw Message::DeserializationFailedException("Data too short for message type");
+            }
+            flags = static_cast<uint8_t>(frame[0]);
+            type = static_cast<Message::Type>(zigzagDecode(rawType));
+            headerSize = 1 + typeSize;
+        }
+
+        correlationId = 0;
+        if (flags & (FrameRequest | FrameResponse | FrameStream)) {
+            size_t idSize = 0;
+            if (currentFormat == WireFormat::Legacy) {
+                if (length - headerSize >= sizeof(correlationId)) {
+                    std::memcpy(&correlationId, frame + headerSize, sizeof(correlationId));
+                    idSize = sizeof(correlationId);
+                }
+            } else {
+                idSize = decodeVarint(frame + headerSize, length - headerSize, correlationId);
+            }
+            if (idSize == 0) {
+                throw Message::DeserializationFailedException("Data too short for correlation ID");
+            }
+            headerSize += idSize;
+        }
+
+        Message::Encoding encoding = (flags & FrameVarintPayload) ? Message::Encoding::Varint : Message::Encoding::Fixed;
+        if (!(flags & FrameFragment)) {
+            assignPayload(message, type, encoding, flags, frame + headerSize, length - headerSize);
+            return true;
+        }
+
+        // Trozo de un frame mayor: acumular en su carril hasta el ultimo
+        if (length - headerSize < 1) {
+            throw Message::DeserializationFailedException("Data too short for fragment info");
+        }
+        uint8_t info = static_cast<uint8_t>(frame[headerSize]);
+        size_t lane = info & ~OutboundFrame::fragmentLast;
+        if (lane >= sendPriorityCount) {
+            throw Message::DeserializationFailedException("Invalid fragment lane");
+        }
+        std::vector<char>& pending = fragments[lane];
+        size_t chunkSize = length - headerSize - 1;
+        if (pending.size() + chunkSize > maxFrameSize) {
+            throw FrameTooLargeException();
+        }
+        pending.insert(pending.end(), frame + headerSize + 1, frame + length);
+        if (info & OutboundFrame::fragmentLast) {
+            flags &= static_cast<uint8_t>(~FrameFragment);
+            // Vaciar el carril antes de descomprimir, por si el payload es invalido
+            assembled.swap(pending);
+            pending.clear();
+            assignPayload(message, type, encoding, flags, assembled.data(), assembled.size());
+            return true;
+        }
+    }
+}
+
+void FrameReader::assignPayload(Message& message, Message::Type type, Message::Encoding encoding,
+                                uint8_t& flags, const char* payload, size_t size) {
+    if (!(flags & FrameCompressed)) {
+        message.assign(type, encoding, payload, size);
+        return;
+    }
+
+    uint64_t originalSize = 0;
+    size_t prefix;
+    try {
+        prefix = decodeVarint(payload, size, originalSize);
+    } catch (const std::runtime_error&) {
+        prefix = 0;
+    }
+    if (prefix == 0) {
+        throw Message::DeserializationFailedException("Invalid compressed payload size");
+    }
+    if (originalSize > maxFrameSize) {
+        throw FrameTooLargeException();
+    }
+    inflated.resize(static_cast<size_t>(originalSize));
+    try {
+        decompressBlock(payload + prefix, size - prefix, inflated.data(), inflated.size());
+    } catch (const std::runtime_error& e) {
+        throw Message::DeserializationFailedException(e.what());
+    }
+    flags &= static_cast<uint8_t>(~FrameCompressed);
+    message.assign(type, encoding, inflated.data(), inflated.size());
+}
+
+void FrameReader::clear() {
+    readPos = 0;
+    writePos = 0;
+    for (size_t lane = 0; lane < sendPriorityCount; ++lane) {
+        fragments[lane].clear();
+    }
+    totalReceived = 0;
+    currentFormat = WireFormat::Legacy;
+}
+
+void FrameReader::setFormat(WireFormat format) {
+    currentFormat = format;
+}
+
+uint64_t FrameReader::receivedBytes() const {
+    return totalReceived;
+}
+
+WireFormat FrameReader::format() const {
+    return currentFormat;
+}
+
+void FrameReader::makeRoom(size_t needed) {
+    if (buffer.size() - writePos >= needed) {
+        return;
+    }
+    if (readPos > 0) {
+        std::memmove(buffer.data(), buffer.data() + readPos, writePos - readPos);
+        writePos -= readPos;
+        readPos = 0;
+    }
+    if (buffer.size() - writePos < needed) {
+        buffer.resize(writePos + needed);
+    }
+}
+
+void FrameReader::consume(size_t size) {
+    readPos += size;
+    if (readPos == writePos) {
+        readPos = 0;
+        writePos = 0;
+    }
+}
+
+FrameReader::FrameTooLargeException::FrameTooLargeException()
+: std::runtime_error("FrameReader: Frame exceeds the maximum size.") {}
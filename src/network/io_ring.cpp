@@ -0,0 +1,292 @@
+#include "network/io_ring.hpp"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace {
+    // Features que se dan por supuestas: un solo mmap para SQ y CQ, sin
+    // perder completions, timeout en enter y SQEs copiadas al enviarlas
+    const unsigned requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+        | IORING_FEAT_EXT_ARG | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_FAST_POLL;
+    const unsigned short bufferGroup = 0;
+
+    int setupRing(unsigned entries, struct io_uring_params* params) {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int enterRing(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags,
+                  const void* arg, size_t argSize) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+    }
+
+    int registerRing(int fd, unsigned opcode, const void* arg, unsigned count) {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+    }
+
+    unsigned nextPowerOfTwo(unsigned value) {
+        unsigned result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+}
+
+IoRing::IoRing(unsigned entries, unsigned bufferCount, size_t bufferSize)
+: ringFd(-1), ringMapping(MAP_FAILED), ringSize(0), sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+  sqesSize(0), sqLocalTail(0), bufferRing(static_cast<struct io_uring_buf*>(MAP_FAILED)),
+  bufferRingSize(0), bufferTail(0), bufferSize(bufferSize), enterCount(0) {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    // CQ holgada: con multishot cada peticion puede dejar muchas completions
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * 8;
+    ringFd = setupRing(entries, &params);
+    if (ringFd < 0) {
+        throw IoRingFailedException("io_uring_setup");
+    }
+    if ((params.features & requiredFeatures) != requiredFeatures) {
+        release();
+        throw IoRingFailedException("missing kernel features");
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize = sqSize > cqSize ? sqSize : cqSize;
+    ringMapping = ::mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd, IORING_OFF_SQ_RING);
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = static_cast<struct io_uring_sqe*>(::mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+                                                    MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+    if (ringMapping == MAP_FAILED || sqes == MAP_FAILED) {
+        release();
+        throw IoRingFailedException("mmap");
+    }
+
+    char* base = static_cast<char*>(ringMapping);
+    sqHead = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqLocalTail = *sqTail;
+    unsigned* sqArray = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    for (unsigned i = 0; i < sqEntries; ++i) {
+        sqArray[i] = i; // Cada posicion del anillo usa la SQE del mismo indice
+    }
+    cqHead = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(base + params.cq_off.cqes);
+
+    // Buffers provistos: el kernel elige uno por recv y lo indica en la completion
+    bufferCount = nextPowerOfTwo(bufferCount > 0 ? bufferCount : 1);
+    bufferMask = bufferCount - 1;
+    bufferRingSize = bufferCount * sizeof(struct io_uring_buf);
+    bufferRing = static_cast<struct io_uring_buf*>(::mmap(NULL, bufferRingSize, PROT_READ | PROT_WRITE,
+                                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (bufferRing == MAP_FAILED) {
+        release();
+        throw IoRingFailedException("mmap");
+    }
+    struct io_uring_buf_reg registration;
+    std::memset(&registration, 0, sizeof(registration));
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    registration.ring_entries = bufferCount;
+    registration.bgid = bufferGroup;
+    if (registerRing(ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        release();
+        throw IoRingFailedException("IORING_REGISTER_PBUF_RING");
+    }
+    bufferStorage.resize(bufferCount * bufferSize);
+    for (unsigned i = 0; i < bufferCount; ++i) {
+        provide(static_cast<unsigned short>(i));
+    }
+}
+
+IoRing::~IoRing() {
+    // Cancelar todo y esperar a que el kernel lo confirme: un recv en curso
+    // podria escribir en bufferStorage despues de liberarlo
+    const uint64_t shutdownData = ~0ULL;
+    struct io_uring_sqe* sqe = prepare(IORING_OP_ASYNC_CANCEL, -1, shutdownData);
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    struct io_uring_cqe completions[64];
+    bool cancelled = false;
+    for (int tries = 0; tries < 10 && !cancelled; ++tries) {
+        enter(10);
+        size_t count;
+        while ((count = reap(completions, 64)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                cancelled = cancelled || completions[i].user_data == shutdownData;
+            }
+        }
+    }
+    release();
+}
+
+bool IoRing::available() {
+    static int cached = -1;
+    if (cached >= 0) {
+        return cached == 1;
+    }
+
+    struct utsname name;
+    int major = 0;
+    int minor = 0;
+    cached = 0;
+    if (::uname(&name) == 0 && std::sscanf(name.release, "%d.%d", &major, &minor) == 2
+        && (major > 6 || (major == 6 && minor >= 0))) {
+        // Puede estar deshabilitado (kernel.io_uring_disabled, seccomp)
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = setupRing(2, &params);
+        if (fd >= 0) {
+            cached = (params.features & requiredFeatures) == requiredFeatures ? 1 : 0;
+            ::close(fd);
+        }
+    }
+    return cached == 1;
+}
+
+void IoRing::accept(int fd, uint64_t userData) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_ACCEPT, fd, userData);
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+}
+
+void IoRing::poll(int fd, uint32_t events, uint64_t userData) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_POLL_ADD, fd, userData);
+    sqe->poll32_events = events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+}
+
+void IoRing::receive(int fd, uint64_t userData) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_RECV, fd, userData);
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = bufferGroup;
+}
+
+void IoRing::sendMessage(int fd, const struct msghdr* msg, uint64_t userData) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_SENDMSG, fd, userData);
+    sqe->addr = reinterpret_cast<uint64_t>(msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+void IoRing::cancel(uint64_t userData) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_ASYNC_CANCEL, -1, 0);
+    sqe->addr = userData;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+}
+
+void IoRing::cancelAndClose(int fd) {
+    struct io_uring_sqe* sqe = prepare(IORING_OP_ASYNC_CANCEL, fd, 0);
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    // Hardlink: el close va aunque la cancelacion no encuentre nada (-ENOENT)
+    sqe->flags = IOSQE_IO_HARDLINK;
+    prepare(IORING_OP_CLOSE, fd, 0);
+}
+
+void IoRing::enter(int timeoutMs) {
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec timeout;
+    struct io_uring_getevents_arg arg;
+    std::memset(&arg, 0, sizeof(arg));
+    if (timeoutMs >= 0) {
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000000;
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+    }
+    // Con completions ya pendientes no hay que esperar
+    unsigned waitFor = *cqHead == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) ? 1 : 0;
+    enterRing(ringFd, toSubmit, waitFor, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    ++enterCount; // -ETIME / -EINTR: se vuelve a la vuelta del event loop
+}
+
+void IoRing::submit() {
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (toSubmit > 0) {
+        enterRing(ringFd, toSubmit, 0, 0, NULL, 0);
+        ++enterCount;
+    }
+}
+
+size_t IoRing::reap(struct io_uring_cqe* out, size_t max) {
+    unsigned head = *cqHead;
+    unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    while (head != tail && count < max) {
+        out[count++] = cqes[head & cqMask];
+        ++head;
+    }
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+const char* IoRing::buffer(const struct io_uring_cqe& cqe) const {
+    unsigned id = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+    return bufferStorage.data() + static_cast<size_t>(id) * bufferSize;
+}
+
+void IoRing::recycle(const struct io_uring_cqe& cqe) {
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+        provide(static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+    }
+}
+
+uint64_t IoRing::enters() const {
+    return enterCount;
+}
+
+struct io_uring_sqe* IoRing::prepare(uint8_t opcode, int fd, uint64_t userData) {
+    if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        submit(); // SQ llena: con SUBMIT_ALL el kernel las consume todas
+    }
+    struct io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = userData;
+    ++sqLocalTail;
+    return sqe;
+}
+
+void IoRing::provide(unsigned short id) {
+    struct io_uring_buf& slot = bufferRing[bufferTail & bufferMask];
+    slot.addr = reinterpret_cast<uint64_t>(bufferStorage.data() + static_cast<size_t>(id) * bufferSize);
+    slot.len = static_cast<uint32_t>(bufferSize);
+    slot.bid = id;
+    ++bufferTail;
+    // La cola compartida ocupa el campo resv de la primera entrada (io_uring_buf_ring)
+    __atomic_store_n(&bufferRing[0].resv, bufferTail, __ATOMIC_RELEASE);
+}
+
+void IoRing::release() {
+    if (ringFd >= 0) {
+        ::close(ringFd);
+        ringFd = -1;
+    }
+    if (ringMapping != MAP_FAILED) {
+        ::munmap(ringMapping, ringSize);
+        ringMapping = MAP_FAILED;
+    }
+    if (sqes != MAP_FAILED) {
+        ::munmap(sqes, sqesSize);
+        sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    }
+    if (bufferRing != MAP_FAILED) {
+        ::munmap(bufferRing, bufferRingSize);
+        bufferRing = static_cast<struct io_uring_buf*>(MAP_FAILED);
+    }
+}
+
+IoRing::IoRingFailedException::IoRingFailedException(const std::string& msg)
+: std::runtime_error("io_uring: " + msg + ".") {}
@@ -1,54 +1,325 @@
 #include "network/message.hpp"
 #include <cstring>
+#include <mutex>
+#include <algorithm>
 
-Message::Message(Type type)
-: msgType(type), readPos(0) {}
+namespace {
+    // Pool de bloques por clases de tamaño potencia de 2 (128 B .. 64 KiB).
+    // Los Messages se crean en el event loop y se destruyen en update(), asi
+    // que el pool es global y cada clase tiene su propio mutex.
+    const size_t minBlockShift = 7;
+    const size_t maxBlockShift = 16;
+    const size_t blockClasses = maxBlockShift - minBlockShift + 1;
+    const size_t maxCachedBlocks = 1024;
+
+    struct BlockPool {
+        std::mutex mutex;
+        std::vector<char*> blocks;
+    };
+
+    BlockPool* blockPools() {
+        // Nunca se destruye: un Message estatico puede liberar su bloque al final
+        static BlockPool* pools = new BlockPool[blockClasses];
+        return pools;
+    }
+
+    size_t roundCapacity(size_t needed) {
+        size_t capacity = static_cast<size_t>(1) << minBlockShift;
+        while (capacity < needed) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    size_t classOf(size_t capacity) {
+        size_t shift = minBlockShift;
+        while ((static_cast<size_t>(1) << shift) < capacity) {
+            ++shift;
+        }
+        return shift - minBlockShift;
+    }
+
+    char* acquireBlock(size_t capacity) {
+        if (capacity <= (static_cast<size_t>(1) << maxBlockShift)) {
+            BlockPool& pool = blockPools()[classOf(capacity)];
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (!pool.blocks.empty()) {
+                char* block = pool.blocks.back();
+                pool.blocks.pop_back();
+                return block;
+            }
+        }
+        return new char[capacity];
+    }
+
+    void releaseBlock(char* block, size_t capacity) {
+        if (capacity <= (static_cast<size_t>(1) << maxBlockShift)) {
+            BlockPool& pool = blockPools()[classOf(capacity)];
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            if (pool.blocks.size() < maxCachedBlocks) {
+                pool.blocks.push_back(block);
+                return;
+            }
+        }
+        delete[] block;
+    }
+}
+
+Message::Message(Type type, Encoding encoding)
+: msgType(type), fieldEncoding(encoding), storage(inlineBuffer), length(0), capacity(inlineCapacity), readPos(0),
+  fieldCount(0), layoutKnown(true) {}
 
 Message::Message(const Message& other)
-: msgType(other.msgType), buffer(other.buffer), readPos(0) {}
+: msgType(other.msgType), fieldEncoding(other.fieldEncoding), storage(inlineBuffer), length(0), capacity(inlineCapacity), readPos(0),
+  fieldCount(0), overflowFields(other.overflowFields), layoutKnown(true) {
+    append(other.storage, other.length);
+    copyLayout(other);
+}
+
+Message::Message(Message&& other) noexcept
+: msgType(other.msgType), fieldEncoding(other.fieldEncoding), storage(inlineBuffer), length(other.length), capacity(inlineCapacity), readPos(0),
+  fieldCount(0), overflowFields(std::move(other.overflowFields)), layoutKnown(true) {
+    copyLayout(other);
+    if (other.storage == other.inlineBuffer) {
+        std::memcpy(inlineBuffer, other.inlineBuffer, other.length);
+    } else {
+        // Robar el bloque del pool
+        storage = other.storage;
+        capacity = other.capacity;
+        other.storage = other.inlineBuffer;
+        other.capacity = inlineCapacity;
+    }
+    other.length = 0;
+    other.readPos = 0;
+    other.clearLayout(true);
+}
 
 Message& Message::operator=(const Message& other) {
     if (this != &other) {
         msgType = other.msgType;
-        buffer = other.buffer;
+        fieldEncoding = other.fieldEncoding;
+        length = 0;
+        append(other.storage, other.length);
+        readPos = 0;
+        overflowFields = other.overflowFields;
+        copyLayout(other);
+    }
+    return *this;
+}
+
+Message& Message::operator=(Message&& other) noexcept {
+    if (this != &other) {
+        releaseStorage();
+        msgType = other.msgType;
+        fieldEncoding = other.fieldEncoding;
+        length = other.length;
+        if (other.storage == other.inlineBuffer) {
+            std::memcpy(inlineBuffer, other.inlineBuffer, other.length);
+        } else {
+            storage = other.storage;
+            capacity = other.capacity;
+            other.storage = other.inlineBuffer;
+            other.capacity = inlineCapacity;
+        }
+        other.length = 0;
+        other.readPos = 0;
         readPos = 0;
+        overflowFields = std::move(other.overflowFields);
+        copyLayout(other);
+        other.clearLayout(true);
     }
     return *this;
 }
 
+Message::~Message() {
+    releaseStorage();
+}
+
 Message::Type Message::type() const {
     return msgType;
 }
 
+Message::Encoding Message::encoding() const {
+    return fieldEncoding;
+}
+
 std::string Message::serialize() const {
     std::string result;
-    result.resize(sizeof(msgType) + buffer.size());
+    result.resize(sizeof(msgType) + length);
     
     std::memcpy(&result[0], &msgType, sizeof(msgType));
-    if (!buffer.empty()) {
-        std::memcpy(&result[sizeof(msgType)], buffer.data(), buffer.size());
+    if (length > 0) {
+        std::memcpy(&result[sizeof(msgType)], storage, length);
     }
     
     return result;
 }
 
 void Message::deserialize(const std::string& data) {
-    if (data.size() < sizeof(msgType)) {
+    deserialize(data.data(), data.size());
+}
+
+void Message::deserialize(const char* data, size_t size) {
+    if (size < sizeof(msgType)) {
         throw DeserializationFailedException("Data too short for message type");
     }
     
-    std::memcpy(&msgType, &data[0], sizeof(msgType));
-    buffer.resize(data.size() - sizeof(msgType));
-    if (!buffer.empty()) {
-        std::memcpy(buffer.data(), &data[sizeof(msgType)], buffer.size());
+    Type type;
+    std::memcpy(&type, data, sizeof(type));
+    assign(type, Encoding::Fixed, data + sizeof(type), size - sizeof(type));
+}
+
+void Message::assign(Type type, Encoding encoding, const char* payload, size_t size) {
+    msgType = type;
+    fieldEncoding = encoding;
+    // Los enteros de un payload recibido no se pueden localizar
+    clearLayout(encoding == Encoding::Fixed);
+    resize(size);
+    if (size > 0) {
+        std::memcpy(storage, payload, size);
     }
     readPos = 0;
 }
 
+bool Message::toFixed(Message& out) const {
+    if (!layoutKnown) {
+        return false;
+    }
+    out.assign(msgType, Encoding::Fixed, nullptr, 0);
+    out.reserve(length + fieldCount * sizeof(uint64_t));
+    size_t pos = 0;
+    for (size_t i = 0; i < fieldCount; ++i) {
+        const VarintField& field = varintField(i);
+        out.append(storage + pos, field.offset - pos);
+        uint64_t raw = 0;
+        pos = field.offset + decodeVarint(storage + field.offset, length - field.offset, raw);
+        // Los mismos bytes que habria escrito writeField con Encoding::Fixed
+        int64_t value = field.isSigned ? zigzagDecode(raw) : static_cast<int64_t>(raw);
+        switch (field.width) {
+        case 2: { int16_t fixed = static_cast<int16_t>(value); out.append(&fixed, sizeof(fixed)); break; }
+        case 4: { int32_t fixed = static_cast<int32_t>(value); out.append(&fixed, sizeof(fixed)); break; }
+        default: { int64_t fixed = value; out.append(&fixed, sizeof(fixed)); break; }
+        }
+    }
+    out.append(storage + pos, length - pos);
+    return true;
+}
+
+const char* Message::data() const {
+    return storage;
+}
+
+size_t Message::size() const {
+    return length;
+}
+
+void Message::reserve(size_t newCapacity) {
+    if (newCapacity <= capacity) {
+        return;
+    }
+    size_t rounded = roundCapacity(newCapacity);
+    char* block = acquireBlock(rounded);
+    if (length > 0) {
+        std::memcpy(block, storage, length);
+    }
+    releaseStorage();
+    storage = block;
+    capacity = rounded;
+}
+
 void Message::resetRead() const {
     readPos = 0;
 }
 
+void Message::append(const void* bytes, size_t size) {
+    if (length + size > capacity) {
+        reserve(std::max(length + size, capacity * 2));
+    }
+    if (size > 0) {
+        std::memcpy(storage + length, bytes, size);
+    }
+    length += size;
+}
+
+void Message::read(void* bytes, size_t size) const {
+    if (readPos + size > length) {
+        throw DeserializationFailedException("Not enough data to read");
+    }
+    std::memcpy(bytes, storage + readPos, size);
+    readPos += size;
+}
+
+void Message::appendVarint(uint64_t value) {
+    char bytes[maxVarintSize];
+    append(bytes, encodeVarint(value, bytes));
+}
+
+void Message::recordVarintField(size_t offset, uint8_t width, bool isSigned) {
+    if (!layoutKnown) {
+        return;
+    }
+    if (offset > UINT32_MAX) {
+        clearLayout(false); // No cabe en VarintField: toFixed() fallara
+        return;
+    }
+    VarintField field = {static_cast<uint32_t>(offset), width, isSigned};
+    if (fieldCount < inlineFieldCapacity) {
+        inlineFields[fieldCount] = field;
+    } else {
+        overflowFields.push_back(field);
+    }
+    ++fieldCount;
+}
+
+const Message::VarintField& Message::varintField(size_t index) const {
+    return index < inlineFieldCapacity ? inlineFields[index] : overflowFields[index - inlineFieldCapacity];
+}
+
+// overflowFields lo copia o mueve quien llama
+void Message::copyLayout(const Message& other) {
+    fieldCount = other.fieldCount;
+    layoutKnown = other.layoutKnown;
+    size_t inlineCount = fieldCount < inlineFieldCapacity ? fieldCount : inlineFieldCapacity;
+    std::copy(other.inlineFields, other.inlineFields + inlineCount, inlineFields);
+}
+
+void Message::clearLayout(bool known) {
+    fieldCount = 0;
+    overflowFields.clear();
+    layoutKnown = known;
+}
+
+uint64_t Message::readVarint() const {
+    uint64_t value = 0;
+    size_t consumed = 0;
+    try {
+        consumed = decodeVarint(storage + readPos, length - readPos, value);
+    } catch (const std::runtime_error&) {
+        throw DeserializationFailedException("Invalid varint");
+    }
+    if (consumed == 0) {
+        throw DeserializationFailedException("Not enough data to read");
+    }
+    readPos += consumed;
+    return value;
+}
+
+void Message::resize(size_t newLength) {
+    if (newLength > capacity) {
+        length = 0; // No hace falta conservar el contenido anterior
+        reserve(newLength);
+    }
+    length = newLength;
+}
+
+void Message::releaseStorage() {
+    if (storage != inlineBuffer) {
+        releaseBlock(storage, capacity);
+        storage = inlineBuffer;
+        capacity = inlineCapacity;
+    }
+}
+
 Message::DeserializationFailedException::DeserializationFailedException(const std::string& msg)
 : std::runtime_error("Message: " + msg + ".") {}
 
@@ -57,9 +328,7 @@ template <>
 Message& Message::operator<<(const std::string& data) {
     size_t size = data.size();
     *this << size;
-    size_t oldSize = buffer.size();
-    buffer.resize(oldSize + size);
-    std::memcpy(&buffer[oldSize], data.data(), size);
+    append(data.data(), size);
     return *this;
 }
 
@@ -67,10 +336,10 @@ template <>
 Message& Message::operator>>(std::string& data) {
     size_t size;
     *this >> size;
-    if (readPos + size > buffer.size()) {
+    if (readPos + size > length) {
         throw DeserializationFailedException("Not enough data to read string");
     }
-    data.assign(&buffer[readPos], size);
+    data.assign(storage + readPos, size);
     readPos += size;
     return *this;
 }
@@ -79,10 +348,10 @@ template <>
 const Message& Message::operator>>(std::string& data) const {
     size_t size;
     *this >> size;
-    if (readPos + size > buffer.size()) {
+    if (readPos + size > length) {
         throw DeserializationFailedException("Not enough data to read string");
     }
-    data.assign(&buffer[readPos], size);
+    data.assign(storage + readPos, size);
     readPos += size;
     return *this;
-}
\ No newline at end of file
+}
@@ -0,0 +1,93 @@
+#include "network/metrics.hpp"
+
+namespace {
+    size_t bucketOf(uint64_t microseconds) {
+        size_t bucket = 0;
+        while (microseconds > 0 && bucket + 1 < LatencyHistogram::bucketCount) {
+            microseconds >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+}
+
+/* LatencyHistogram */
+
+LatencyHistogram::Snapshot::Snapshot()
+: count(0), totalNanoseconds(0), buckets() {}
+
+double LatencyHistogram::Snapshot::meanMicroseconds() const {
+    return count == 0 ? 0.0 : static_cast<double>(totalNanoseconds) / 1000.0 / static_cast<double>(count);
+}
+
+uint64_t LatencyHistogram::Snapshot::percentileMicroseconds(double q) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(q * static_cast<double>(count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; ++i) {
+        seen += buckets[i];
+        if (seen > target) {
+            return static_cast<uint64_t>(1) << i;
+        }
+    }
+    return static_cast<uint64_t>(1) << (bucketCount - 1);
+}
+
+LatencyHistogram::LatencyHistogram()
+: count(0), totalNanoseconds(0) {
+    for (size_t i = 0; i < bucketCount; ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration) {
+    uint64_t nanoseconds = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+    buckets[bucketOf(nanoseconds / 1000)].fetch_add(1, std::memory_order_relaxed);
+    totalNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    for (size_t i = 0; i < bucketCount; ++i) {
+        result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+    result.totalNanoseconds = totalNanoseconds.load(std::memory_order_relaxed);
+    return result;
+}
+
+/* TrafficCounters */
+
+TrafficCounters::TrafficCounters()
+: bytesIn(0), bytesOut(0), messagesIn(0), messagesOut(0), sendCalls(0),
+  queuedMessages(0), queuedBytes(0), messagesShed(0), readPauses(0) {}
+
+ConnectionMetrics::ConnectionMetrics(long long clientID, const TrafficCounters& counters)
+: clientID(clientID),
+  bytesIn(counters.bytesIn.load(std::memory_order_relaxed)),
+  bytesOut(counters.bytesOut.load(std::memory_order_relaxed)),
+  messagesIn(counters.messagesIn.load(std::memory_order_relaxed)),
+  messagesOut(counters.messagesOut.load(std::memory_order_relaxed)),
+  sendCalls(counters.sendCalls.load(std::memory_order_relaxed)),
+  queuedMessages(counters.queuedMessages.load(std::memory_order_relaxed)),
+  queuedBytes(counters.queuedBytes.load(std::memory_order_relaxed)),
+  messagesShed(counters.messagesShed.load(std::memory_order_relaxed)),
+  readPauses(counters.readPauses.load(std::memory_order_relaxed)) {}
+
+/* NetworkMetrics */
+
+NetworkMetrics::NetworkMetrics()
+: takenAt(std::chrono::steady_clock::now()), accepted(0), closed(0), acceptFailures(0), bytesIn(0),
+  bytesOut(0), messagesIn(0), messagesOut(0), sendCalls(0), messagesShed(0), readPauses(0),
+  ioSyscalls(0), pendingMessages(0), pendingBytes(0) {}
+
+double NetworkMetrics::acceptRate(const NetworkMetrics& previous) const {
+    std::chrono::duration<double> elapsed = takenAt - previous.takenAt;
+    if (elapsed.count() <= 0.0 || accepted < previous.accepted) {
+        return 0.0;
+    }
+    return static_cast<double>(accepted - previous.accepted) / elapsed.count();
+}
@@ -1,97 +1,491 @@
 #include "network/server.hpp"
+#include "network/unix_socket.hpp"
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <fcntl.h>
-#include <sys/select.h>
 #include <cstring>
 #include <errno.h>
 #include <iostream>
+#include <algorithm>
+#include <limits>
 
-Server::Server()
-: serverSocket(-1), isRunning(false), shouldStop(false), nextClientID(1) {}
+namespace {
+    // Tokens de epoll que no corresponden a ningun ClientID (los IDs empiezan en 1)
+    const Server::ClientID listenerToken = 0;
+    const Server::ClientID wakeToken = -1;
+    // Los listeners de addEndpoint usan -2, -3, ...
+    const Server::ClientID firstEndpointToken = -2;
+    // Por debajo de cualquier endpoint, y cabe en los 56 bits de ringData
+    const Server::ClientID datagramToken = -(1LL << 55);
+    // timerfd de SendCoalescing::maxDelay
+    const Server::ClientID flushTimerToken = datagramToken + 1;
+
+    const int maxEvents = 64;
+    const size_t timerSlots = 512;
+    // Espera antes de reintentar un accept que fallo por falta de recursos
+    const std::chrono::milliseconds acceptRetryDelay(100);
+
+    // io_uring por shard: SQEs, buffers provistos para recv e iovecs por sendmsg
+    const unsigned ringEntries = 256;
+    const unsigned ringBufferCount = 256;
+    const size_t ringBufferSize = 16 * 1024;
+    const size_t ringSendIovecs = 64;
+
+    // user_data de io_uring: operacion en el byte alto, token (con signo) en el resto
+    enum RingOp {
+        OpIgnore = 0,   // Cancelaciones y close
+        OpPoll = 1,
+        OpAccept = 2,
+        OpReceive = 3,
+        OpSend = 4
+    };
+
+    uint64_t ringData(RingOp op, Server::ClientID token) {
+        return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(token) & ((1ULL << 56) - 1));
+    }
+
+    RingOp ringOp(uint64_t data) {
+        return static_cast<RingOp>(data >> 56);
+    }
+
+    Server::ClientID ringToken(uint64_t data) {
+        return static_cast<Server::ClientID>(data << 8) >> 8;
+    }
+
+    // SendBatch mas interno abierto en este hilo (de cualquier Server)
+    thread_local Server::SendBatch* activeBatch = NULL;
+
+    // Cada contador de trafico tiene un solo escritor (el event loop): basta
+    // con load + store, sin la instruccion atomica de lectura-modificacion
+    void bump(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void bump(std::atomic<uint64_t> TrafficCounters::* counter, TrafficCounters& total,
+              TrafficCounters& connection, uint64_t value) {
+        if (value > 0) {
+            bump(total.*counter, value);
+            bump(connection.*counter, value);
+        }
+    }
+
+    void publishQueue(TrafficCounters& counters, size_t frames, size_t bytes) {
+        counters.queuedMessages.store(frames, std::memory_order_relaxed);
+        counters.queuedBytes.store(bytes, std::memory_order_relaxed);
+    }
+
+    bool addToEpoll(int epollFd, int fd, uint32_t events, Server::ClientID token) {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = static_cast<uint64_t>(token);
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+}
+
+Server::Shard::Shard(size_t index)
+: index(index), listenFd(-1), epollFd(-1), wakeFd(-1), nextSequence(1), syscalls(0),
+  heldBytes(0), wakePending(false), flushArmed(false), flushUrgent(false), flushTimerFd(-1), flushSignals(0), accepted(0), closed(0),
+  acceptFailures(0), spareFd(-1),
+  publishedCounters(std::make_shared<const CounterList>()), countersChanged(false) {}
+
+Server::Connection::Connection()
+: fd(-1), isShm(false), isLocal(false), helloAcknowledged(false), readPaused(false), recvArmed(false), recvCancelled(false),
+  sendInFlight(false) {}
+
+Server::Inbound::Inbound(ClientID clientID, Message&& message, RequestID requestID, StreamID streamID)
+: clientID(clientID), message(std::move(message)), requestID(requestID), streamID(streamID) {}
+
+Server::Outbox::Outbox()
+: queuedBytes(0), format(WireFormat::Legacy), streams(false), congested(false), overflowed(false) {}
+
+Server::Server(size_t eventLoopCount)
+: isRunning(false), shouldStop(false), actions(std::make_shared<const ActionTable>()),
+  waitForDispatchCompletion(true), messagesInFlight(0),
+  supportedWireFeatures(WireFeatureCompact | WireFeatureFragments | WireFeatureCompression | WireFeatureDatagrams
+                        | WireFeatureStreams),
+  datagramsEnabled(false), tokenGenerator(std::random_device()()),
+  inboundLimited(false), pendingInboundMessages(0), pendingInboundBytes(0), pendingStreamBytes(0),
+  inboundSaturated(false),
+  requestedBackend(IoBackend::Epoll), activeBackend(IoBackend::Epoll), nextStreamID(1),
+  compressionThreshold(defaultCompressionThreshold) {
+    if (eventLoopCount == 0) {
+        eventLoopCount = 1;
+    }
+    for (size_t i = 0; i < eventLoopCount; ++i) {
+        shards.push_back(std::unique_ptr<Shard>(new Shard(i)));
+    }
+}
 
 Server::~Server() {
+    // Sin relanzar: una excepcion de un handler aqui terminaria el programa
+    finishDispatch();
+    dispatchPool.reset();
+    stopShards();
+}
+
+void Server::stopShards() {
     shouldStop = true;
     isRunning = false;
-    
-    if (acceptorThread.joinable()) {
-        acceptorThread.join();
+
+    for (auto& shard : shards) {
+        if (shard->thread.joinable()) {
+            wakeUp(*shard);
+            shard->thread.join();
+        }
     }
-    
-    std::lock_guard<std::mutex> lock(mutex);
-    for (auto& client : clients) {
-        close(client.second);
+
+    for (auto& shard : shards) {
+        if (shard->ring) {
+            shard->ring->submit(); // Los close que dejo closeConnection
+            shard->ring.reset();
+        }
+        shard->retiredWriters.clear();
+        shard->retiredSends.clear();
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->messagesToSend.clear();
+        }
+        shard->drained.notify_all();
+        shard->pausedReads.clear();
+        for (auto& connection : shard->connections) {
+            close(connection.second.fd);
+        }
+        shard->connections.clear();
+        if (shard->listenFd != -1) {
+            close(shard->listenFd);
+            shard->listenFd = -1;
+        }
+        if (shard->epollFd != -1) {
+            close(shard->epollFd);
+            shard->epollFd = -1;
+        }
+        if (shard->wakeFd != -1) {
+            close(shard->wakeFd);
+            shard->wakeFd = -1;
+        }
+        if (shard->flushTimerFd != -1) {
+            close(shard->flushTimerFd);
+            shard->flushTimerFd = -1;
+        }
+        if (shard->spareFd != -1) {
+            close(shard->spareFd);
+            shard->spareFd = -1;
+        }
+        shard->acceptRetries.clear();
+        shard->heldBytes = 0;
+        shard->wakePending = false;
+        shard->flushArmed = false;
+        shard->flushUrgent = false;
+    }
+
+    datagrams.close();
+    {
+        std::lock_guard<std::mutex> lock(datagramMutex);
+        datagramPeers.clear();
+        datagramTokens.clear();
+        datagramQueue.clear();
+    }
+
+    for (Endpoint& endpoint : endpoints) {
+        if (endpoint.fd == -1) {
+            continue;
+        }
+        close(endpoint.fd);
+        endpoint.fd = -1;
+        if (!endpoint.isShm && endpoint.path[0] != '@') {
+            unlink(endpoint.path.c_str());
+        }
+    }
+}
+
+void Server::addEndpoint(const std::string& address) {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
-    if (serverSocket != -1) {
-        close(serverSocket);
+    Endpoint endpoint;
+    endpoint.address = address;
+    endpoint.fd = -1;
+    endpoint.isShm = ShmChannel::parseAddress(address, endpoint.path);
+    if (!endpoint.isShm && !parseUnixAddress(address, endpoint.path)) {
+        throw StartFailedException("Unsupported endpoint address: " + address);
     }
+    endpoints.push_back(endpoint);
 }
 
 void Server::start(const size_t& port) {
     if (isRunning) {
         throw AlreadyStartedException();
     }
+    startListeners(true, port);
+}
+
+void Server::start(const std::string& address) {
+    if (isRunning) {
+        throw AlreadyStartedException();
+    }
+    addEndpoint(address);
+    startListeners(false, 0);
+}
 
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket < 0) {
-        throw StartFailedException("Failed to create socket");
+void Server::startListeners(bool listenTcp, size_t port) {
+    // Resolucion de los timers: 1/32 del plazo mas corto
+    std::chrono::milliseconds shortest = timeouts.idleTimeout;
+    if (shortest.count() <= 0 || (timeouts.heartbeatInterval.count() > 0 && timeouts.heartbeatInterval < shortest)) {
+        shortest = timeouts.heartbeatInterval;
     }
+    std::chrono::milliseconds tick = std::max(std::chrono::milliseconds(1), shortest / 32);
 
-    int opt = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        close(serverSocket);
-        throw StartFailedException("Failed to set socket options");
+    activeBackend = IoBackend::Epoll;
+    if (requestedBackend == IoBackend::IoUring && IoRing::available()) {
+        try {
+            for (auto& shard : shards) {
+                shard->ring.reset(new IoRing(ringEntries, ringBufferCount, ringBufferSize));
+            }
+            activeBackend = IoBackend::IoUring;
+        } catch (const IoRing::IoRingFailedException&) {
+            for (auto& shard : shards) {
+                shard->ring.reset(); // Todos los shards con epoll
+            }
+        }
     }
 
-    sockaddr_in serverAddr{};
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(static_cast<uint16_t>(port));
+    for (auto& shard : shards) {
+        shard->timers = TimingWheel(tick, timerSlots);
+        shard->epollFd = shard->ring ? -1 : epoll_create1(EPOLL_CLOEXEC);
+        shard->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        shard->spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if ((!shard->ring && shard->epollFd < 0) || shard->wakeFd < 0
+            || !watch(*shard, shard->wakeFd, EPOLLIN | EPOLLET, wakeToken)) {
+            stopShards();
+            throw StartFailedException("Failed to create event loop");
+        }
+        if (coalescing.maxDelay.count() > 0) {
+            shard->flushTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+            if (shard->flushTimerFd < 0
+                || !watch(*shard, shard->flushTimerFd, EPOLLIN | EPOLLET, flushTimerToken)) {
+                stopShards();
+                throw StartFailedException("Failed to create event loop");
+            }
+        }
+        if (!listenTcp) {
+            continue;
+        }
+
+        int serverSocket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (serverSocket < 0) {
+            stopShards();
+            throw StartFailedException("Failed to create socket");
+        }
+        shard->listenFd = serverSocket;
+
+        // SO_REUSEPORT: cada shard tiene su listener y el kernel reparte las conexiones
+        int opt = 1;
+        if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0
+            || setsockopt(serverSocket, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0
+            || !applySocketOptions(serverSocket, socketOptions, true)) {
+            stopShards();
+            throw StartFailedException("Failed to set socket options");
+        }
+
+        sockaddr_in serverAddr{};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = INADDR_ANY;
+        serverAddr.sin_port = htons(static_cast<uint16_t>(port));
+
+        if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
+            stopShards();
+            throw StartFailedException("Failed to bind socket");
+        }
+
+        if (listen(serverSocket, socketOptions.backlog) < 0) {
+            stopShards();
+            throw StartFailedException("Failed to listen on socket");
+        }
+
+        if (shard->ring) {
+            // Multishot: una completion por conexion aceptada
+            shard->ring->accept(serverSocket, ringData(OpAccept, listenerToken));
+        } else if (!addToEpoll(shard->epollFd, serverSocket, EPOLLIN | EPOLLET, listenerToken)) {
+            stopShards();
+            throw StartFailedException("Failed to create event loop");
+        }
+    }
 
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) < 0) {
-        close(serverSocket);
-        throw StartFailedException("Failed to bind socket");
+    // Un socket UDP para todo el servidor, atendido por el shard 0
+    if (datagramsEnabled && listenTcp) {
+        if (!datagrams.bind(port)
+            || !watch(*shards[0], datagrams.fd(), EPOLLIN | EPOLLET, datagramToken)) {
+            stopShards();
+            throw StartFailedException("Failed to open datagram socket");
+        }
     }
 
-    if (listen(serverSocket, 10) < 0) {
-        close(serverSocket);
-        throw StartFailedException("Failed to listen on socket");
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        Endpoint& endpoint = endpoints[i];
+        endpoint.fd = endpoint.isShm ? ShmChannel::listenSocket(endpoint.path, socketOptions.backlog)
+                                     : listenUnixSocket(endpoint.path, SOCK_STREAM, socketOptions.backlog);
+        if (endpoint.fd < 0) {
+            stopShards();
+            throw StartFailedException("Failed to listen on " + endpoint.address);
+        }
+
+        // Un listener para todos los shards: EPOLLEXCLUSIVE despierta solo a uno
+        ClientID token = firstEndpointToken - static_cast<ClientID>(i);
+        for (auto& shard : shards) {
+            if (!watch(*shard, endpoint.fd, EPOLLIN | EPOLLET | EPOLLEXCLUSIVE, token)) {
+                stopShards();
+                throw StartFailedException("Failed to create event loop");
+            }
+        }
     }
 
+    shouldStop = false;
     isRunning = true;
-    acceptorThread = std::thread(&Server::acceptorLoop, this);
+    for (auto& shard : shards) {
+        shard->thread = std::thread(&Server::eventLoop, this, std::ref(*shard));
+    }
 }
 
 void Server::defineAction(const Message::Type& messageType, const Action& action) {
+    editActions([&](ActionTable& table) {
+        if (action) {
+            table.actions.define(messageType, action);
+            table.track(messageType);
+        } else {
+            table.actions.remove(messageType);
+        }
+    });
+}
+
+void Server::defineRequestAction(const Message::Type& messageType, const RequestAction& action) {
+    editActions([&](ActionTable& table) {
+        table.requestActions[messageType] = action;
+        table.track(messageType);
+    });
+}
+
+void Server::defineStreamAction(const Message::Type& messageType, const StreamAction& action) {
+    editActions([&](ActionTable& table) {
+        table.streamActions[messageType] = action;
+    });
+}
+
+void Server::ActionTable::track(Message::Type type) {
+    if (handlerTimes.find(type) == handlerTimes.end()) {
+        handlerTimes[type] = std::make_shared<LatencyHistogram>();
+    }
+}
+
+void Server::editActions(const std::function<void(ActionTable&)>& edit) {
+    // Copy-on-write: los update() en curso siguen con la tabla anterior
     std::lock_guard<std::mutex> lock(mutex);
-    actions[messageType] = action;
+    std::shared_ptr<ActionTable> table = std::make_shared<ActionTable>(*actions);
+    edit(*table);
+    actions = table;
 }
 
-void Server::sendTo(const Message& message, ClientID clientID) {
+void Server::sendTo(const Message& message, ClientID clientID, SendPriority priority) {
     if (!isRunning) {
         throw NotStartedException();
     }
+    sendFrame(makeFrame(message, 0, 0, priority), clientID);
+}
 
-    std::lock_guard<std::mutex> lock(mutex);
-    if (clients.find(clientID) == clients.end()) {
+Server::StreamID Server::sendStream(ClientID clientID, Message::Type type, const std::shared_ptr<StreamSource>& source,
+                                   SendPriority priority) {
+    if (!isRunning) {
+        throw NotStartedException();
+    }
+    if (clientID <= 0) {
+        throw UnknownClientException();
+    }
+
+    StreamID streamID = nextStreamID++;
+    FrameHandle frame = makeStreamFrame(type, streamID, source, priority);
+    Shard& shard = shardOf(clientID);
+    EventList events;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        auto it = shard.messagesToSend.find(clientID);
+        if (it == shard.messagesToSend.end()) {
+            throw UnknownClientException();
+        }
+        if (!it->second.streams) {
+            throw StreamsUnavailableException();
+        }
+        if (!enqueueFrame(shard, lock, clientID, frame, events)) {
+            throw UnknownClientException();
+        }
+    }
+    requestFlush(shard);
+    notifyBackpressure(shard, events);
+    return streamID;
+}
+
+Server::StreamID Server::sendFile(ClientID clientID, Message::Type type, const std::string& path,
+                                 SendPriority priority) {
+    return sendStream(clientID, type, StreamSource::open(path), priority);
+}
+
+void Server::sendFrame(const FrameHandle& frame, ClientID clientID) {
+    if (clientID <= 0) {
         throw UnknownClientException();
     }
-    messagesToSend[clientID].push(message);
+
+    Shard& shard = shardOf(clientID);
+    EventList events;
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        if (!enqueueFrame(shard, lock, clientID, frame, events)) {
+            throw UnknownClientException();
+        }
+    }
+    requestFlush(shard);
+    notifyBackpressure(shard, events);
 }
 
-void Server::sendToArray(const Message& message, std::vector<ClientID> clientIDs) {
+void Server::sendToArray(const Message& message, const std::vector<ClientID>& clientIDs, SendPriority priority) {
     if (!isRunning) {
         throw NotStartedException();
     }
 
+    // Un unico frame compartido y un solo lock por shard
+    FrameHandle frame = makeFrame(message, 0, 0, priority);
+    std::vector<std::vector<ClientID>> byShard(shards.size());
     bool error = false;
     for (ClientID clientID : clientIDs) {
-        try {
-            sendTo(message, clientID);
-        } catch (const UnknownClientException&) {
+        if (clientID <= 0) {
             error = true;
+            continue;
+        }
+        byShard[shardIndexOf(clientID)].push_back(clientID);
+    }
+
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (byShard[i].empty()) {
+            continue;
+        }
+        Shard& shard = *shards[i];
+        EventList events;
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            for (ClientID clientID : byShard[i]) {
+                try {
+                    if (!enqueueFrame(shard, lock, clientID, frame, events)) {
+                        error = true;
+                    }
+                } catch (const SendingFailedException&) {
+                    error = true;
+                }
+            }
         }
+        requestFlush(shard);
+        notifyBackpressure(shard, events);
     }
 
     if (error) {
@@ -99,20 +493,34 @@ void Server::sendToArray(const Message& message, std::vector<ClientID> clientIDs
     }
 }
 
-void Server::sendToAll(const Message& message) {
+void Server::sendToAll(const Message& message, SendPriority priority) {
     if (!isRunning) {
         throw NotStartedException();
     }
 
-    std::lock_guard<std::mutex> lock(mutex);
+    // Serializar una sola vez: cada cliente solo recibe un handle al frame
+    FrameHandle frame = makeFrame(message, 0, 0, priority);
     bool error = false;
-    
-    for (auto& client : clients) {
-        try {
-            messagesToSend[client.first].push(message);
-        } catch (...) {
-            error = true;
+    for (auto& shard : shards) {
+        EventList events;
+        {
+            std::unique_lock<std::mutex> lock(shard->mutex);
+            // Copia de los IDs: con OverflowPolicy::Block el lock se suelta durante la espera
+            std::vector<ClientID> recipients;
+            recipients.reserve(shard->messagesToSend.size());
+            for (auto& entry : shard->messagesToSend) {
+                recipients.push_back(entry.first);
+            }
+            for (ClientID clientID : recipients) {
+                try {
+                    enqueueFrame(*shard, lock, clientID, frame, events);
+                } catch (const SendingFailedException&) {
+                    error = true;
+                }
+            }
         }
+        requestFlush(*shard);
+        notifyBackpressure(*shard, events);
     }
 
     if (error) {
@@ -120,173 +528,1547 @@ void Server::sendToAll(const Message& message) {
     }
 }
 
-void Server::update() {
+void Server::sendDatagram(const Message& message, ClientID clientID) {
     if (!isRunning) {
         throw NotStartedException();
     }
-
-    std::vector<std::pair<ClientID, Message>> messagesToProcess;
-    std::unordered_map<Message::Type, Action> currentActions;
+    FrameHandle frame = makeFrame(message);
+    if (!DatagramSocket::fits(*frame)) {
+        throw DatagramTooLargeException();
+    }
 
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        messagesToProcess.swap(receivedMessages);
-        currentActions = actions;
+        std::lock_guard<std::mutex> lock(datagramMutex);
+        auto token = datagramTokens.find(clientID);
+        if (token == datagramTokens.end()) {
+            throw UnknownClientException();
+        }
+        queueDatagram(frame, datagramPeers[token->second]);
+    }
+    wakeUp(*shards[0]);
+}
+
+void Server::sendDatagramToAll(const Message& message) {
+    if (!isRunning) {
+        throw NotStartedException();
+    }
+    FrameHandle frame = makeFrame(message);
+    if (!DatagramSocket::fits(*frame)) {
+        throw DatagramTooLargeException();
     }
 
-    for (auto& pair : messagesToProcess) {
-        ClientID clientID = pair.first;
-        Message& msg = pair.second;
-        
-        auto it = currentActions.find(msg.type());
-        if (it != currentActions.end() && it->second) {
-            it->second(clientID, msg);
+    {
+        std::lock_guard<std::mutex> lock(datagramMutex);
+        for (auto& entry : datagramPeers) {
+            queueDatagram(frame, entry.second);
         }
     }
+    wakeUp(*shards[0]);
 }
 
-void Server::acceptorLoop() {
-    while (isRunning && !shouldStop) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(serverSocket, &readfds);
-
-        timeval timeout;
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
-
-        int activity = select(serverSocket + 1, &readfds, NULL, NULL, &timeout);
-        
-        if (activity > 0 && FD_ISSET(serverSocket, &readfds)) {
-            sockaddr_in clientAddr{};
-            socklen_t clientLen = sizeof(clientAddr);
-            int clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientLen);
-            
-            if (clientSocket >= 0) {
-                ClientID clientID = nextClientID++;
-                std::lock_guard<std::mutex> lock(mutex);
-                clients[clientID] = clientSocket;
-                messagesToSend[clientID] = std::queue<Message>();
-                std::thread(&Server::handleClient, this, clientID, clientSocket).detach();
-            }
-        }
-
-        // Handle sending pending messages
-        std::lock_guard<std::mutex> lock(mutex);
-        for (auto it = messagesToSend.begin(); it != messagesToSend.end(); ) {
-            ClientID clientID = it->first;
-            if (clients.find(clientID) == clients.end()) {
-                it = messagesToSend.erase(it);
-                continue;
-            }
+void Server::setSendQueueLimits(const SendQueueLimits& limits) {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->limits = limits;
+    }
+}
 
-            while (!it->second.empty()) {
-                try {
-                    sendToClient(it->second.front(), clientID);
-                    it->second.pop();
-                } catch (const SendingFailedException&) {
-                    // Remove disconnected client
-                    close(clients[clientID]);
-                    clients.erase(clientID);
-                    messagesToSend.erase(it);
-                    break;
-                }
-            }
-            ++it;
-        }
+void Server::setInboundLimits(const InboundLimits& limits) {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
+    inboundLimits = limits;
+    inboundLimited = limits.messagesPerSecond > 0 || limits.bytesPerSecond > 0
+        || limits.maxPendingMessages != 0 || limits.maxPendingBytes != 0;
 }
 
-void Server::handleClient(ClientID clientID, int clientSocket) {
-    while (isRunning && !shouldStop) {
-        fd_set readfds;
-        FD_ZERO(&readfds);
-        FD_SET(clientSocket, &readfds);
-
-        timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 100000; // 100ms
-
-        int activity = select(clientSocket + 1, &readfds, NULL, NULL, &timeout);
-        
-        if (activity > 0 && FD_ISSET(clientSocket, &readfds)) {
-            // Read message size
-            size_t messageSize;
-            ssize_t bytesRead = ::recv(clientSocket, &messageSize, sizeof(messageSize), MSG_WAITALL);
-            
-            if (bytesRead <= 0) {
-                break; // Client disconnected
-            }
-
-            if (bytesRead == sizeof(messageSize)) {
-                // Read message data
-                std::vector<char> messageData(messageSize);
-                bytesRead = ::recv(clientSocket, messageData.data(), messageSize, MSG_WAITALL);
-                
-                if (bytesRead <= 0 || static_cast<size_t>(bytesRead) != messageSize) {
-                    break; // Client disconnected
-                }
+void Server::setLaneScheduling(const LaneScheduling& scheduling) {
+    if (isRunning) {
+        throw AlreadyStartedException();
+    }
+    laneScheduling = scheduling;
+}
 
-                // Deserialize and queue the message
-                Message msg(0);
-                try {
-                    std::string dataStr(messageData.data(), messageSize);
-                    msg.deserialize(dataStr);
-                    
-                    std::lock_guard<std::mutex> lock(mutex);
-                    receivedMessages.push_back(std::make_pair(clientID, msg));
-                } catch (const std::exception&) {
-                    // Ignore malformed messages
-                }
-            }
-        }
+void Server::enableDatagrams() {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
+    datagramsEnabled = true;
+}
 
-    // Clean up client
-    std::lock_guard<std::mutex> lock(mutex);
-    close(clientSocket);
-    clients.erase(clientID);
-    messagesToSend.erase(clientID);
+void Server::setSocketOptions(const SocketOptions& options) {
+    if (isRunning) {
+        throw AlreadyStartedException();
+    }
+    socketOptions = options;
 }
 
-void Server::sendToClient(const Message& message, ClientID clientID) {
-    auto it = clients.find(clientID);
-    if (it == clients.end()) {
-        throw UnknownClientException();
+void Server::setSendCoalescing(const SendCoalescing& newCoalescing) {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
+    coalescing = newCoalescing;
+}
 
-    std::string serialized = message.serialize();
-    size_t messageSize = serialized.size();
+void Server::setCompressionThreshold(size_t threshold) {
+    if (isRunning) {
+        throw AlreadyStartedException();
+    }
+    compressionThreshold = threshold;
+}
 
-    // Send message size first
-    ssize_t sent = ::send(it->second, &messageSize, sizeof(messageSize), 0);
-    if (sent != sizeof(messageSize)) {
-        throw SendingFailedException();
+void Server::setConnectionTimeouts(const ConnectionTimeouts& newTimeouts) {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
+    timeouts = newTimeouts;
+}
 
-    // Send message data
-    sent = ::send(it->second, serialized.data(), messageSize, 0);
-    if (sent != static_cast<ssize_t>(messageSize)) {
-        throw SendingFailedException();
+void Server::setIoBackend(IoBackend backend) {
+    if (isRunning) {
+        throw AlreadyStartedException();
     }
+    requestedBackend = backend;
 }
 
-const char* Server::AlreadyStartedException::what() const noexcept {
-    return "Server: Already started.";
+Server::IoBackend Server::ioBackend() const {
+    return activeBackend;
 }
 
-const char* Server::NotStartedException::what() const noexcept {
-    return "Server: Not started.";
+void Server::setReapCallback(const ReapCallback& callback) {
+    if (isRunning) {
+        throw AlreadyStartedException();
+    }
+    reapCallback = callback;
 }
 
-Server::StartFailedException::StartFailedException(const std::string& msg)
-: std::runtime_error("Server: " + msg + ".") {}
+NetworkMetrics Server::metrics() {
+    NetworkMetrics result;
+    for (auto& shard : shards) {
+        const TrafficCounters& totals = shard->totals;
+        result.accepted += shard->accepted.load(std::memory_order_relaxed);
+        result.closed += shard->closed.load(std::memory_order_relaxed);
+        result.acceptFailures += shard->acceptFailures.load(std::memory_order_relaxed);
+        result.bytesIn += totals.bytesIn.load(std::memory_order_relaxed);
+        result.bytesOut += totals.bytesOut.load(std::memory_order_relaxed);
+        result.messagesIn += totals.messagesIn.load(std::memory_order_relaxed);
+        result.messagesOut += totals.messagesOut.load(std::memory_order_relaxed);
+        result.sendCalls += totals.sendCalls.load(std::memory_order_relaxed);
+        result.messagesShed += totals.messagesShed.load(std::memory_order_relaxed);
+        result.readPauses += totals.readPauses.load(std::memory_order_relaxed);
+        result.ioSyscalls += shard->syscalls.load(std::memory_order_relaxed)
+                           + shard->flushSignals.load(std::memory_order_relaxed);
 
-Server::UnknownClientException::UnknownClientException()
-: std::runtime_error("Server: Unknown client.") {}
+        std::shared_ptr<const CounterList> counters = std::atomic_load(&shard->publishedCounters);
+        for (const auto& entry : *counters) {
+            result.connections.push_back(ConnectionMetrics(entry.first, *entry.second));
+        }
+    }
 
-Server::SendingFailedException::SendingFailedException()
-: std::runtime_error("Server: Failed to send message.") {}
+    result.pendingMessages = pendingInboundMessages.load(std::memory_order_relaxed);
+    result.pendingBytes = pendingInboundBytes.load(std::memory_order_relaxed);
 
-Server::BatchSendingFailedException::BatchSendingFailedException()
-: std::runtime_error("Server: Failed to send at least 1 message.") {}
\ No newline at end of file
+    std::shared_ptr<const ActionTable> table = currentActions();
+    for (const auto& entry : table->handlerTimes) {
+        result.handlers[entry.first] = entry.second->snapshot();
+    }
+    return result;
+}
+
+void Server::setBackpressureCallback(const BackpressureCallback& callback) {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->backpressureCallback = callback;
+    }
+}
+
+bool Server::enqueueFrame(Shard& shard, std::unique_lock<std::mutex>& lock, ClientID clientID,
+                          const FrameHandle& original, EventList& events) {
+    auto it = shard.messagesToSend.find(clientID);
+    if (it == shard.messagesToSend.end()) {
+        return false;
+    }
+    // Varint solo a quien negocio WireFeatureCompact. Si luego lo negocia,
+    // el frame en ancho fijo sigue siendo valido
+    FrameHandle frame = frameForFormat(original, it->second.format);
+    if (!frame) {
+        throw SendingFailedException();
+    }
+
+    size_t bytes = frame->size(it->second.format);
+    const SendQueueLimits& limits = shard.limits;
+    // Un frame mayor que maxBytes se acepta igualmente si la cola esta vacia
+    if (limits.maxBytes != 0 && it->second.queuedBytes > 0
+        && it->second.queuedBytes + bytes > limits.maxBytes) {
+        if (limits.policy == OverflowPolicy::Drop) {
+            events.push_back(std::make_pair(clientID, SendQueueEvent::Overflow));
+            return true;
+        }
+        if (limits.policy == OverflowPolicy::Disconnect) {
+            if (!it->second.overflowed) {
+                it->second.overflowed = true;
+                events.push_back(std::make_pair(clientID, SendQueueEvent::Overflow));
+            }
+            return true;
+        }
+
+        // Lo encolado puede estar retenido (SendBatch, maxDelay): sin flush
+        // la cola no bajaria nunca
+        signalFlush(shard);
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + limits.blockTimeout;
+        while (true) {
+            if (shard.drained.wait_until(lock, deadline) == std::cv_status::timeout) {
+                throw SendingFailedException();
+            }
+            it = shard.messagesToSend.find(clientID);
+            if (it == shard.messagesToSend.end()) {
+                return false;
+            }
+            if (it->second.queuedBytes == 0 || it->second.queuedBytes + bytes <= shard.limits.maxBytes) {
+                break;
+            }
+        }
+    }
+
+    it->second.frames.push_back(frame);
+    it->second.queuedBytes += bytes;
+    shard.heldBytes += bytes;
+    publishQueue(*it->second.counters, it->second.frames.size(), it->second.queuedBytes);
+    if (it->second.queuedBytes >= shard.limits.highWatermark) {
+        shard.flushUrgent = true;
+    }
+    if (!it->second.congested && it->second.queuedBytes >= shard.limits.highWatermark) {
+        it->second.congested = true;
+        events.push_back(std::make_pair(clientID, SendQueueEvent::Congested));
+    }
+    return true;
+}
+
+void Server::notifyBackpressure(Shard& shard, const EventList& events) {
+    if (events.empty()) {
+        return;
+    }
+    BackpressureCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        callback = shard.backpressureCallback;
+    }
+    if (!callback) {
+        return;
+    }
+    for (const auto& event : events) {
+        callback(event.first, event.second);
+    }
+}
+
+void Server::update() {
+    if (!isRunning) {
+        throw NotStartedException();
+    }
+
+    std::vector<Inbound> messagesToProcess;
+
+    for (auto& shard : shards) {
+        std::vector<Inbound> shardMessages;
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shardMessages.swap(shard->receivedMessages);
+        }
+        size_t bytes = 0;
+        size_t streamBytes = 0;
+        for (const Inbound& inbound : shardMessages) {
+            bytes += inbound.message.size();
+            if (inbound.streamID != 0) {
+                streamBytes += inbound.message.size();
+            }
+        }
+        pendingInboundMessages -= shardMessages.size();
+        pendingInboundBytes -= bytes;
+        pendingStreamBytes -= streamBytes;
+        if (messagesToProcess.empty()) {
+            messagesToProcess.swap(shardMessages);
+        } else {
+            for (auto& inbound : shardMessages) {
+                messagesToProcess.push_back(std::move(inbound));
+            }
+        }
+    }
+    // Ya hay sitio: que los shards reanuden las lecturas pausadas por el tope global
+    if (inboundSaturated.exchange(false)) {
+        for (auto& shard : shards) {
+            wakeUp(*shard);
+        }
+    }
+
+    if (dispatchPool) {
+        dispatchParallel(messagesToProcess);
+        if (waitForDispatchCompletion) {
+            waitForDispatch();
+        }
+        return;
+    }
+
+    // Las respuestas de todas las acciones salen juntas al terminar
+    SendBatch batch(*this);
+    std::shared_ptr<const ActionTable> table = currentActions();
+    for (Inbound& inbound : messagesToProcess) {
+        dispatch(*table, inbound);
+    }
+}
+
+void Server::setParallelDispatch(size_t workerCount, bool waitForCompletion) {
+    std::exception_ptr error = finishDispatch();
+    dispatchPool.reset();
+    if (workerCount > 0) {
+        dispatchPool.reset(new WorkerPool(workerCount));
+    }
+    waitForDispatchCompletion = waitForCompletion;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void Server::waitForDispatch() {
+    // La primera excepcion de un handler se relanza aqui, como en el modo secuencial
+    std::exception_ptr error = finishDispatch();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::exception_ptr Server::finishDispatch() {
+    std::exception_ptr error;
+    std::unique_lock<std::mutex> lock(dispatchMutex);
+    dispatchDone.wait(lock, [this] { return messagesInFlight == 0; });
+    std::swap(error, dispatchError);
+    return error;
+}
+
+std::shared_ptr<const Server::ActionTable> Server::currentActions() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return actions;
+}
+
+void Server::dispatch(const ActionTable& table, Inbound& inbound) {
+    if (inbound.streamID != 0) {
+        auto stream = table.streamActions.find(inbound.message.type());
+        if (stream != table.streamActions.end() && stream->second) {
+            stream->second(inbound.clientID, StreamChunk(inbound.streamID, inbound.message));
+        }
+        return;
+    }
+    auto timer = table.handlerTimes.find(inbound.message.type());
+    LatencyHistogram* histogram = timer != table.handlerTimes.end() ? timer->second.get() : NULL;
+    std::chrono::steady_clock::time_point started;
+    if (histogram) {
+        started = std::chrono::steady_clock::now();
+    }
+
+    if (inbound.requestID == 0) {
+        try {
+            table.actions.dispatch(inbound.clientID, inbound.message);
+        } catch (...) {
+            if (histogram) {
+                histogram->record(std::chrono::steady_clock::now() - started);
+            }
+            throw;
+        }
+        if (histogram) {
+            histogram->record(std::chrono::steady_clock::now() - started);
+        }
+        return;
+    }
+
+    // Peticion RPC: sin handler tambien se responde, para que el cliente no espere al timeout
+    FrameHandle response;
+    auto it = table.requestActions.find(inbound.message.type());
+    try {
+        if (it == table.requestActions.end() || !it->second) {
+            throw std::runtime_error("No request action for message type "
+                                     + std::to_string(inbound.message.type()));
+        }
+        response = makeFrame(it->second(inbound.clientID, inbound.message), FrameResponse, inbound.requestID);
+    } catch (const std::exception& e) {
+        Message error(inbound.message.type());
+        error << std::string(e.what());
+        response = makeFrame(error, FrameResponse | FrameRemoteError, inbound.requestID);
+    }
+    if (histogram) {
+        histogram->record(std::chrono::steady_clock::now() - started);
+    }
+
+    try {
+        sendFrame(response, inbound.clientID);
+    } catch (const UnknownClientException&) {
+        // El cliente se desconecto mientras se atendia la peticion
+    }
+}
+
+void Server::dispatchParallel(std::vector<Inbound>& messages) {
+    std::vector<ClientID> newStrands;
+    {
+        std::lock_guard<std::mutex> lock(dispatchMutex);
+        for (Inbound& inbound : messages) {
+            auto it = strands.find(inbound.clientID);
+            if (it == strands.end()) {
+                // Sin strand activo: habra que lanzar un job para este cliente
+                it = strands.insert(std::make_pair(inbound.clientID, std::deque<Inbound>())).first;
+                newStrands.push_back(inbound.clientID);
+            }
+            it->second.push_back(std::move(inbound));
+        }
+        messagesInFlight += messages.size();
+    }
+
+    for (ClientID clientID : newStrands) {
+        dispatchPool->addJob([this, clientID] { runStrand(clientID); });
+    }
+}
+
+void Server::runStrand(ClientID clientID) {
+    // Un solo job por cliente a la vez: garantiza el orden de sus mensajes
+    while (true) {
+        std::deque<Inbound> batch;
+        {
+            std::lock_guard<std::mutex> lock(dispatchMutex);
+            auto it = strands.find(clientID);
+            if (it->second.empty()) {
+                strands.erase(it);
+                return;
+            }
+            batch.swap(it->second);
+        }
+
+        std::shared_ptr<const ActionTable> table = currentActions();
+        for (Inbound& inbound : batch) {
+            try {
+                dispatch(*table, inbound);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(dispatchMutex);
+                if (!dispatchError) {
+                    dispatchError = std::current_exception();
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(dispatchMutex);
+            messagesInFlight -= batch.size();
+        }
+        dispatchDone.notify_all();
+    }
+}
+
+Server::Shard& Server::shardOf(ClientID clientID) {
+    return *shards[shardIndexOf(clientID)];
+}
+
+size_t Server::shardIndexOf(ClientID clientID) const {
+    return static_cast<size_t>(clientID) % shards.size();
+}
+
+void Server::wakeUp(Shard& shard) {
+    uint64_t one = 1;
+    ssize_t ret = ::write(shard.wakeFd, &one, sizeof(one));
+    (void)ret; // EAGAIN solo significa que el contador ya esta activado
+}
+
+void Server::requestFlush(Shard& shard) {
+    // Con una cola por encima de highWatermark no se retiene nada
+    if (shard.heldBytes.load(std::memory_order_relaxed) < coalescing.maxBytes && !shard.flushUrgent) {
+        if (activeBatch && &activeBatch->server == this) {
+            activeBatch->deferred[shard.index] = true;
+            return;
+        }
+        if (shard.flushTimerFd >= 0) {
+            // El primer envio de la tanda arma el timer; los demas se suman
+            if (!shard.flushArmed.exchange(true)) {
+                itimerspec expiry = itimerspec();
+                std::chrono::microseconds delay = coalescing.maxDelay;
+                expiry.it_value.tv_sec = static_cast<time_t>(delay.count() / 1000000);
+                expiry.it_value.tv_nsec = static_cast<long>(delay.count() % 1000000) * 1000;
+                timerfd_settime(shard.flushTimerFd, 0, &expiry, NULL);
+                shard.flushSignals.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+    }
+    signalFlush(shard);
+}
+
+void Server::signalFlush(Shard& shard) {
+    // El event loop baja wakePending antes de tomar los frames: si sigue
+    // activo, los encolados hasta ahora ya saldran en ese flush
+    if (!shard.wakePending.exchange(true)) {
+        wakeUp(shard);
+        shard.flushSignals.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Server::eventLoop(Shard& shard) {
+    if (shard.ring) {
+        eventLoopRing(shard);
+        return;
+    }
+    epoll_event events[maxEvents];
+
+    while (isRunning && !shouldStop) {
+        int count = epoll_wait(shard.epollFd, events, maxEvents, loopTimeoutMs(shard));
+        bump(shard.syscalls, 1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (!shard.timers.empty()) {
+            checkTimeouts(shard);
+        }
+        resumeReads(shard, false);
+        if (!shard.acceptRetries.empty()) {
+            retryAccepts(shard);
+        }
+
+        for (int i = 0; i < count; ++i) {
+            handleEvent(shard, static_cast<ClientID>(events[i].data.u64), events[i].events);
+        }
+
+        if (shard.countersChanged) {
+            publishCounters(shard);
+        }
+    }
+}
+
+void Server::eventLoopRing(Shard& shard) {
+    struct io_uring_cqe completions[maxEvents];
+
+    while (isRunning && !shouldStop) {
+        uint64_t entersBefore = shard.ring->enters();
+        // Una syscall: envia lo preparado en la vuelta anterior y espera completions
+        shard.ring->enter(loopTimeoutMs(shard));
+        if (!shard.timers.empty()) {
+            checkTimeouts(shard);
+        }
+        resumeReads(shard, false);
+        if (!shard.acceptRetries.empty()) {
+            retryAccepts(shard);
+        }
+
+        size_t count;
+        while ((count = shard.ring->reap(completions, maxEvents)) > 0) {
+            for (size_t i = 0; i < count; ++i) {
+                handleCompletion(shard, completions[i]);
+            }
+        }
+        bump(shard.syscalls, shard.ring->enters() - entersBefore);
+
+        if (shard.countersChanged) {
+            publishCounters(shard);
+        }
+    }
+}
+
+int Server::loopTimeoutMs(Shard& shard) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int timeout = shard.timers.timeoutMs(now);
+    int paused = pausedTimeoutMs(shard, now);
+    if (paused >= 0 && (timeout < 0 || paused < timeout)) {
+        timeout = paused;
+    }
+    if (!shard.acceptRetries.empty()) {
+        int retry = 0;
+        if (shard.acceptRetryAt > now) {
+            retry = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                shard.acceptRetryAt - now + std::chrono::milliseconds(1) - std::chrono::steady_clock::duration(1)).count());
+        }
+        if (timeout < 0 || retry < timeout) {
+            timeout = retry;
+        }
+    }
+    return timeout;
+}
+
+void Server::handleEvent(Shard& shard, ClientID token, uint32_t events) {
+    if (token == listenerToken) {
+        acceptClients(shard, listenerToken);
+    } else if (token == wakeToken) {
+        uint64_t value;
+        ssize_t ret;
+        do {
+            ret = ::read(shard.wakeFd, &value, sizeof(value));
+            bump(shard.syscalls, 1);
+        } while (ret > 0);
+        // Despues de vaciar el eventfd: un signalFlush posterior vuelve a
+        // escribir y genera otro evento, en vez de perderse en la lectura
+        shard.wakePending = false;
+        resumeReads(shard, true);
+        flushPendingMessages(shard);
+        if (shard.index == 0 && datagramsEnabled) {
+            flushDatagrams();
+        }
+    } else if (token == datagramToken) {
+        receiveDatagrams();
+    } else if (token == flushTimerToken) {
+        shard.flushArmed = false;
+        uint64_t expirations;
+        ssize_t ret = ::read(shard.flushTimerFd, &expirations, sizeof(expirations));
+        (void)ret;
+        bump(shard.syscalls, 1);
+        flushPendingMessages(shard);
+    } else if (token <= firstEndpointToken) {
+        acceptClients(shard, token);
+    } else {
+        auto it = shard.connections.find(token);
+        if (it == shard.connections.end()) {
+            return;
+        }
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR | EPOLLRDHUP)) {
+            readFromClient(shard, token, it->second, events);
+            it = shard.connections.find(token);
+            if (it == shard.connections.end()) {
+                return;
+            }
+        }
+        if ((events & EPOLLOUT) && !flushConnection(shard, token, it->second)) {
+            closeConnection(shard, token);
+        }
+    }
+}
+
+void Server::handleCompletion(Shard& shard, const struct io_uring_cqe& cqe) {
+    ClientID token = ringToken(cqe.user_data);
+    // Sin F_MORE la peticion multishot termino y hay que volver a armarla
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+
+    switch (ringOp(cqe.user_data)) {
+    case OpAccept:
+        if (cqe.res >= 0) {
+            addConnection(shard, cqe.res, false, false);
+        } else if (cqe.res != -ECANCELED && cqe.res != -EINTR && cqe.res != -ECONNABORTED) {
+            bump(shard.acceptFailures, 1);
+            // Volver a armar ya solo si se pudo descartar la conexion pendiente:
+            // si no, el accept fallaria otra vez en la siguiente vuelta
+            if (!more && !shouldStop
+                && !((cqe.res == -EMFILE || cqe.res == -ENFILE) && shedPendingAccept(shard, shard.listenFd))) {
+                deferAccept(shard, listenerToken);
+                break;
+            }
+        }
+        if (!more && !shouldStop) {
+            shard.ring->accept(shard.listenFd, cqe.user_data);
+        }
+        break;
+    case OpReceive:
+        completeReceive(shard, token, cqe);
+        break;
+    case OpSend:
+        completeSend(shard, token, cqe.res);
+        break;
+    case OpPoll:
+        if (cqe.res > 0) {
+            handleEvent(shard, token, static_cast<uint32_t>(cqe.res));
+        }
+        if (more || cqe.res == -ECANCELED || shouldStop) {
+            break;
+        }
+        if (token == wakeToken) {
+            shard.ring->poll(shard.wakeFd, POLLIN, cqe.user_data);
+        } else if (token == datagramToken) {
+            shard.ring->poll(datagrams.fd(), POLLIN, cqe.user_data);
+        } else if (token == flushTimerToken) {
+            shard.ring->poll(shard.flushTimerFd, POLLIN, cqe.user_data);
+        } else if (token <= firstEndpointToken) {
+            shard.ring->poll(endpoints[static_cast<size_t>(firstEndpointToken - token)].fd, POLLIN, cqe.user_data);
+        } else {
+            // Conexion shm: sus dos polls comparten user_data y no se sabe cual termino
+            closeConnection(shard, token);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool Server::watch(Shard& shard, int fd, uint32_t events, ClientID token) {
+    if (shard.ring) {
+        // Poll multishot: una completion por cada evento nuevo, como EPOLLET
+        shard.ring->poll(fd, events & ~static_cast<uint32_t>(EPOLLET | EPOLLEXCLUSIVE), ringData(OpPoll, token));
+        return true;
+    }
+    return addToEpoll(shard.epollFd, fd, events, token);
+}
+
+uint64_t Server::openDatagramSession(ClientID clientID) {
+    std::lock_guard<std::mutex> lock(datagramMutex);
+    uint64_t token;
+    do {
+        token = tokenGenerator();
+    } while (token == 0 || datagramPeers.count(token) != 0);
+
+    DatagramPeer& peer = datagramPeers[token];
+    peer.clientID = clientID;
+    peer.token = token;
+    peer.addressLength = 0;
+    datagramTokens[clientID] = token;
+    return token;
+}
+
+void Server::closeDatagramSession(ClientID clientID) {
+    std::lock_guard<std::mutex> lock(datagramMutex);
+    auto it = datagramTokens.find(clientID);
+    if (it != datagramTokens.end()) {
+        datagramPeers.erase(it->second);
+        datagramTokens.erase(it);
+    }
+}
+
+void Server::queueDatagram(const FrameHandle& frame, DatagramPeer& peer) {
+    if (peer.addressLength == 0) {
+        return; // Aun no sabemos a donde enviarlo
+    }
+    DatagramSocket::Outgoing datagram;
+    datagram.frame = frame;
+    datagram.token = peer.token;
+    datagram.sequence = peer.sequences.next(frame->type());
+    datagram.address = peer.address;
+    datagram.addressLength = peer.addressLength;
+    datagramQueue.push_back(datagram);
+}
+
+void Server::flushDatagrams() {
+    std::vector<DatagramSocket::Outgoing> pending;
+    {
+        std::lock_guard<std::mutex> lock(datagramMutex);
+        pending.swap(datagramQueue);
+    }
+    // Lo que no se pueda enviar ahora se pierde: ya habra un valor mas nuevo
+    datagrams.send(pending);
+}
+
+void Server::receiveDatagrams() {
+    std::vector<DatagramSocket::Incoming> received;
+    datagrams.receive(received);
+    if (received.empty()) {
+        return;
+    }
+
+    std::vector<std::vector<Inbound>> byShard(shards.size());
+    size_t admitted = 0;
+    size_t bytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(datagramMutex);
+        for (DatagramSocket::Incoming& incoming : received) {
+            auto it = datagramPeers.find(incoming.token);
+            if (it == datagramPeers.end()) {
+                continue;
+            }
+            DatagramPeer& peer = it->second;
+            // La direccion del ultimo datagrama valido: sigue al cliente tras un cambio de NAT
+            peer.address = incoming.address;
+            peer.addressLength = incoming.addressLength;
+            if (incoming.flags & FrameControl) {
+                continue; // DatagramHello
+            }
+            if (!peer.sequences.accept(incoming.message.type(), incoming.sequence)) {
+                continue;
+            }
+            // UDP no se puede pausar: sobre el tope global se descarta
+            if (inboundFull(admitted, bytes)) {
+                continue;
+            }
+            ++admitted;
+            bytes += incoming.message.size();
+            byShard[shardIndexOf(peer.clientID)].emplace_back(peer.clientID, std::move(incoming.message), 0);
+        }
+    }
+
+    pendingInboundMessages += admitted;
+    pendingInboundBytes += bytes;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        if (byShard[i].empty()) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(shards[i]->mutex);
+        for (Inbound& inbound : byShard[i]) {
+            shards[i]->receivedMessages.push_back(std::move(inbound));
+        }
+    }
+}
+
+void Server::publishCounters(Shard& shard) {
+    std::shared_ptr<CounterList> list = std::make_shared<CounterList>();
+    list->reserve(shard.connections.size());
+    for (const auto& entry : shard.connections) {
+        list->push_back(std::make_pair(entry.first, entry.second.counters));
+    }
+    std::atomic_store(&shard.publishedCounters, std::shared_ptr<const CounterList>(list));
+    shard.countersChanged = false;
+}
+
+void Server::acceptClients(Shard& shard, ClientID token) {
+    int listenFd = shard.listenFd;
+    bool isShm = false;
+    if (token != listenerToken) {
+        const Endpoint& endpoint = endpoints[static_cast<size_t>(firstEndpointToken - token)];
+        listenFd = endpoint.fd;
+        isShm = endpoint.isShm;
+    }
+
+    // Edge-triggered: aceptar hasta vaciar la cola del listener
+    while (true) {
+        int clientSocket = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        bump(shard.syscalls, 1);
+        if (clientSocket < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return;
+            }
+            bump(shard.acceptFailures, 1);
+            if ((errno == EMFILE || errno == ENFILE) && shedPendingAccept(shard, listenFd)) {
+                continue;
+            }
+            // ENOBUFS/ENOMEM o sin descriptor de reserva: la cola sigue con
+            // conexiones y no habra otro flanco, reintentar desde el loop
+            deferAccept(shard, token);
+            return;
+        }
+        addConnection(shard, clientSocket, isShm, token != listenerToken);
+    }
+}
+
+bool Server::shedPendingAccept(Shard& shard, int listenFd) {
+    // Liberar la reserva, aceptar y cerrar: el par ve el cierre en vez de
+    // quedarse esperando en la cola
+    if (shard.spareFd < 0) {
+        return false;
+    }
+    close(shard.spareFd);
+    int clientSocket = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+    bump(shard.syscalls, 1);
+    if (clientSocket >= 0) {
+        close(clientSocket);
+    }
+    shard.spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return clientSocket >= 0;
+}
+
+void Server::deferAccept(Shard& shard, ClientID token) {
+    if (std::find(shard.acceptRetries.begin(), shard.acceptRetries.end(), token) == shard.acceptRetries.end()) {
+        shard.acceptRetries.push_back(token);
+    }
+    shard.acceptRetryAt = std::chrono::steady_clock::now() + acceptRetryDelay;
+}
+
+void Server::retryAccepts(Shard& shard) {
+    if (std::chrono::steady_clock::now() < shard.acceptRetryAt) {
+        return;
+    }
+    std::vector<ClientID> tokens;
+    tokens.swap(shard.acceptRetries);
+    for (ClientID token : tokens) {
+        if (token == listenerToken && shard.ring) {
+            // El accept multishot termino con el error: volver a armarlo
+            shard.ring->accept(shard.listenFd, ringData(OpAccept, listenerToken));
+        } else {
+            acceptClients(shard, token);
+        }
+    }
+}
+
+void Server::addConnection(Shard& shard, int fd, bool isShm, bool isLocal) {
+    // Con io_uring los sockets de datos no se vigilan: su recv multishot avisa
+    bool ringSocket = shard.ring && !isShm;
+    // En shm los descriptores del anillo llegan despues por este socket (EPOLLIN)
+    uint32_t events = isShm ? EPOLLIN | EPOLLRDHUP | EPOLLET : EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ClientID clientID = static_cast<ClientID>(shard.nextSequence++ * shards.size() + shard.index);
+    if (!ringSocket && !watch(shard, fd, events, clientID)) {
+        close(fd);
+        return;
+    }
+    // Los TCP ya heredaron las opciones del listener; los unix no
+    if (isLocal && !isShm) {
+        applySocketOptions(fd, socketOptions, false);
+    }
+
+    {
+        Connection& connection = shard.connections[clientID];
+        connection.fd = fd;
+        connection.isShm = isShm;
+        connection.isLocal = isLocal;
+        connection.writer.setScheduling(laneScheduling);
+        // sendfile solo si flush() escribe en el socket (ni shm ni io_uring)
+        connection.writer.setSendfile(!isShm && !shard.ring);
+        connection.lastReceived = std::chrono::steady_clock::now();
+        connection.lastSent = connection.lastReceived;
+        connection.counters = std::make_shared<TrafficCounters>();
+        connection.messageBucket = TokenBucket(inboundLimits.messagesPerSecond, inboundLimits.messageBurst);
+        connection.byteBucket = TokenBucket(inboundLimits.bytesPerSecond, inboundLimits.byteBurst);
+        scheduleTimeout(shard, clientID, connection);
+        bump(shard.accepted, 1);
+        shard.countersChanged = true;
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Outbox& outbox = shard.messagesToSend[clientID];
+        outbox = Outbox();
+        outbox.counters = connection.counters;
+    }
+    if (ringSocket) {
+        Connection& connection = shard.connections[clientID];
+        shard.ring->receive(fd, ringData(OpReceive, clientID));
+        connection.recvArmed = true;
+    }
+}
+
+void Server::readFromClient(Shard& shard, ClientID clientID, Connection& connection, uint32_t events) {
+    std::vector<Inbound> parsed;
+    bool disconnected = false;
+    connection.lastReceived = std::chrono::steady_clock::now();
+    uint64_t receivedBefore = connection.reader.receivedBytes();
+
+    if (connection.isShm) {
+        disconnected = !receiveFromShm(shard, clientID, connection, events, parsed);
+    } else if (shard.ring) {
+        disconnected = !receiveFromRing(shard, clientID, connection, parsed);
+    }
+
+    // Edge-triggered: leer hasta EAGAIN, extrayendo los frames completos tras cada recv.
+    // Al pausar, lo no procesado queda en el reader y en el socket hasta resumeReads.
+    while (!connection.isShm && !shard.ring) {
+        if (!drainFrames(shard, clientID, connection, parsed)) {
+            disconnected = true;
+            break;
+        }
+        if (pauseReads(shard, clientID, connection)) {
+            break;
+        }
+
+        ssize_t bytesRead = connection.reader.receive(connection.fd);
+        bump(shard.syscalls, 1);
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (bytesRead <= 0) {
+            disconnected = true;
+            break;
+        }
+        if (!connection.isLocal) {
+            rearmQuickAck(connection.fd, socketOptions);
+        }
+    }
+
+    if (!disconnected && !connection.writer.empty()
+        && !flushConnection(shard, clientID, connection)) {
+        disconnected = true;
+    }
+
+    bump(&TrafficCounters::bytesIn, shard.totals, *connection.counters,
+         connection.reader.receivedBytes() - receivedBefore);
+    bump(&TrafficCounters::messagesIn, shard.totals, *connection.counters, parsed.size());
+
+    if (!parsed.empty()) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& inbound : parsed) {
+            shard.receivedMessages.push_back(std::move(inbound));
+        }
+    }
+
+    if (disconnected) {
+        closeConnection(shard, clientID);
+    }
+}
+
+bool Server::receiveFromShm(Shard& shard, ClientID clientID, Connection& connection, uint32_t events,
+                            std::vector<Inbound>& parsed) {
+    // El cliente no escribe nada mas en el socket de encuentro: cualquier
+    // evento en el, salvo el de los descriptores, es su cierre
+    if (events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) {
+        return false;
+    }
+
+    if (!connection.shm) {
+        int descriptors[ShmChannel::descriptorCount];
+        if (!ShmChannel::receiveDescriptors(connection.fd, descriptors)) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        try {
+            connection.shm = ShmChannel::attach(descriptors);
+        } catch (const ShmChannel::ShmFailedException&) {
+            return false;
+        }
+        // Mismo token que el socket: los eventos del anillo llegan como EPOLLIN
+        if (!watch(shard, connection.shm->eventFd(), EPOLLIN | EPOLLET, clientID)) {
+            return false;
+        }
+    }
+
+    connection.shm->clearEvent();
+    while (true) {
+        if (!drainFrames(shard, clientID, connection, parsed)) {
+            return false;
+        }
+        if (pauseReads(shard, clientID, connection) || !connection.shm->drain(connection.reader)) {
+            return true;
+        }
+    }
+}
+
+bool Server::receiveFromRing(Shard& shard, ClientID clientID, Connection& connection,
+                             std::vector<Inbound>& parsed) {
+    // completeReceive ya dejo en el reader lo recibido
+    if (!drainFrames(shard, clientID, connection, parsed)) {
+        return false;
+    }
+    bool paused = pauseReads(shard, clientID, connection);
+    if (paused && connection.recvArmed && !connection.recvCancelled) {
+        // Lo que siga llegando se queda en el socket hasta resumeReads
+        shard.ring->cancel(ringData(OpReceive, clientID));
+        connection.recvCancelled = true;
+    } else if (!paused && !connection.recvArmed) {
+        shard.ring->receive(connection.fd, ringData(OpReceive, clientID));
+        connection.recvArmed = true;
+    }
+    return true;
+}
+
+void Server::completeReceive(Shard& shard, ClientID clientID, const struct io_uring_cqe& cqe) {
+    auto it = shard.connections.find(clientID);
+    if (it == shard.connections.end()) {
+        shard.ring->recycle(cqe);
+        return;
+    }
+    Connection& connection = it->second;
+    if (!(cqe.flags & IORING_CQE_F_MORE)) {
+        connection.recvArmed = false;
+        connection.recvCancelled = false;
+    }
+
+    if (cqe.res > 0) {
+        connection.reader.feed(shard.ring->buffer(cqe), static_cast<size_t>(cqe.res));
+        shard.ring->recycle(cqe);
+        bump(&TrafficCounters::bytesIn, shard.totals, *connection.counters, static_cast<uint64_t>(cqe.res));
+    } else if (cqe.res == 0 || (cqe.res != -ENOBUFS && cqe.res != -ECANCELED && cqe.res != -EINTR)) {
+        closeConnection(shard, clientID); // Cierre del cliente o error
+        return;
+    }
+    // Sin buffers libres (-ENOBUFS) o cancelado: readFromClient lo vuelve a armar si procede
+    readFromClient(shard, clientID, connection, EPOLLIN);
+}
+
+bool Server::admitMessage(Shard& shard, Connection& connection, const Message& msg, bool& disconnect) {
+    size_t size = msg.size();
+    if (inboundLimited) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (inboundLimits.policy == ShedPolicy::Pause) {
+            // drainFrames no pasa de aqui sin credito: como mucho un mensaje de deuda
+            connection.messageBucket.consume(1, now);
+            connection.byteBucket.consume(size, now);
+        } else {
+            bool full = inboundFull();
+            bool admitted = !full && connection.messageBucket.tryConsume(1, now);
+            if (admitted && !connection.byteBucket.tryConsume(size, now)) {
+                connection.messageBucket.consume(-1, now); // Devolver el token del mensaje
+                admitted = false;
+            }
+            if (!admitted) {
+                bump(&TrafficCounters::messagesShed, shard.totals, *connection.counters, 1);
+                disconnect = inboundLimits.policy == ShedPolicy::Disconnect && !full;
+                return false;
+            }
+        }
+    }
+    pendingInboundMessages.fetch_add(1, std::memory_order_relaxed);
+    pendingInboundBytes.fetch_add(size, std::memory_order_relaxed);
+    return true;
+}
+
+bool Server::readsBlocked(Connection& connection) {
+    if (streamsFull()) {
+        return true;
+    }
+    if (!inboundLimited || inboundLimits.policy != ShedPolicy::Pause) {
+        return false;
+    }
+    if (inboundFull()) {
+        return true;
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    return !connection.messageBucket.available(now) || !connection.byteBucket.available(now);
+}
+
+bool Server::inboundFull(size_t extraMessages, size_t extraBytes) const {
+    return (inboundLimits.maxPendingMessages != 0
+            && pendingInboundMessages + extraMessages >= inboundLimits.maxPendingMessages)
+        || (inboundLimits.maxPendingBytes != 0
+            && pendingInboundBytes + extraBytes >= inboundLimits.maxPendingBytes);
+}
+
+bool Server::streamsFull() const {
+    return inboundLimits.maxPendingStreamBytes != 0
+        && pendingStreamBytes.load(std::memory_order_relaxed) >= inboundLimits.maxPendingStreamBytes;
+}
+
+bool Server::pauseReads(Shard& shard, ClientID clientID, Connection& connection) {
+    if (!readsBlocked(connection)) {
+        connection.readPaused = false;
+        return false;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (inboundFull() || streamsFull()) {
+        // Hasta que update() saque mensajes de la cola y despierte al shard
+        connection.resumeAt = std::chrono::steady_clock::time_point::max();
+        inboundSaturated = true;
+    } else {
+        connection.resumeAt = now + std::max(connection.messageBucket.waitTime(now),
+                                             connection.byteBucket.waitTime(now));
+    }
+
+    if (!connection.readPaused) {
+        connection.readPaused = true;
+        shard.pausedReads.push_back(clientID);
+        bump(&TrafficCounters::readPauses, shard.totals, *connection.counters, 1);
+    }
+    return true;
+}
+
+void Server::resumeReads(Shard& shard, bool woken) {
+    if (shard.pausedReads.empty()) {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::vector<ClientID> paused;
+    paused.swap(shard.pausedReads);
+    for (ClientID clientID : paused) {
+        auto it = shard.connections.find(clientID);
+        if (it == shard.connections.end() || !it->second.readPaused) {
+            continue;
+        }
+        Connection& connection = it->second;
+        bool due = connection.resumeAt == std::chrono::steady_clock::time_point::max()
+            ? woken : now >= connection.resumeAt;
+        if (!due) {
+            shard.pausedReads.push_back(clientID);
+            continue;
+        }
+        // Edge-triggered: epoll no volvera a avisar de lo que ya estaba en el socket
+        connection.readPaused = false;
+        readFromClient(shard, clientID, connection, EPOLLIN);
+    }
+}
+
+int Server::pausedTimeoutMs(const Shard& shard, std::chrono::steady_clock::time_point now) const {
+    int timeout = -1;
+    for (ClientID clientID : shard.pausedReads) {
+        auto it = shard.connections.find(clientID);
+        if (it == shard.connections.end() || !it->second.readPaused
+            || it->second.resumeAt == std::chrono::steady_clock::time_point::max()) {
+            continue;
+        }
+        // Redondear hacia arriba: despertar antes solo volveria a pausar
+        std::chrono::steady_clock::duration left = it->second.resumeAt - now;
+        int ms = 0;
+        if (left > std::chrono::steady_clock::duration::zero()) {
+            ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                left + std::chrono::milliseconds(1) - std::chrono::steady_clock::duration(1)).count());
+        }
+        if (timeout < 0 || ms < timeout) {
+            timeout = ms;
+        }
+    }
+    return timeout;
+}
+
+bool Server::drainFrames(Shard& shard, ClientID clientID, Connection& connection,
+                         std::vector<Inbound>& parsed) {
+    Message msg(0);
+    uint8_t flags = 0;
+    RequestID requestID = 0;
+    bool disconnect = false;
+    // Sin credito (ShedPolicy::Pause) los frames se quedan en el reader
+    while (!readsBlocked(connection)) {
+        try {
+            if (!connection.reader.next(msg, flags, requestID)) {
+                return true;
+            }
+        } catch (const FrameReader::FrameTooLargeException&) {
+            return false;
+        } catch (const std::exception&) {
+            continue; // Ignore malformed messages
+        }
+
+        uint32_t requested = 0;
+        if (parseHello(msg, flags, requested)) {
+            // Un segundo Hello no vuelve a cambiar de formato
+            if (!connection.helloAcknowledged) {
+                acknowledgeHello(shard, clientID, connection, requested);
+            }
+        } else if (flags & FrameControl) {
+            continue; // HeartbeatAck: basta con que cuente como recibido
+        } else if (flags & FrameResponse) {
+            continue; // Los clientes no atienden peticiones
+        } else if (flags & FrameStream) {
+            if (msg.size() == 0 || requestID == 0) {
+                continue; // Sin byte de info o sin ID
+            }
+            // Sin cubos ni descartes: los acota maxPendingStreamBytes en readsBlocked
+            pendingInboundMessages.fetch_add(1, std::memory_order_relaxed);
+            pendingInboundBytes.fetch_add(msg.size(), std::memory_order_relaxed);
+            pendingStreamBytes.fetch_add(msg.size(), std::memory_order_relaxed);
+            parsed.emplace_back(clientID, std::move(msg), 0, requestID);
+        } else if (admitMessage(shard, connection, msg, disconnect)) {
+            parsed.emplace_back(clientID, std::move(msg), (flags & FrameRequest) ? requestID : 0);
+        } else if (disconnect) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Server::acknowledgeHello(Shard& shard, ClientID clientID, Connection& connection, uint32_t requested) {
+    uint32_t accepted = requested & supportedWireFeatures.load();
+    if (datagrams.fd() < 0 || connection.isLocal) {
+        accepted &= ~static_cast<uint32_t>(WireFeatureDatagrams);
+    }
+
+    // El ack sale en el formato anterior; lo que venga detras ya usa el nuevo.
+    // El cliente no envia nada entre el Hello y el ack, asi que el reader
+    // puede cambiar de formato aqui mismo. commit() evita que los carriles
+    // adelanten el ack a frames ya encolados en el formato anterior.
+    connection.writer.commit();
+    Message ack(static_cast<Message::Type>(ControlType::HelloAck));
+    ack << accepted;
+    if (accepted & WireFeatureDatagrams) {
+        ack << openDatagramSession(clientID);
+    }
+    pushControlFrame(shard, clientID, connection, makeFrame(ack, FrameControl, 0, SendPriority::High));
+    WireFormat format = (accepted & WireFeatureCompact) ? WireFormat::Compact : WireFormat::Legacy;
+    connection.writer.setFormat(format);
+    connection.writer.setFragmentation((accepted & WireFeatureFragments) != 0);
+    connection.writer.setCompression((accepted & WireFeatureCompression) ? compressionThreshold : 0);
+    connection.reader.setFormat(format);
+    connection.helloAcknowledged = true;
+    // Ahora tambien cuenta el plazo del Heartbeat
+    scheduleTimeout(shard, clientID, connection);
+
+    // Recalcular los bytes de la cola con el tamaño de frame del nuevo formato
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.messagesToSend.find(clientID);
+    if (it != shard.messagesToSend.end()) {
+        it->second.format = format;
+        it->second.streams = (accepted & WireFeatureStreams) != 0;
+        it->second.queuedBytes = connection.writer.pendingBytes();
+        for (const FrameHandle& frame : it->second.frames) {
+            it->second.queuedBytes += frame->size(format);
+        }
+        publishQueue(*it->second.counters, it->second.frames.size(), it->second.queuedBytes);
+    }
+}
+
+void Server::pushControlFrame(Shard& shard, ClientID clientID, Connection& connection, const FrameHandle& frame) {
+    size_t before = connection.writer.pendingBytes();
+    connection.writer.push(frame);
+    // Contabilizar el frame en la cola para que flushConnection lo descuente bien
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.messagesToSend.find(clientID);
+    if (it != shard.messagesToSend.end()) {
+        it->second.queuedBytes += connection.writer.pendingBytes() - before;
+        publishQueue(*it->second.counters, it->second.frames.size(), it->second.queuedBytes);
+    }
+}
+
+void Server::setSupportedWireFeatures(uint32_t features) {
+    supportedWireFeatures = features;
+}
+
+void Server::flushPendingMessages(Shard& shard) {
+    std::vector<std::pair<ClientID, std::deque<FrameHandle>>> pending;
+    std::vector<ClientID> overflowed;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.heldBytes = 0;
+        shard.flushUrgent = false;
+        for (auto& entry : shard.messagesToSend) {
+            if (entry.second.overflowed) {
+                overflowed.push_back(entry.first);
+            } else if (!entry.second.frames.empty()) {
+                pending.push_back(std::make_pair(entry.first, std::deque<FrameHandle>()));
+                pending.back().second.swap(entry.second.frames);
+                publishQueue(*entry.second.counters, 0, entry.second.queuedBytes);
+            }
+        }
+    }
+
+    // OverflowPolicy::Disconnect: cerrar las conexiones que desbordaron su cola
+    for (ClientID clientID : overflowed) {
+        closeConnection(shard, clientID);
+    }
+
+    for (auto& entry : pending) {
+        auto it = shard.connections.find(entry.first);
+        if (it == shard.connections.end()) {
+            continue;
+        }
+        for (const FrameHandle& frame : entry.second) {
+            it->second.writer.push(frame);
+        }
+        bump(&TrafficCounters::messagesOut, shard.totals, *it->second.counters, entry.second.size());
+        if (!flushConnection(shard, entry.first, it->second)) {
+            closeConnection(shard, entry.first);
+        }
+    }
+}
+
+bool Server::flushConnection(Shard& shard, ClientID clientID, Connection& connection) {
+    if (connection.isShm && !connection.shm) {
+        return true; // Aun sin anillo: los frames esperan en el writer
+    }
+    if (shard.ring && !connection.isShm) {
+        // Un sendmsg en vuelo por conexion; completeSend encadena el siguiente
+        if (!connection.sendInFlight && !connection.writer.empty()) {
+            submitSend(shard, clientID, connection);
+        }
+        return true;
+    }
+    size_t before = connection.writer.pendingBytes();
+    uint64_t streamedBefore = connection.writer.streamedBytes();
+    uint64_t callsBefore = connection.writer.sendCalls();
+    // Con el anillo lleno flush devuelve false, pero no es un error: el
+    // lector avisara por el eventfd cuando libere espacio
+    bool ok = connection.shm ? (connection.shm->flush(connection.writer), true)
+                             : connection.writer.flush(connection.fd);
+    uint64_t calls = connection.writer.sendCalls() - callsBefore;
+    bump(&TrafficCounters::sendCalls, shard.totals, *connection.counters, calls);
+    if (!connection.shm) {
+        bump(shard.syscalls, calls);
+    }
+    releaseSent(shard, clientID, connection, before - connection.writer.pendingBytes(),
+                connection.writer.streamedBytes() - streamedBefore);
+    return ok;
+}
+
+void Server::submitSend(Shard& shard, ClientID clientID, Connection& connection) {
+    if (!connection.ringSend) {
+        connection.ringSend.reset(new RingSend());
+        connection.ringSend->iov.resize(ringSendIovecs);
+    }
+    RingSend& send = *connection.ringSend;
+    std::memset(&send.header, 0, sizeof(send.header));
+    send.header.msg_iov = send.iov.data();
+    send.header.msg_iovlen = connection.writer.gather(send.iov.data(), send.iov.size());
+    shard.ring->sendMessage(connection.fd, &send.header, ringData(OpSend, clientID));
+    connection.sendInFlight = true;
+}
+
+void Server::completeSend(Shard& shard, ClientID clientID, int result) {
+    auto it = shard.connections.find(clientID);
+    if (it == shard.connections.end()) {
+        // Conexion cerrada con el envio en vuelo: ya se pueden soltar sus frames
+        shard.retiredWriters.erase(clientID);
+        shard.retiredSends.erase(clientID);
+        return;
+    }
+    Connection& connection = it->second;
+    connection.sendInFlight = false;
+    bump(&TrafficCounters::sendCalls, shard.totals, *connection.counters, 1);
+    if (result < 0) {
+        if (result == -EINTR || result == -EAGAIN) {
+            submitSend(shard, clientID, connection);
+        } else {
+            closeConnection(shard, clientID);
+        }
+        return;
+    }
+
+    size_t before = connection.writer.pendingBytes();
+    uint64_t streamedBefore = connection.writer.streamedBytes();
+    connection.writer.advance(static_cast<size_t>(result));
+    releaseSent(shard, clientID, connection, before - connection.writer.pendingBytes(),
+                connection.writer.streamedBytes() - streamedBefore);
+    if (!connection.writer.empty()) {
+        submitSend(shard, clientID, connection);
+    }
+}
+
+void Server::releaseSent(Shard& shard, ClientID clientID, Connection& connection, size_t released,
+                         uint64_t streamed) {
+    bump(&TrafficCounters::bytesOut, shard.totals, *connection.counters, released + streamed);
+    if (released + streamed > 0) {
+        connection.lastSent = std::chrono::steady_clock::now();
+    }
+    if (released == 0) {
+        return; // Los trozos de stream no ocupan la cola
+    }
+
+    // Liberar los bytes escritos de la cola y despertar a los llamantes bloqueados
+    EventList events;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.messagesToSend.find(clientID);
+        if (it != shard.messagesToSend.end()) {
+            Outbox& outbox = it->second;
+            outbox.queuedBytes -= std::min(released, outbox.queuedBytes);
+            publishQueue(*outbox.counters, outbox.frames.size(), outbox.queuedBytes);
+            if (outbox.congested && outbox.queuedBytes <= shard.limits.lowWatermark) {
+                outbox.congested = false;
+                events.push_back(std::make_pair(clientID, SendQueueEvent::Drained));
+            }
+        }
+    }
+    shard.drained.notify_all();
+    notifyBackpressure(shard, events);
+}
+
+void Server::closeConnection(Shard& shard, ClientID clientID) {
+    auto it = shard.connections.find(clientID);
+    if (it == shard.connections.end()) {
+        return;
+    }
+
+    shard.timers.cancel(clientID);
+    Connection& connection = it->second;
+    if (shard.ring) {
+        if (connection.shm) {
+            shard.ring->cancel(ringData(OpPoll, clientID)); // El poll del eventfd
+        }
+        // El fd se cierra tras cancelar su recv y su envio, en el siguiente enter
+        shard.ring->cancelAndClose(connection.fd);
+        if (connection.sendInFlight) {
+            shard.retiredWriters[clientID] = std::move(connection.writer);
+            shard.retiredSends[clientID] = std::move(connection.ringSend);
+        }
+    } else {
+        epoll_ctl(shard.epollFd, EPOLL_CTL_DEL, connection.fd, NULL);
+        if (connection.shm) {
+            // El cliente comparte el eventfd: cerrarlo no basta para sacarlo de epoll
+            epoll_ctl(shard.epollFd, EPOLL_CTL_DEL, connection.shm->eventFd(), NULL);
+        }
+        close(connection.fd);
+    }
+    shard.connections.erase(it);
+    if (datagramsEnabled) {
+        closeDatagramSession(clientID);
+    }
+    bump(shard.closed, 1);
+    shard.countersChanged = true;
+
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.messagesToSend.erase(clientID);
+    }
+    shard.drained.notify_all();
+}
+
+void Server::scheduleTimeout(Shard& shard, ClientID clientID, const Connection& connection) {
+    // Un solo timer por conexion, hasta el primero de sus dos plazos. Recibir
+    // o enviar no lo reprograma: al vencer se mira la ultima actividad.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    if (timeouts.idleTimeout.count() > 0) {
+        deadline = connection.lastReceived + timeouts.idleTimeout;
+    }
+    if (timeouts.heartbeatInterval.count() > 0 && connection.helloAcknowledged) {
+        deadline = std::min(deadline, connection.lastSent + timeouts.heartbeatInterval);
+    }
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        return;
+    }
+
+    std::chrono::steady_clock::duration left = deadline - std::chrono::steady_clock::now();
+    shard.timers.schedule(clientID, std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::max(left, std::chrono::steady_clock::duration::zero())));
+}
+
+void Server::checkTimeouts(Shard& shard) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::vector<TimingWheel::Key> expired;
+    shard.timers.advance(now, expired);
+    if (expired.empty()) {
+        return;
+    }
+
+    std::vector<ClientID> reaped;
+    FrameHandle heartbeat;
+    for (TimingWheel::Key clientID : expired) {
+        auto it = shard.connections.find(clientID);
+        if (it == shard.connections.end()) {
+            continue;
+        }
+        Connection& connection = it->second;
+
+        // Con la lectura pausada el silencio es nuestro, no del cliente
+        if (timeouts.idleTimeout.count() > 0 && !connection.readPaused
+            && now - connection.lastReceived >= timeouts.idleTimeout) {
+            closeConnection(shard, clientID);
+            reaped.push_back(clientID);
+            continue;
+        }
+        if (timeouts.heartbeatInterval.count() > 0 && connection.helloAcknowledged
+            && now - connection.lastSent >= timeouts.heartbeatInterval) {
+            if (!heartbeat) {
+                heartbeat = makeControlFrame(ControlType::Heartbeat, 0);
+            }
+            pushControlFrame(shard, clientID, connection, heartbeat);
+            connection.lastSent = now; // Aunque quede en el writer: no repetir en cada tick
+            if (!flushConnection(shard, clientID, connection)) {
+                closeConnection(shard, clientID);
+                continue;
+            }
+        }
+        scheduleTimeout(shard, clientID, connection);
+    }
+
+    if (reapCallback) {
+        for (ClientID clientID : reaped) {
+            reapCallback(clientID);
+        }
+    }
+}
+
+Server::SendBatch::SendBatch(Server& server)
+: server(server), previous(activeBatch), deferred(server.shards.size(), false) {
+    activeBatch = this;
+}
+
+Server::SendBatch::~SendBatch() {
+    activeBatch = previous;
+    for (size_t i = 0; i < deferred.size(); ++i) {
+        if (!deferred[i]) {
+            continue;
+        }
+        // Anidado en otro del mismo Server: que despierte el de fuera
+        if (previous && &previous->server == &server) {
+            previous->deferred[i] = true;
+        } else if (server.isRunning) {
+            server.signalFlush(*server.shards[i]);
+        }
+    }
+}
+
+const char* Server::AlreadyStartedException::what() const noexcept {
+    return "Server: Already started.";
+}
+
+const char* Server::NotStartedException::what() const noexcept {
+    return "Server: Not started.";
+}
+
+Server::StartFailedException::StartFailedException(const std::string& msg)
+: std::runtime_error("Server: " + msg + ".") {}
+
+Server::UnknownClientException::UnknownClientException()
+: std::runtime_error("Server: Unknown client.") {}
+
+Server::SendingFailedException::SendingFailedException()
+: std::runtime_error("Server: Failed to send message.") {}
+
+Server::BatchSendingFailedException::BatchSendingFailedException()
+: std::runtime_error("Server: Failed to send at least 1 message.") {}
+
+Server::DatagramTooLargeException::DatagramTooLargeException()
+: std::runtime_error("Server: Message does not fit in a datagram.") {}
+
+Server::StreamsUnavailableException::StreamsUnavailableException()
+: std::runtime_error("Server: Streams were not negotiated with the client.") {}
\ No newline at end of file
@@ -0,0 +1,291 @@
+#include "network/shm_channel.hpp"
+#include "network/unix_socket.hpp"
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <cstring>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include <errno.h>
+
+// Cabecera compartida de un anillo; los datos van justo detras.
+// head solo lo escribe el productor y tail solo el consumidor; los flags de
+// espera siguen el esquema "anunciar, barrera, recomprobar" para que ningun
+// lado se duerma con trabajo pendiente.
+struct ShmChannel::Ring {
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+    uint64_t capacity;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+namespace {
+    const size_t maxIovecs = 64;
+
+    void closeIfOpen(int fd) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+ShmChannel::ShmChannel(int memFd, int localEvent, int remoteEvent, bool isServerSide)
+: memFd(memFd), localEvent(localEvent), remoteEvent(remoteEvent), isServerSide(isServerSide),
+  mappedSize(0), mapping(nullptr), inbound(nullptr), outbound(nullptr) {}
+
+ShmChannel::~ShmChannel() {
+    if (mapping) {
+        ::munmap(mapping, mappedSize);
+    }
+    closeIfOpen(memFd);
+    closeIfOpen(localEvent);
+    closeIfOpen(remoteEvent);
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::create(size_t ringCapacity) {
+    int memFd = ::memfd_create("libftpp-shm", MFD_CLOEXEC);
+    if (memFd < 0) {
+        throw ShmFailedException("memfd_create failed");
+    }
+    int clientEvent = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int serverEvent = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::unique_ptr<ShmChannel> channel(new ShmChannel(memFd, clientEvent, serverEvent, false));
+    if (clientEvent < 0 || serverEvent < 0) {
+        throw ShmFailedException("eventfd failed");
+    }
+
+    size_t ringSize = sizeof(Ring) + ringCapacity;
+    if (::ftruncate(memFd, static_cast<off_t>(2 * ringSize)) < 0) {
+        throw ShmFailedException("ftruncate failed");
+    }
+    channel->map(ringCapacity);
+    // El memfd empieza a cero; basta con construir los atomics en su sitio
+    Ring* rings[2] = { channel->inbound, channel->outbound };
+    for (Ring* ring : rings) {
+        new (ring) Ring();
+        ring->capacity = ringCapacity;
+    }
+    return channel;
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::attach(const int descriptors[descriptorCount]) {
+    // Orden de envio: memfd, evento del cliente, evento del servidor
+    std::unique_ptr<ShmChannel> channel(
+        new ShmChannel(descriptors[0], descriptors[2], descriptors[1], true));
+
+    struct stat info;
+    if (::fstat(channel->memFd, &info) < 0 || info.st_size <= static_cast<off_t>(2 * sizeof(Ring))) {
+        throw ShmFailedException("invalid shared memory segment");
+    }
+    size_t ringCapacity = static_cast<size_t>(info.st_size) / 2 - sizeof(Ring);
+    channel->map(ringCapacity);
+    if (channel->inbound->capacity != ringCapacity || channel->outbound->capacity != ringCapacity) {
+        throw ShmFailedException("shared memory rings do not match segment size");
+    }
+    return channel;
+}
+
+void ShmChannel::map(size_t ringCapacity) {
+    size_t ringSize = sizeof(Ring) + ringCapacity;
+    mappedSize = 2 * ringSize;
+    void* address = ::mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (address == MAP_FAILED) {
+        throw ShmFailedException("mmap failed");
+    }
+    mapping = static_cast<char*>(address);
+
+    // Primer anillo: cliente -> servidor; segundo: servidor -> cliente
+    Ring* toServer = reinterpret_cast<Ring*>(mapping);
+    Ring* toClient = reinterpret_cast<Ring*>(mapping + ringSize);
+    inbound = isServerSide ? toServer : toClient;
+    outbound = isServerSide ? toClient : toServer;
+}
+
+int ShmChannel::eventFd() const {
+    return localEvent;
+}
+
+void ShmChannel::clearEvent() {
+    uint64_t value;
+    while (::read(localEvent, &value, sizeof(value)) > 0) {
+    }
+}
+
+void ShmChannel::signalRemote() {
+    uint64_t one = 1;
+    ssize_t written = ::write(remoteEvent, &one, sizeof(one));
+    (void)written;
+}
+
+bool ShmChannel::flush(FrameWriter& writer) {
+    const uint64_t capacity = outbound->capacity;
+    char* data = outbound->data();
+
+    while (!writer.empty()) {
+        uint64_t head = outbound->head.load(std::memory_order_relaxed);
+        uint64_t tail = outbound->tail.load(std::memory_order_acquire);
+        size_t space = static_cast<size_t>(capacity - (head - tail));
+        if (space == 0) {
+            // Anillo lleno: anunciar la espera y recomprobar antes de rendirse
+            outbound->writerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (outbound->tail.load(std::memory_order_acquire) == tail) {
+                return false;
+            }
+            continue;
+        }
+
+        struct iovec iov[maxIovecs];
+        size_t count = writer.gather(iov, maxIovecs);
+        size_t copied = 0;
+        for (size_t i = 0; i < count && copied < space; ++i) {
+            const char* source = static_cast<const char*>(iov[i].iov_base);
+            size_t length = std::min(iov[i].iov_len, space - copied);
+            size_t position = static_cast<size_t>((head + copied) % capacity);
+            size_t first = std::min(length, static_cast<size_t>(capacity) - position);
+            std::memcpy(data + position, source, first);
+            std::memcpy(data, source + first, length - first);
+            copied += length;
+        }
+        outbound->head.store(head + copied, std::memory_order_release);
+        writer.advance(copied);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (outbound->readerWaiting.load(std::memory_order_relaxed) &&
+            outbound->readerWaiting.exchange(0)) {
+            signalRemote();
+        }
+    }
+    return true;
+}
+
+bool ShmChannel::drain(FrameReader& reader) {
+    const uint64_t capacity = inbound->capacity;
+    const char* data = inbound->data();
+
+    for (;;) {
+        uint64_t tail = inbound->tail.load(std::memory_order_relaxed);
+        uint64_t head = inbound->head.load(std::memory_order_acquire);
+        if (head == tail) {
+            // Vacio: pedir aviso y recomprobar para no perder un frame en vuelo
+            inbound->readerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (inbound->head.load(std::memory_order_acquire) == tail) {
+                return false;
+            }
+            continue;
+        }
+
+        size_t available = static_cast<size_t>(head - tail);
+        size_t position = static_cast<size_t>(tail % capacity);
+        size_t first = std::min(available, static_cast<size_t>(capacity) - position);
+        reader.feed(data + position, first);
+        if (available > first) {
+            reader.feed(data, available - first);
+        }
+        inbound->tail.store(head, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (inbound->writerWaiting.load(std::memory_order_relaxed) &&
+            inbound->writerWaiting.exchange(0)) {
+            signalRemote();
+        }
+        return true;
+    }
+}
+
+bool ShmChannel::sendDescriptors(int socketFd) const {
+    int descriptors[descriptorCount] = { memFd, localEvent, remoteEvent };
+    char tag = 'S';
+    struct iovec iov = { &tag, sizeof(tag) };
+    union {
+        char buffer[CMSG_SPACE(sizeof(descriptors))];
+        struct cmsghdr align;
+    } control;
+    std::memset(&control, 0, sizeof(control));
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+    struct cmsghdr* header = CMSG_FIRSTHDR(&msg);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(descriptors));
+    std::memcpy(CMSG_DATA(header), descriptors, sizeof(descriptors));
+
+    ssize_t sent;
+    do {
+        sent = ::sendmsg(socketFd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(sizeof(tag));
+}
+
+bool ShmChannel::receiveDescriptors(int socketFd, int descriptors[descriptorCount]) {
+    char tag = 0;
+    struct iovec iov = { &tag, sizeof(tag) };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * descriptorCount)];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    ssize_t received;
+    do {
+        received = ::recvmsg(socketFd, &msg, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return false;
+    }
+
+    struct cmsghdr* header = CMSG_FIRSTHDR(&msg);
+    if (!header || header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) {
+        errno = EPROTO;
+        return false;
+    }
+    size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    int* passed = reinterpret_cast<int*>(CMSG_DATA(header));
+    if (count != descriptorCount || tag != 'S' || (msg.msg_flags & MSG_CTRUNC)) {
+        for (size_t i = 0; i < count; ++i) {
+            ::close(passed[i]);
+        }
+        errno = EPROTO;
+        return false;
+    }
+    std::memcpy(descriptors, passed, sizeof(int) * descriptorCount);
+    return true;
+}
+
+bool ShmChannel::parseAddress(const std::string& address, std::string& name) {
+    const std::string scheme = "shm://";
+    if (address.compare(0, scheme.size(), scheme) != 0 || address.size() == scheme.size()) {
+        return false;
+    }
+    name = address.substr(scheme.size());
+    return true;
+}
+
+// Espacio de nombres abstracto: no queda fichero que limpiar
+int ShmChannel::listenSocket(const std::string& name, int backlog) {
+    return listenUnixSocket("@libftpp/shm/" + name, SOCK_SEQPACKET, backlog);
+}
+
+int ShmChannel::connectSocket(const std::string& name) {
+    return connectUnixSocket("@libftpp/shm/" + name, SOCK_SEQPACKET);
+}
+
+ShmChannel::ShmFailedException::ShmFailedException(const std::string& msg)
+: std::runtime_error("Shared memory channel failed: " + msg) {}
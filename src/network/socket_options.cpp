@@ -0,0 +1,40 @@
+#include "network/socket_options.hpp"
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace {
+    bool setInt(int fd, int level, int name, int value) {
+        return setsockopt(fd, level, name, &value, sizeof(value)) == 0;
+    }
+
+    bool applyBuffers(int fd, const SocketOptions& options) {
+        return (options.sendBuffer <= 0 || setInt(fd, SOL_SOCKET, SO_SNDBUF, options.sendBuffer))
+            && (options.receiveBuffer <= 0 || setInt(fd, SOL_SOCKET, SO_RCVBUF, options.receiveBuffer));
+    }
+}
+
+bool applySocketOptions(int fd, const SocketOptions& options, bool tcp) {
+    if (!applyBuffers(fd, options)) {
+        return false;
+    }
+    if (!tcp) {
+        return true;
+    }
+
+    bool ok = (!options.noDelay || setInt(fd, IPPROTO_TCP, TCP_NODELAY, 1))
+        && (!options.quickAck || setInt(fd, IPPROTO_TCP, TCP_QUICKACK, 1))
+        && (options.busyPollMicros <= 0 || setInt(fd, SOL_SOCKET, SO_BUSY_POLL, options.busyPollMicros));
+    if (ok && options.keepAlive) {
+        ok = setInt(fd, SOL_SOCKET, SO_KEEPALIVE, 1)
+            && (options.keepAliveIdle <= 0 || setInt(fd, IPPROTO_TCP, TCP_KEEPIDLE, options.keepAliveIdle))
+            && (options.keepAliveInterval <= 0 || setInt(fd, IPPROTO_TCP, TCP_KEEPINTVL, options.keepAliveInterval))
+            && (options.keepAliveCount <= 0 || setInt(fd, IPPROTO_TCP, TCP_KEEPCNT, options.keepAliveCount));
+    }
+    return ok;
+}
+
+void rearmQuickAck(int fd, const SocketOptions& options) {
+    if (options.quickAck) {
+        setInt(fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+    }
+}
@@ -0,0 +1,97 @@
+#include "network/stream.hpp"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <limits>
+
+/* StreamSource */
+
+StreamSource::StreamSource(int fd, uint64_t offset, uint64_t size, bool ownsFd)
+: file(fd), ownsFile(ownsFd), start(offset), length(size) {}
+
+StreamSource::StreamSource(const Reader& reader)
+: file(-1), ownsFile(false), start(0), length(std::numeric_limits<uint64_t>::max()), reader(reader) {}
+
+StreamSource::~StreamSource() {
+    if (ownsFile && file >= 0) {
+        ::close(file);
+    }
+}
+
+std::shared_ptr<StreamSource> StreamSource::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) < 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw OpenFailedException(path);
+    }
+    return std::make_shared<StreamSource>(fd, 0, static_cast<uint64_t>(info.st_size), true);
+}
+
+bool StreamSource::isFile() const {
+    return file >= 0;
+}
+
+int StreamSource::fd() const {
+    return file;
+}
+
+uint64_t StreamSource::offset() const {
+    return start;
+}
+
+uint64_t StreamSource::size() const {
+    return length;
+}
+
+size_t StreamSource::read(uint64_t position, char* buffer, size_t capacity) {
+    if (!isFile()) {
+        try {
+            return reader ? reader(buffer, capacity) : 0;
+        } catch (const std::exception& e) {
+            throw ReadFailedException(e.what());
+        }
+    }
+
+    if (position >= length) {
+        return 0;
+    }
+    if (capacity > length - position) {
+        capacity = static_cast<size_t>(length - position);
+    }
+    ssize_t got;
+    do {
+        got = ::pread(file, buffer, capacity, static_cast<off_t>(start + position));
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        throw ReadFailedException(std::strerror(errno));
+    }
+    return static_cast<size_t>(got);
+}
+
+StreamSource::OpenFailedException::OpenFailedException(const std::string& path)
+: std::runtime_error("StreamSource: Cannot open " + path + ".") {}
+
+StreamSource::ReadFailedException::ReadFailedException(const std::string& msg)
+: std::runtime_error("StreamSource: " + msg + ".") {}
+
+/* StreamChunk */
+
+const uint8_t StreamChunk::infoLast;
+const uint8_t StreamChunk::infoAborted;
+
+StreamChunk::StreamChunk(uint64_t streamID, const Message& frame)
+: streamID(streamID), type(frame.type()) {
+    if (frame.size() < 1) {
+        throw Message::DeserializationFailedException("Data too short for stream info");
+    }
+    uint8_t info = static_cast<uint8_t>(frame.data()[0]);
+    data = frame.data() + 1;
+    size = frame.size() - 1;
+    last = (info & infoLast) != 0;
+    aborted = (info & infoAborted) != 0;
+}
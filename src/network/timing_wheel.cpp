@@ -0,0 +1,77 @@
+#include "network/timing_wheel.hpp"
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tick, size_t slotCount)
+: tick(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+  slots(slotCount > 0 ? slotCount : 1), current(0) {}
+
+void TimingWheel::schedule(Key key, std::chrono::milliseconds delay) {
+    cancel(key);
+    Clock::time_point now = Clock::now();
+    if (timers.empty()) {
+        // Rueda parada: empezar a contar desde ahora
+        nextTick = now + tick;
+    }
+
+    // Ticks hasta el primero que cae en o despues del plazo: nunca vence antes
+    Clock::duration wait = now + std::chrono::duration_cast<Clock::duration>(delay) - nextTick;
+    size_t ticks = 1;
+    if (wait > Clock::duration::zero()) {
+        ticks += static_cast<size_t>((wait + tick - Clock::duration(1)) / tick);
+    }
+
+    Timer timer;
+    timer.slot = (current + ticks) % slots.size();
+    timer.rounds = (ticks - 1) / slots.size();
+    std::list<Key>& slot = slots[timer.slot];
+    timer.position = slot.insert(slot.end(), key);
+    timers[key] = timer;
+}
+
+void TimingWheel::cancel(Key key) {
+    auto it = timers.find(key);
+    if (it == timers.end()) {
+        return;
+    }
+    slots[it->second.slot].erase(it->second.position);
+    timers.erase(it);
+}
+
+void TimingWheel::advance(Clock::time_point now, std::vector<Key>& expired) {
+    while (!timers.empty() && nextTick <= now) {
+        nextTick += tick;
+        current = (current + 1) % slots.size();
+
+        std::list<Key>& slot = slots[current];
+        for (auto it = slot.begin(); it != slot.end();) {
+            Timer& timer = timers[*it];
+            if (timer.rounds > 0) {
+                --timer.rounds;
+                ++it;
+                continue;
+            }
+            expired.push_back(*it);
+            timers.erase(*it);
+            it = slot.erase(it);
+        }
+    }
+}
+
+int TimingWheel::timeoutMs(Clock::time_point now) const {
+    if (timers.empty()) {
+        return -1;
+    }
+    if (nextTick <= now) {
+        return 0;
+    }
+    Clock::duration left = nextTick - now;
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        left + std::chrono::milliseconds(1) - Clock::duration(1)).count());
+}
+
+bool TimingWheel::empty() const {
+    return timers.empty();
+}
+
+size_t TimingWheel::size() const {
+    return timers.size();
+}
@@ -0,0 +1,60 @@
+#include "network/token_bucket.hpp"
+#include <algorithm>
+
+TokenBucket::TokenBucket()
+: rate(0.0), burst(0.0), tokens(0.0), lastRefill(Clock::now()) {}
+
+TokenBucket::TokenBucket(double rate, double burst)
+: rate(std::max(rate, 0.0)), burst(burst > 0.0 ? burst : std::max(rate, 1.0)),
+  tokens(this->burst), lastRefill(Clock::now()) {}
+
+bool TokenBucket::limited() const {
+    return rate > 0.0;
+}
+
+bool TokenBucket::available(Clock::time_point now) {
+    if (!limited()) {
+        return true;
+    }
+    refill(now);
+    return tokens > 0.0;
+}
+
+bool TokenBucket::tryConsume(double amount, Clock::time_point now) {
+    if (!limited()) {
+        return true;
+    }
+    refill(now);
+    // Un mensaje mayor que burst pasa si el cubo esta lleno, o no pasaria nunca
+    if (tokens < std::min(amount, burst)) {
+        return false;
+    }
+    tokens -= amount;
+    return true;
+}
+
+void TokenBucket::consume(double amount, Clock::time_point now) {
+    if (!limited()) {
+        return;
+    }
+    refill(now);
+    tokens -= amount;
+}
+
+TokenBucket::Clock::duration TokenBucket::waitTime(Clock::time_point now) {
+    if (available(now)) {
+        return Clock::duration::zero();
+    }
+    // Hasta volver a tener algo mas que cero tokens
+    std::chrono::duration<double> wait((-tokens) / rate);
+    return std::chrono::duration_cast<Clock::duration>(wait) + Clock::duration(1);
+}
+
+void TokenBucket::refill(Clock::time_point now) {
+    if (now <= lastRefill) {
+        return;
+    }
+    std::chrono::duration<double> elapsed = now - lastRefill;
+    tokens = std::min(burst, tokens + elapsed.count() * rate);
+    lastRefill = now;
+}
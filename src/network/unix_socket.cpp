@@ -0,0 +1,76 @@
+#include "network/unix_socket.hpp"
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+    socklen_t socketAddress(const std::string& path, sockaddr_un& addr) {
+        std::memset(&addr, 0, sizeof(addr));
+        if (path.empty() || path.size() > sizeof(addr.sun_path)
+            || (path[0] != '@' && path.size() == sizeof(addr.sun_path))) {
+            return 0;
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.data(), path.size());
+        size_t length = path.size();
+        if (path[0] == '@') {
+            addr.sun_path[0] = '\0';
+        } else {
+            ++length; // Incluir el terminador
+        }
+        return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + length);
+    }
+}
+
+bool parseUnixAddress(const std::string& address, std::string& path) {
+    const std::string scheme = "unix://";
+    if (address.compare(0, scheme.size(), scheme) != 0 || address.size() == scheme.size()) {
+        return false;
+    }
+    path = address.substr(scheme.size());
+    return true;
+}
+
+int listenUnixSocket(const std::string& path, int type, int backlog) {
+    sockaddr_un addr;
+    socklen_t length = socketAddress(path, addr);
+    if (length == 0) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // Un socket que quedo de una ejecucion anterior impediria el bind
+    struct stat info;
+    if (path[0] != '@' && ::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+        ::unlink(path.c_str());
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), length) < 0 || ::listen(fd, backlog) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int connectUnixSocket(const std::string& path, int type) {
+    sockaddr_un addr;
+    socklen_t length = socketAddress(path, addr);
+    if (length == 0) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), length) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
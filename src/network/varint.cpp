@@ -0,0 +1,45 @@
+#include "network/varint.hpp"
+#include <stdexcept>
+
+size_t encodeVarint(uint64_t value, char* out) {
+    size_t count = 0;
+    while (value >= 0x80) {
+        out[count++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[count++] = static_cast<char>(value);
+    return count;
+}
+
+size_t decodeVarint(const char* data, size_t size, uint64_t& value) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (i == maxVarintSize) {
+            throw std::runtime_error("Varint: Value exceeds 64 bits.");
+        }
+        uint8_t byte = static_cast<uint8_t>(data[i]);
+        result |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            value = result;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+size_t varintSize(uint64_t value) {
+    size_t count = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++count;
+    }
+    return count;
+}
+
+uint64_t zigzagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t zigzagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}